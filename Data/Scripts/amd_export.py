@@ -25,17 +25,10 @@ def triangulate_object(obj):
     bm.free()
     me.calc_tangents()
 
-# Search a vertex in a buffer
-def buscaVertex(v0, t0, n0, vtx, txc, nrm):
-    i=0
-    while(i<len(vtx)):
-        v1 = vtx[i]
-        t1 = txc[i]
-        n1 = nrm[i]
-        if(v0[0] == v1[0] and v0[1] == v1[1] and v0[2] == v1[2] and n0[0] == n1[0] and n0[1] == n1[1] and n0[2] == n1[2] and t0[0] == t1[0] and t0[1] == t1[1]):
-            return i
-        i += 1
-    return -1
+# Search a vertex in the welding map (position, texcoord, normal -> index)
+def buscaVertex(v0, t0, n0, vertexMap):
+    key = (v0[0], v0[1], v0[2], t0[0], t0[1], n0[0], n0[1], n0[2])
+    return vertexMap.get(key, -1), key
 
 # Search a bone
 def buscaBone(bones, name):
@@ -117,6 +110,7 @@ def export(context, filepath, use_some_setting):
             print(obj.name + "\n")
             
             vertices = []
+            vertexMap = dict()
             normals = []
             texcoords = []
             indices = []
@@ -156,8 +150,9 @@ def export(context, filepath, use_some_setting):
                             while len(weight) != 4:
                                 weight.append(0)
                                 weight_bonelist.append(0)
-                    index = buscaVertex(vertex, texcoord, normal, vertices, texcoords, normals)
+                    index, key = buscaVertex(vertex, texcoord, normal, vertexMap)
                     if(index == -1):        # New vertex in our list
+                        vertexMap[key] = len(vertices)
                         indices.append(len(vertices))
                         vertices.append(vertex)
                         texcoords.append([texcoord[0], 1-texcoord[1]])
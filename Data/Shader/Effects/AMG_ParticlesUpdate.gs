@@ -0,0 +1,108 @@
+#version 330 core
+
+const int AMG_EMIT_BATCH = 64;		// Must match AMG_GPU_PARTICLE_EMIT_BATCH
+
+layout(points) in;
+layout(points, max_vertices = 64) out;
+
+in vec4 AMG_VPosition[];
+in vec2 AMG_VScaleFrame[];
+in vec4 AMG_VVelocity[];
+in vec2 AMG_VLife[];
+
+out vec4 AMG_TFPosition;
+out vec2 AMG_TFScaleFrame;
+out vec4 AMG_TFVelocity;
+out vec2 AMG_TFLife;
+
+uniform float deltaTime;
+uniform float randomSeed;
+uniform int emitCount;
+uniform vec4 emitPosition;
+uniform vec4 emitVelocity;
+uniform vec3 emitParams;
+uniform vec2 AMG_TexFrames;
+uniform vec3 collision;
+uniform mat4 AMG_V;
+uniform mat4 AMG_P;
+uniform mat4 invProjection;
+uniform sampler2D sceneDepth;
+
+float random(float n){
+	return fract(sin(n * 12.9898 + randomSeed * 78.233) * 43758.5453) * 2.0 - 1.0;
+}
+
+vec3 scenePosition(vec2 uv){
+	float depth = texture(sceneDepth, uv).r;
+	vec4 pos = invProjection * vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	return pos.xyz / pos.w;
+}
+
+void collide(vec3 oldPosition, inout vec3 position, inout vec3 velocity){
+	
+	// Only particles on screen can collide
+	vec4 viewPos = AMG_V * vec4(position, 1.0);
+	vec4 clipPos = AMG_P * viewPos;
+	if(clipPos.w <= 0.0) return;
+	vec2 ndc = clipPos.xy / clipPos.w;
+	if(any(greaterThan(abs(ndc), vec2(1.0)))) return;
+	
+	// The particle is inside the geometry if it's behind the visible surface, but not too far
+	vec2 uv = ndc * 0.5 + 0.5;
+	vec3 scene = scenePosition(uv);
+	if(viewPos.z > scene.z || viewPos.z < scene.z - collision.z) return;
+	
+	// Rebuild the surface normal from the neighbour pixels
+	vec2 texel = 1.0 / vec2(textureSize(sceneDepth, 0));
+	vec3 dx = scenePosition(uv + vec2(texel.x, 0.0)) - scene;
+	vec3 dy = scenePosition(uv + vec2(0.0, texel.y)) - scene;
+	vec3 normal = normalize(cross(dx, dy));
+	if(normal.z < 0.0) normal = -normal;
+	normal = normalize(transpose(mat3(AMG_V)) * normal);
+	
+	// Bounce and apply friction, then go back outside the geometry
+	float vn = dot(velocity, normal);
+	if(vn < 0.0){
+		vec3 tangent = velocity - normal * vn;
+		velocity = tangent * (1.0 - collision.y) - normal * vn * collision.x;
+	}
+	position = oldPosition;
+}
+
+void main(){
+	
+	// On the emission pass, each point emits the next batch of new particles
+	if(emitCount > 0){
+		int first = gl_PrimitiveIDIn * AMG_EMIT_BATCH;
+		int n = min(emitCount - first, AMG_EMIT_BATCH);
+		for(int i=0;i<n;i++){
+			float id = float(first + i);
+			vec3 r = vec3(random(id * 3.0), random(id * 3.0 + 1.0), random(id * 3.0 + 2.0));
+			AMG_TFPosition = emitPosition;
+			AMG_TFScaleFrame = vec2(emitParams.y, 0.0);
+			AMG_TFVelocity = vec4(emitVelocity.xyz + r * emitParams.z, emitVelocity.w);
+			AMG_TFLife = vec2(0.0, emitParams.x);
+			EmitVertex();
+			EndPrimitive();
+		}
+		return;
+	}
+	
+	// Kill the particle when it gets old
+	float age = AMG_VLife[0].x + deltaTime;
+	if(age > AMG_VLife[0].y) return;
+	
+	// Apply gravity and velocity
+	vec4 velocity = AMG_VVelocity[0];
+	velocity.y -= velocity.w * deltaTime;
+	vec3 position = AMG_VPosition[0].xyz + velocity.xyz * deltaTime;
+	vec3 newVelocity = velocity.xyz;
+	if(collision.z > 0.0) collide(AMG_VPosition[0].xyz, position, newVelocity);
+	float nframes = AMG_TexFrames.x * AMG_TexFrames.y;
+	AMG_TFPosition = vec4(position, AMG_VPosition[0].w);
+	AMG_TFScaleFrame = vec2(AMG_VScaleFrame[0].x, (age / AMG_VLife[0].y) * nframes);
+	AMG_TFVelocity = vec4(newVelocity, velocity.w);
+	AMG_TFLife = vec2(age, AMG_VLife[0].y);
+	EmitVertex();
+	EndPrimitive();
+}
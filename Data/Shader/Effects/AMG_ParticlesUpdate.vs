@@ -0,0 +1,19 @@
+#version 330 core
+
+layout(location = 0) in vec4 AMG_Position;		// Position and rotation
+layout(location = 1) in vec2 AMG_ScaleFrame;	// Scale and texture frame
+layout(location = 2) in vec4 AMG_Velocity;		// Velocity and mass
+layout(location = 3) in vec2 AMG_Life;			// Age and life length
+
+out vec4 AMG_VPosition;
+out vec2 AMG_VScaleFrame;
+out vec4 AMG_VVelocity;
+out vec2 AMG_VLife;
+
+void main(){
+	
+	AMG_VPosition = AMG_Position;
+	AMG_VScaleFrame = AMG_ScaleFrame;
+	AMG_VVelocity = AMG_Velocity;
+	AMG_VLife = AMG_Life;
+}
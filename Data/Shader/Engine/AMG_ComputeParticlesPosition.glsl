@@ -1,8 +1,17 @@
 /**
- * @brief Compute the particles position
- * Input: AMG_Position, AMG_InstancedMVP
+ * @brief Compute the particles position, expanding each quad to face the camera
+ * Uniforms: AMG_V, AMG_P
+ * Input: AMG_Position, AMG_InstancedPosition, AMG_InstancedScaleFrame
  * Output: gl_Position
+ * @return The vertex position in world space
  */
-void AMG_ComputeParticlesPosition(){
-	gl_Position = AMG_InstancedMVP * vec4(AMG_Position, 0, 1);
+vec4 AMG_ComputeParticlesPosition(){
+	float s = sin(AMG_InstancedPosition.w);
+	float c = cos(AMG_InstancedPosition.w);
+	vec2 corner = mat2(c, s, -s, c) * AMG_Position * AMG_InstancedScaleFrame.x;
+	vec4 center = AMG_V * vec4(AMG_InstancedPosition.xyz, 1);
+	gl_Position = AMG_P * (center + vec4(corner, 0, 0));
+	vec3 right = vec3(AMG_V[0][0], AMG_V[1][0], AMG_V[2][0]);
+	vec3 up = vec3(AMG_V[0][1], AMG_V[1][1], AMG_V[2][1]);
+	return vec4(AMG_InstancedPosition.xyz + right * corner.x + up * corner.y, 1);
 }
@@ -46,6 +46,8 @@ uniform float AMG_SpecularReflectivity;
 uniform vec4 AMG_FogColor;
 uniform sampler2D AMG_TextureSampler[AMG_TEXTURES];
 uniform samplerCube AMG_TextureCubeSampler;
+uniform sampler2DArray AMG_TextureArraySampler;
+uniform float AMG_TexLayer;
 uniform vec4 AMG_SprColor;
 uniform float AMG_TexProgress;
 uniform float AMG_CharWidth;
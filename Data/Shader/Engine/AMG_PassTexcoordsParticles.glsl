@@ -1,11 +1,16 @@
 /**
  * @brief Pass texture coordinates for particle rendering
- * Uniforms: AMG_TexScale
- * Input: AMG_UV, AMG_InstancedTexPosition
+ * Uniforms: AMG_TexScale, AMG_TexFrames
+ * Input: AMG_UV, AMG_InstancedScaleFrame
  * Output: AMG_TexBlend, AMG_OutUV2
  */
 void AMG_PassTexcoordsParticles(){
-	AMG_TexBlend = AMG_InstancedTexProgress;
-	AMG_OutUV2[0] = AMG_UV * AMG_TexScale + AMG_InstancedTexPosition.xy;
-	AMG_OutUV2[1] = AMG_UV * AMG_TexScale + AMG_InstancedTexPosition.zw;
+	int hframes = int(AMG_TexFrames.x);
+	int nframes = hframes * int(AMG_TexFrames.y);
+	int fr = int(AMG_InstancedScaleFrame.y);
+	if(fr >= nframes) fr = 0;
+	int nfr = min(fr + 1, nframes - 1);
+	AMG_TexBlend = fract(AMG_InstancedScaleFrame.y);
+	AMG_OutUV2[0] = AMG_UV * AMG_TexScale + vec2(fr % hframes, fr / hframes) / AMG_TexFrames;
+	AMG_OutUV2[1] = AMG_UV * AMG_TexScale + vec2(nfr % hframes, nfr / hframes) / AMG_TexFrames;
 }
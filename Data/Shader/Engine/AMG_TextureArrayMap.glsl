@@ -0,0 +1,9 @@
+/**
+ * @brief Sample the material's layer of a texture array
+ * @return The mapped color
+ * Uniforms: AMG_TextureArraySampler, AMG_TexLayer
+ * Input: AMG_OutUV
+ */
+vec4 AMG_TextureArrayMap(){
+	return texture(AMG_TextureArraySampler, vec3(AMG_OutUV, AMG_TexLayer));
+}
@@ -10,11 +10,14 @@ uniform mat4 AMG_BoneMatrix[AMG_MAX_BONES];
 uniform AMG_LightV AMG_Light[AMG_LIGHTS];
 uniform mat4 AMG_MV;
 uniform mat4 AMG_M;
+uniform mat4 AMG_V;
+uniform mat4 AMG_P;
 uniform float AMG_FogDensity;
 uniform float AMG_FogGradient;
 uniform vec3 AMG_CamPosition;
 uniform vec2 AMG_TexScale;
 uniform vec4 AMG_TexPosition;
+uniform vec2 AMG_TexFrames;
 uniform mat4 AMG_ShadowMatrix;
 uniform float AMG_ShadowDistance;
 uniform vec4 AMG_ClippingPlanes[8];
@@ -1,13 +0,0 @@
-#version 330 core
-
-layout (location = 0) out vec4 AMG_Color;
-
-#include <AMG_FragmentCommon.glsl>
-
-#include <AMG_ComputeLightCel.glsl>
-#include <AMG_TextureMap.glsl>
-
-void main(){
-
-	AMG_Color = AMG_ComputeLightCel(0, AMG_TextureMap(0));
-}
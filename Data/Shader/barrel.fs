@@ -1,16 +1,28 @@
 #version 330 core
 
+#ifdef FORWARD
+layout (location = 0) out vec4 AMG_Color;
+#else
 layout (location = 0) out vec3 AMG_GPosition;
 layout (location = 1) out vec3 AMG_GNormal;
 layout (location = 2) out vec4 AMG_GAlbedo;
+#endif
 
 #include <AMG_FragmentCommon.glsl>
 
 #include <AMG_ComputeLightNormalMap.glsl>
 #include <AMG_TextureMap.glsl>
+#ifdef FORWARD
+#include <AMG_ComputeFog.glsl>
+#else
 #include <AMG_ComputeDeferredNormalMap.glsl>
+#endif
 
 void main(){
 	
+#ifdef FORWARD
+	AMG_Color = AMG_ComputeLightNormalMap(0, AMG_TextureMap(0), 1);
+#else
 	AMG_ComputeDeferredNormalMap(1, texture(AMG_TextureSampler[0], AMG_OutUV).rgb * AMG_MaterialDiffuse.rgb * AMG_DiffusePower, AMG_SpecularPower * AMG_SpecularReflectivity);
+#endif
 }
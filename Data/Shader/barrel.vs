@@ -27,5 +27,11 @@ void main(){
     // Pass data to the fragment shader
 	AMG_PassTexcoords();
 	
+#ifdef FORWARD
+	mat3 normalMapMatrix = AMG_NormalMapMatrix(AMG_M);
+	AMG_PassLightingNormalMap(normalMapMatrix, AMG_M);
+	AMG_PassLightNormalMap(normalMapMatrix, AMG_M, 0);
+#else
 	AMG_PassDeferredNormalMap(AMG_MV);
+#endif
 }
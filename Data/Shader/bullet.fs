@@ -1,15 +1,30 @@
 #version 330 core
 
+#ifdef FORWARD
+layout (location = 0) out vec4 AMG_Color;
+#else
 layout (location = 0) out vec3 AMG_GPosition;
 layout (location = 1) out vec3 AMG_GNormal;
 layout (location = 2) out vec4 AMG_GAlbedo;
+#endif
 
 #include <AMG_FragmentCommon.glsl>
 
 #include <AMG_TextureCubeMapReflection.glsl>
+#ifdef FORWARD
+#include <AMG_ComputeLight.glsl>
+#include <AMG_ComputeFog.glsl>
+#else
 #include <AMG_ComputeDeferred.glsl>
+#endif
 
 void main(){
 	
+#ifdef FORWARD
+	vec4 color = AMG_ComputeLight(0, vec4(1, 1, 1, 1));
+	vec4 reflectedColor = AMG_TextureCubeMapReflection();
+	AMG_Color = mix(color, reflectedColor, 0.6);
+#else
 	AMG_ComputeDeferred(AMG_TextureCubeMapReflection().rgb * AMG_MaterialDiffuse.rgb * AMG_DiffusePower, AMG_SpecularPower * AMG_SpecularReflectivity);
+#endif
 }
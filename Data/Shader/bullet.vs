@@ -6,10 +6,16 @@ layout(location = 2) in vec3 AMG_Normal;
 
 #include <AMG_VertexCommon.glsl>
 
+#include <AMG_ComputePosition.glsl>
 #include <AMG_PassTexcoordsReflection.glsl>
 #include <AMG_WaterClipPlane.glsl>
+#ifdef FORWARD
+#include <AMG_PassLighting.glsl>
+#include <AMG_PassLight.glsl>
+#include <AMG_PassFog.glsl>
+#else
 #include <AMG_PassDeferred.glsl>
-#include <AMG_ComputePosition.glsl>
+#endif
 
 void main(){
 
@@ -21,5 +27,10 @@ void main(){
     // Pass data to the fragment shader
 	AMG_PassTexcoordsReflection();
 	
+#ifdef FORWARD
+	AMG_PassLighting(AMG_M);
+	AMG_PassLight(AMG_M, 0);
+#else
 	AMG_PassDeferred(AMG_MV);
+#endif
 }
@@ -1,16 +1,26 @@
 #version 330 core
 
+#ifdef FORWARD
+layout (location = 0) out vec4 AMG_Color;
+#else
 layout (location = 0) out vec3 AMG_GPosition;
 layout (location = 1) out vec3 AMG_GNormal;
 layout (location = 2) out vec4 AMG_GAlbedo;
+#endif
 
 #include <AMG_FragmentCommon.glsl>
 
 #include <AMG_ComputeLightCel.glsl>
 #include <AMG_TextureMap.glsl>
+#ifndef FORWARD
 #include <AMG_ComputeDeferred.glsl>
+#endif
 
 void main(){
 
+#ifdef FORWARD
+	AMG_Color = AMG_ComputeLightCel(0, AMG_TextureMap(0));
+#else
 	AMG_ComputeDeferred(texture(AMG_TextureSampler[0], AMG_OutUV).rgb * AMG_MaterialDiffuse.rgb * AMG_DiffusePower, AMG_SpecularPower * AMG_SpecularReflectivity);
+#endif
 }
@@ -32,5 +32,10 @@ void main(){
     // Pass data to the fragment shader
 	AMG_PassTexcoords();
 	
+#ifdef FORWARD
+	AMG_PassLighting(model);
+	AMG_PassLight(model, 0);
+#else
 	AMG_PassDeferred(modelview);
+#endif
 }
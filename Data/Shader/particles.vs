@@ -2,9 +2,8 @@
 
 layout(location = 0) in vec2 AMG_Position;
 layout(location = 1) in vec2 AMG_UV;
-layout(location = 2) in mat4 AMG_InstancedMVP;
-layout(location = 6) in vec4 AMG_InstancedTexPosition;
-layout(location = 7) in float AMG_InstancedTexProgress;
+layout(location = 2) in vec4 AMG_InstancedPosition;
+layout(location = 3) in vec2 AMG_InstancedScaleFrame;
 
 #include <AMG_VertexCommon.glsl>
 
@@ -14,7 +13,7 @@ layout(location = 7) in float AMG_InstancedTexProgress;
 
 void main(){
 	
-	AMG_WaterClipPlane(vec4(AMG_Position, 0, 1));
-	AMG_ComputeParticlesPosition();
+	vec4 position = AMG_ComputeParticlesPosition();
+	AMG_WaterClipPlane(position);
 	AMG_PassTexcoordsParticles();
 }
@@ -1,16 +1,28 @@
 #version 330 core
 
+#ifdef FORWARD
+layout (location = 0) out vec4 AMG_Color;
+#else
 layout (location = 0) out vec3 AMG_GPosition;
 layout (location = 1) out vec3 AMG_GNormal;
 layout (location = 2) out vec4 AMG_GAlbedo;
+#endif
 
 #include <AMG_FragmentCommon.glsl>
 
 #include <AMG_BlendMap.glsl>
 #include <AMG_ComputeShadows.glsl>
+#ifdef FORWARD
+#include <AMG_ComputeLight.glsl>
+#else
 #include <AMG_ComputeDeferred.glsl>
+#endif
 
 void main(){
 	
+#ifdef FORWARD
+	AMG_Color = AMG_ComputeLight(0, vec4(AMG_BlendMap(1, 2, 3, 0, 4).rgb * AMG_ComputeShadows(5), 1));
+#else
 	AMG_ComputeDeferred(AMG_BlendMap(1, 2, 3, 0, 4).rgb * AMG_ComputeShadows(5) * AMG_MaterialDiffuse.rgb * AMG_DiffusePower, AMG_SpecularPower * AMG_SpecularReflectivity);
+#endif
 }
@@ -11,15 +11,22 @@ layout(location = 2) in vec3 AMG_Normal;
 #include <AMG_PassLighting.glsl>
 #include <AMG_PassLight.glsl>
 #include <AMG_WaterClipPlane.glsl>
+#ifdef FORWARD
+#include <AMG_PassShadows.glsl>
+#include <AMG_PassFog.glsl>
+#else
 #include <AMG_PassShadowsDeferred.glsl>
 #include <AMG_PassDeferred.glsl>
+#endif
 
 void main(){
 
+#ifndef FORWARD
 	AMG_WaterClipPlane(vec4(AMG_Position, 1));
 	
 	// Compute shadows
 	AMG_PassShadowsDeferred();
+#endif
     
     // Compute final vertex position
     AMG_ComputePosition();
@@ -27,5 +34,11 @@ void main(){
     // Pass data to the fragment shader
 	AMG_PassTexcoords();
 	
+#ifdef FORWARD
+	AMG_PassLighting(AMG_M);
+	AMG_PassLight(AMG_M, 0);
+	AMG_PassShadows();
+#else
 	AMG_PassDeferred(AMG_MV);
+#endif
 }
@@ -0,0 +1,327 @@
+/**
+ * @file AssetLoader.cpp
+ * @brief Loads assets in the background, and uploads them on the main thread
+ */
+
+// Includes C/C++
+#include <stdlib.h>
+
+// Includes OpenGL
+#include <GLFW/glfw3.h>
+
+// Own includes
+#include "AssetLoader.h"
+#include "Debug.h"
+#include "UploadPool.h"
+#include "FileSystem.h"
+
+namespace AMG {
+
+// Static variables
+std::vector<std::thread> AssetLoader::threads;
+std::deque<std::shared_ptr<Asset> > AssetLoader::requests;
+std::deque<std::shared_ptr<Asset> > AssetLoader::uploads;
+std::mutex AssetLoader::mutex;
+std::condition_variable AssetLoader::condition;
+bool AssetLoader::running = false;
+int AssetLoader::pending = 0;
+Texture *AssetLoader::placeholder = NULL;
+
+/**
+ * @brief Constructor for an Asset
+ * @param path Path of the asset
+ */
+Asset::Asset(const char *path) : path(path), state(AMG_ASSET_LOADING) {
+	this->error = NO_ERROR;
+}
+
+/**
+ * @brief Block until the asset is ready, uploading it if needed
+ * @note It must be called on the main thread
+ */
+void Asset::wait(){
+	AssetLoader::wait(this);
+}
+
+/**
+ * @brief Constructor for a Texture Asset
+ * @param path Location of the texture file (*.dds)
+ * @param srgb Load in sRGB format?
+ * @param placeholder Texture shown until the data is uploaded
+ */
+TextureAsset::TextureAsset(const char *path, bool srgb, Texture *placeholder) : Asset(path) {
+	this->srgb = srgb;
+	this->data.buffer = NULL;
+	this->staging = -1;
+	this->texture = new Texture();
+	this->texture->setPlaceholder(placeholder);
+}
+
+/**
+ * @brief Read the texture file, on a loader thread
+ * @note The data goes straight into a staging buffer, if there is one free
+ */
+void TextureAsset::read(){
+	error = Texture::readTexture(path.c_str(), srgb, &data, &staging);
+}
+
+/**
+ * @brief Create the texture, on the main thread
+ */
+void TextureAsset::upload(){
+	unsigned char *buffer = data.buffer;
+	if(staging >= 0) data.buffer = NULL;		// Offsets inside the staging buffer
+	UploadPool::begin(staging);
+	texture->create(&data);
+	UploadPool::end(staging, data.size);
+	if(staging < 0) free(buffer);
+	data.buffer = NULL;
+	staging = -1;
+}
+
+/**
+ * @brief Destructor for a Texture Asset
+ */
+TextureAsset::~TextureAsset(){
+	if(staging >= 0){
+		UploadPool::release(staging);
+	}else if(data.buffer){
+		free(data.buffer);
+	}
+}
+
+/**
+ * @brief Constructor for a Model Asset
+ * @param path Path for the *.amd or *.glb file
+ * @param tangent Use tangent space data?
+ */
+ModelAsset::ModelAsset(const char *path, bool tangent) : Asset(path) {
+	this->tangent = tangent;
+	this->model = new Model();
+}
+
+/**
+ * @brief Read and parse the model file, on a loader thread
+ * @note Meshes, materials, bones and animations are built here, their buffers stay in client memory
+ */
+void ModelAsset::read(){
+	int size = 0;
+	char *file = FileSystem::readFile(path.c_str(), AMG_MODEL, &size);
+	if(file == NULL){
+		error = FILE_NOT_FOUND;
+		return;
+	}
+	model->parse(path.c_str(), file, size, tangent, true);
+	free(file);
+}
+
+/**
+ * @brief Create the OpenGL buffers of the model, on the main thread
+ * @note Its textures are loaded in the background too
+ */
+void ModelAsset::upload(){
+	model->upload(true);
+}
+
+/**
+ * @brief Destructor for a Model Asset
+ */
+ModelAsset::~ModelAsset(){
+}
+
+/**
+ * @brief Constructor for a Sound Effect Asset
+ * @param path Path to the sound effect file
+ */
+SFXAsset::SFXAsset(const char *path) : Asset(path) {
+	this->data.data = NULL;
+	this->sfx = new SFX();
+}
+
+/**
+ * @brief Read and decode the sound file, on a loader thread
+ */
+void SFXAsset::read(){
+	error = SFX::readSound(path.c_str(), &data);
+}
+
+/**
+ * @brief Create the OpenAL buffer, on the main thread
+ */
+void SFXAsset::upload(){
+	sfx->create(&data);
+	free(data.data);
+	data.data = NULL;
+}
+
+/**
+ * @brief Destructor for a Sound Effect Asset
+ */
+SFXAsset::~SFXAsset(){
+	if(data.data) free(data.data);
+}
+
+/**
+ * @brief Start the loader threads
+ * @param nthreads Number of loader threads
+ */
+void AssetLoader::initialize(int nthreads){
+
+	// If it was initialised
+	if(running) return;
+
+	// Create the placeholder texture, a grey pixel
+	float grey[3] = {0.5f, 0.5f, 0.5f};
+	placeholder = new Texture();
+	placeholder->loadFloatData(1, 1, grey);
+
+	// Create the threads
+	running = true;
+	for(int i=0;i<nthreads;i++){
+		threads.push_back(std::thread(threadLoop));
+	}
+}
+
+/**
+ * @brief Main loop of a loader thread
+ */
+void AssetLoader::threadLoop(){
+	while(true){
+		std::shared_ptr<Asset> asset;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, []{ return !running || !requests.empty(); });
+			if(!running) return;
+			asset = requests.front();
+			requests.pop_front();
+		}
+		asset->read();
+		std::lock_guard<std::mutex> lock(mutex);
+		asset->state = AMG_ASSET_UPLOADING;
+		uploads.push_back(asset);
+	}
+}
+
+/**
+ * @brief Queue an asset to be read
+ * @param asset The asset
+ * @note If there are no loader threads, it is read right away
+ */
+void AssetLoader::submit(std::shared_ptr<Asset> asset){
+	pending ++;
+	if(threads.empty()){
+		asset->read();
+		asset->state = AMG_ASSET_UPLOADING;
+		uploads.push_back(asset);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		requests.push_back(asset);
+	}
+	condition.notify_one();
+}
+
+/**
+ * @brief Load a Texture in the background
+ * @param path Location of the texture file (*.dds)
+ * @param srgb Load in sRGB format?
+ * @return Handle of the asset, its texture shows a placeholder until it is ready
+ */
+std::shared_ptr<TextureAsset> AssetLoader::loadTexture(const char *path, bool srgb){
+	std::shared_ptr<TextureAsset> asset(new TextureAsset(path, srgb, placeholder));
+	submit(asset);
+	return asset;
+}
+
+/**
+ * @brief Load a Model in the background
+ * @param path Path for the *.amd or *.glb file
+ * @param tangent Use tangent space data?
+ * @return Handle of the asset, its model draws nothing until it is ready
+ */
+std::shared_ptr<ModelAsset> AssetLoader::loadModel(const char *path, bool tangent){
+	std::shared_ptr<ModelAsset> asset(new ModelAsset(path, tangent));
+	submit(asset);
+	return asset;
+}
+
+/**
+ * @brief Load a sound effect in the background
+ * @param path Path to the sound effect file
+ * @return Handle of the asset, its sound effect plays nothing until it is ready
+ */
+std::shared_ptr<SFXAsset> AssetLoader::loadSFX(const char *path){
+	std::shared_ptr<SFXAsset> asset(new SFXAsset(path));
+	submit(asset);
+	return asset;
+}
+
+/**
+ * @brief Upload the oldest asset already read
+ * @return Whether an asset was uploaded
+ */
+bool AssetLoader::uploadNext(){
+	std::shared_ptr<Asset> asset;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(uploads.empty()) return false;
+		asset = uploads.front();
+		uploads.pop_front();
+	}
+	if(asset->error != NO_ERROR) Debug::showError(asset->error, (void*)asset->getPath());
+	asset->upload();
+	asset->state = AMG_ASSET_READY;
+	pending --;
+	return true;
+}
+
+/**
+ * @brief Upload the assets already read, called once per frame
+ * @param budget Time limit for the uploads, in milliseconds
+ * @note At least one asset is uploaded, even if it takes longer than the budget
+ */
+void AssetLoader::update(double budget){
+	double start = glfwGetTime();
+	while(uploadNext()){
+		if((glfwGetTime() - start) * 1000.0 >= budget) break;
+	}
+}
+
+/**
+ * @brief Block until an asset is ready, uploading the assets read meanwhile
+ * @param asset The asset
+ */
+void AssetLoader::wait(Asset *asset){
+	while(asset->getState() != AMG_ASSET_READY){
+		if(!uploadNext()) std::this_thread::yield();
+	}
+}
+
+/**
+ * @brief Stop the loader threads, discarding the assets not loaded yet
+ */
+void AssetLoader::finish(){
+
+	// Stop the threads
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	condition.notify_all();
+	for(unsigned int i=0;i<threads.size();i++){
+		threads[i].join();
+	}
+	threads.clear();
+
+	// Discard the pending assets
+	requests.clear();
+	uploads.clear();
+	pending = 0;
+	if(placeholder){
+		delete placeholder;
+		placeholder = NULL;
+	}
+}
+
+}
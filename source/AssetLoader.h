@@ -0,0 +1,153 @@
+/**
+ * @file AssetLoader.h
+ * @brief Loads assets in the background, and uploads them on the main thread
+ */
+
+#ifndef ASSETLOADER_H_
+#define ASSETLOADER_H_
+
+// Includes C/C++
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Own includes
+#include "Texture.h"
+#include "Model.h"
+#include "SFX.h"
+
+// Defines
+#define AMG_LOADER_THREADS 2		/**< Default number of loader threads */
+#define AMG_LOADER_BUDGET 2.0		/**< Default time spent on uploads each frame, in milliseconds */
+
+namespace AMG {
+
+/**
+ * @enum AMG_AssetState
+ * @brief Loading state of an asset
+ */
+enum AMG_AssetState {
+	AMG_ASSET_LOADING = 0,		/**< Waiting for, or being read by, a loader thread */
+	AMG_ASSET_UPLOADING,		/**< Read, waiting for the main thread to upload it */
+	AMG_ASSET_READY,			/**< Ready to be used */
+};
+
+/**
+ * @class Asset
+ * @brief Handle of an asset being loaded, it works like a future
+ * @note The file is read and parsed by a loader thread (read), and the OpenGL/OpenAL
+ * objects are created on the main thread (upload)
+ */
+class Asset {
+	friend class AssetLoader;
+protected:
+	std::string path;				/**< Path of the asset */
+	std::atomic<int> state;			/**< Loading state, see AMG_AssetState */
+	int error;						/**< Error found while reading, see ErrorCodes */
+	virtual void read() = 0;
+	virtual void upload() = 0;
+public:
+	const char *getPath(){ return path.c_str(); }
+	int getState(){ return state.load(); }
+	bool isReady(){ return state.load() == AMG_ASSET_READY; }
+
+	Asset(const char *path);
+	void wait();
+	virtual ~Asset(){}
+};
+
+/**
+ * @class TextureAsset
+ * @brief Texture being loaded, it shows a placeholder until it is ready
+ */
+class TextureAsset : public Asset {
+private:
+	Texture *texture;				/**< Texture, created with the placeholder */
+	bool srgb;						/**< Load in sRGB format? */
+	AMG_TextureData data;			/**< Data read from the file */
+	int staging;					/**< UploadPool buffer which holds the data, -1 for client memory */
+	void read();
+	void upload();
+public:
+	Texture *get(){ return texture; }
+
+	TextureAsset(const char *path, bool srgb, Texture *placeholder);
+	virtual ~TextureAsset();
+};
+
+/**
+ * @class ModelAsset
+ * @brief Model being loaded, it draws nothing until it is ready
+ */
+class ModelAsset : public Asset {
+private:
+	Model *model;					/**< Model, parsed by the loader thread and drawn once it is uploaded */
+	bool tangent;					/**< Use tangent space data? */
+	void read();
+	void upload();
+public:
+	Model *get(){ return model; }
+
+	ModelAsset(const char *path, bool tangent);
+	virtual ~ModelAsset();
+};
+
+/**
+ * @class SFXAsset
+ * @brief Sound effect being loaded, it plays nothing until it is ready
+ * @note Like SFX, only *.wav files are supported. Music streams its *.ogg files while playing
+ */
+class SFXAsset : public Asset {
+private:
+	SFX *sfx;						/**< Sound effect, empty until it is uploaded */
+	AMG_SoundData data;				/**< PCM data read from the file */
+	void read();
+	void upload();
+public:
+	SFX *get(){ return sfx; }
+
+	SFXAsset(const char *path);
+	virtual ~SFXAsset();
+};
+
+/**
+ * @class AssetLoader
+ * @brief Static pool of loader threads, with a queue of uploads for the main thread
+ * @note The entities are created at once, so they can be used right away. The caller
+ * owns them as usual, but they must not be deleted while they are loading
+ */
+class AssetLoader {
+private:
+	static std::vector<std::thread> threads;					/**< Loader threads */
+	static std::deque<std::shared_ptr<Asset> > requests;		/**< Assets waiting to be read */
+	static std::deque<std::shared_ptr<Asset> > uploads;		/**< Assets waiting to be uploaded */
+	static std::mutex mutex;									/**< Protects both queues */
+	static std::condition_variable condition;					/**< Wakes up the loader threads */
+	static bool running;										/**< Loader threads must keep running? */
+	static int pending;											/**< Assets not ready yet */
+	static Texture *placeholder;								/**< Texture shown while a texture loads */
+	AssetLoader(){}
+	static void threadLoop();
+	static bool uploadNext();
+public:
+	static Texture *getPlaceholder(){ return placeholder; }
+	static int getNPending(){ return pending; }
+
+	static void initialize(int nthreads=AMG_LOADER_THREADS);
+	static void submit(std::shared_ptr<Asset> asset);
+	static std::shared_ptr<TextureAsset> loadTexture(const char *path, bool srgb=false);
+	static std::shared_ptr<ModelAsset> loadModel(const char *path, bool tangent=false);
+	static std::shared_ptr<SFXAsset> loadSFX(const char *path);
+	static void update(double budget=AMG_LOADER_BUDGET);
+	static void wait(Asset *asset);
+	static void finish();
+};
+
+}
+
+#endif
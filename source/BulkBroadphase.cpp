@@ -0,0 +1,80 @@
+/**
+ * @file BulkBroadphase.cpp
+ * @brief Dbvt broadphase which can build its tree for many bodies at once
+ */
+
+// Own includes
+#include "BulkBroadphase.h"
+
+namespace AMG {
+
+/**
+ * @brief Constructor for a Bulk Broadphase
+ */
+BulkBroadphase::BulkBroadphase(){
+	this->bulk = false;
+	this->deferred = false;
+}
+
+/**
+ * @brief Create the proxy of a collision object
+ * @note In bulk mode the leaf is created in an empty tree, so nothing is walked, and then kept aside
+ */
+btBroadphaseProxy *BulkBroadphase::createProxy(const btVector3 &aabbMin, const btVector3 &aabbMax, int shapeType, void *userPtr,
+		int collisionFilterGroup, int collisionFilterMask, btDispatcher *dispatcher){
+	if(!bulk) return btDbvtBroadphase::createProxy(aabbMin, aabbMax, shapeType, userPtr, collisionFilterGroup, collisionFilterMask, dispatcher);
+	btDbvtNode *root = m_sets[0].m_root;
+	m_sets[0].m_root = NULL;
+	btBroadphaseProxy *proxy = btDbvtBroadphase::createProxy(aabbMin, aabbMax, shapeType, userPtr, collisionFilterGroup, collisionFilterMask, dispatcher);
+	leaves.push_back(m_sets[0].m_root);
+	m_sets[0].m_root = root;
+	return proxy;
+}
+
+/**
+ * @brief Start creating proxies in bulk, their pairs are not searched until end()
+ */
+void BulkBroadphase::begin(){
+	if(bulk) return;
+	bulk = true;
+	deferred = m_deferedcollide;
+	m_deferedcollide = true;
+}
+
+/**
+ * @brief Build the dynamic tree with every proxy created since begin(), and find their pairs
+ * @param dispatcher Dispatcher of the collision world, to update the pair cache
+ * @note The leaves are joined under temporary nodes, which optimizeTopDown() releases
+ * while it builds the tree again from all of its leaves
+ */
+void BulkBroadphase::end(btDispatcher *dispatcher){
+	if(!bulk) return;
+	bulk = false;
+	if(!leaves.empty()){
+		if(m_sets[0].m_root) leaves.push_back(m_sets[0].m_root);
+		while(leaves.size() > 1){
+			unsigned int n = 0;
+			for(unsigned int i=0;i+1<leaves.size();i+=2){
+				btDbvtNode *node = new (btAlignedAlloc(sizeof(btDbvtNode), 16)) btDbvtNode();
+				Merge(leaves[i]->volume, leaves[i+1]->volume, node->volume);
+				node->parent = NULL;
+				node->childs[0] = leaves[i];
+				node->childs[1] = leaves[i+1];
+				leaves[i]->parent = node;
+				leaves[i+1]->parent = node;
+				leaves[n++] = node;
+			}
+			if(leaves.size() % 2) leaves[n++] = leaves.back();
+			leaves.resize(n);
+		}
+		m_sets[0].m_root = leaves[0];
+		m_sets[0].optimizeTopDown();
+		leaves.clear();
+	}
+
+	// A deferred pass collides the whole trees once
+	calculateOverlappingPairs(dispatcher);
+	m_deferedcollide = deferred;
+}
+
+}
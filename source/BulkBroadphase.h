@@ -0,0 +1,40 @@
+/**
+ * @file BulkBroadphase.h
+ * @brief Dbvt broadphase which can build its tree for many bodies at once
+ */
+
+#ifndef BULKBROADPHASE_H_
+#define BULKBROADPHASE_H_
+
+// Includes C/C++
+#include <vector>
+
+// Includes Bullet
+#include <btBulletCollisionCommon.h>
+
+namespace AMG {
+
+/**
+ * @class BulkBroadphase
+ * @brief Dbvt broadphase where the proxies created between begin() and end() are
+ * added to the tree in a single top-down build
+ * @note Bullet inserts each new proxy by walking the tree and then collides it against
+ * both trees. Here, bulk proxies are created out of the tree, and their pairs are found
+ * in a single pass when the tree is built
+ */
+class BulkBroadphase : public btDbvtBroadphase {
+private:
+	std::vector<btDbvtNode*> leaves;		/**< Leaves of the proxies created in bulk, not in the tree yet */
+	bool bulk;								/**< Are proxies being created in bulk? */
+	bool deferred;							/**< Previous value of m_deferedcollide */
+public:
+	BulkBroadphase();
+	virtual btBroadphaseProxy *createProxy(const btVector3 &aabbMin, const btVector3 &aabbMax, int shapeType, void *userPtr,
+			int collisionFilterGroup, int collisionFilterMask, btDispatcher *dispatcher);
+	void begin();
+	void end(btDispatcher *dispatcher);
+};
+
+}
+
+#endif
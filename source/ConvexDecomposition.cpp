@@ -0,0 +1,316 @@
+/**
+ * @file ConvexDecomposition.cpp
+ * @brief Approximate convex decomposition of concave meshes, for physics
+ */
+
+// Includes C/C++
+#include <float.h>
+#include <math.h>
+#include <deque>
+
+// Includes Bullet
+#include <LinearMath/btConvexHullComputer.h>
+
+// Own includes
+#include "ConvexDecomposition.h"
+
+namespace AMG {
+
+/**
+ * @brief Constructor for a Convex Decomposition
+ * @param vertices Mesh vertices (x, y, z)
+ * @param nvertices Number of vertices
+ * @param indices Triangle indices
+ * @param nindices Number of indices
+ * @note The mesh is voxelized here, call compute() to get the hulls
+ */
+ConvexDecomposition::ConvexDecomposition(const float *vertices, int nvertices, const unsigned short *indices, int nindices) {
+	this->totalVolume = 0.0f;
+	this->nlabels = 0;
+	this->splitPart = 0;
+	voxelize(vertices, nvertices, indices, nindices);
+}
+
+/**
+ * @brief Mark the voxels touched by the mesh surface, then fill the inside
+ * @param vertices Mesh vertices (x, y, z)
+ * @param nvertices Number of vertices
+ * @param indices Triangle indices
+ * @param nindices Number of indices
+ */
+void ConvexDecomposition::voxelize(const float *vertices, int nvertices, const unsigned short *indices, int nindices){
+
+	// Get the grid, with a border of empty voxels for the flood fill
+	vec3 low = vec3(FLT_MAX), high = vec3(-FLT_MAX);
+	for(int i=0;i<nvertices;i++){
+		vec3 v = vec3(vertices[i*3], vertices[i*3+1], vertices[i*3+2]);
+		low = glm::min(low, v);
+		high = glm::max(high, v);
+	}
+	vec3 extent = glm::max(high - low, vec3(0.0f));
+	float longest = glm::max(extent.x, glm::max(extent.y, extent.z));
+	if(longest <= 0.0f) longest = 1.0f;
+	voxelSize = longest / AMG_DECOMPOSITION_RESOLUTION;
+	origin = low - vec3(voxelSize);
+	size = ivec3(extent / voxelSize) + ivec3(3);
+	labels.assign(size.x * size.y * size.z, -1);
+
+	// Sample each triangle finer than the voxels
+	for(int i=0;i+2<nindices;i+=3){
+		vec3 a = vec3(vertices[indices[i]*3], vertices[indices[i]*3+1], vertices[indices[i]*3+2]);
+		vec3 b = vec3(vertices[indices[i+1]*3], vertices[indices[i+1]*3+1], vertices[indices[i+1]*3+2]);
+		vec3 c = vec3(vertices[indices[i+2]*3], vertices[indices[i+2]*3+1], vertices[indices[i+2]*3+2]);
+		float edge = glm::max(glm::length(b - a), glm::max(glm::length(c - a), glm::length(c - b)));
+		int steps = (int)(edge / (voxelSize * 0.5f)) + 1;
+		for(int u=0;u<=steps;u++){
+			for(int v=0;u+v<=steps;v++){
+				vec3 p = a + (b - a) * ((float)u / steps) + (c - a) * ((float)v / steps);
+				ivec3 cell = glm::clamp(ivec3((p - origin) / voxelSize), ivec3(0), size - ivec3(1));
+				labels[index(cell.x, cell.y, cell.z)] = 0;
+			}
+		}
+	}
+
+	// Flood fill the outside from a corner, everything else is solid
+	std::vector<char> outside(labels.size(), 0);
+	std::deque<ivec3> queue;
+	queue.push_back(ivec3(0, 0, 0));
+	outside[0] = 1;
+	const ivec3 dirs[6] = {ivec3(1, 0, 0), ivec3(-1, 0, 0), ivec3(0, 1, 0), ivec3(0, -1, 0), ivec3(0, 0, 1), ivec3(0, 0, -1)};
+	while(!queue.empty()){
+		ivec3 cell = queue.front();
+		queue.pop_front();
+		for(int d=0;d<6;d++){
+			ivec3 n = cell + dirs[d];
+			if(n.x < 0 || n.y < 0 || n.z < 0 || n.x >= size.x || n.y >= size.y || n.z >= size.z) continue;
+			int id = index(n.x, n.y, n.z);
+			if(outside[id] || labels[id] >= 0) continue;
+			outside[id] = 1;
+			queue.push_back(n);
+		}
+	}
+	for(unsigned int i=0;i<labels.size();i++){
+		if(!outside[i]) labels[i] = 0;
+	}
+}
+
+/**
+ * @brief Get the convex hull of a part, or of one side of a split plane
+ * @param part The part
+ * @param splitAxis Axis of the split plane, -1 to use the whole part
+ * @param split Voxel coordinate of the split plane
+ * @param below Use the voxels below the plane? Otherwise, the ones above
+ * @param nvoxels Where to store the number of voxels used
+ * @param hull Where to store the hull points, NULL if they are not needed
+ * @return The hull volume
+ */
+float ConvexDecomposition::evaluate(const AMG_DecompositionPart &part, int splitAxis, int split, bool below, int *nvoxels, std::vector<float> *hull){
+
+	// Only the voxels on the boundary can be hull vertices
+	std::vector<float> points;
+	ivec3 low = part.min, high = part.max;
+	if(splitAxis >= 0){
+		if(below) high[splitAxis] = glm::min(high[splitAxis], split - 1);
+		else low[splitAxis] = glm::max(low[splitAxis], split);
+	}
+	int count = 0;
+	for(int z=low.z;z<=high.z;z++){
+		for(int y=low.y;y<=high.y;y++){
+			for(int x=low.x;x<=high.x;x++){
+				if(labels[index(x, y, z)] != part.label) continue;
+				count ++;
+				bool boundary = (x == low.x || y == low.y || z == low.z || x == high.x || y == high.y || z == high.z)
+						|| labels[index(x-1, y, z)] != part.label || labels[index(x+1, y, z)] != part.label
+						|| labels[index(x, y-1, z)] != part.label || labels[index(x, y+1, z)] != part.label
+						|| labels[index(x, y, z-1)] != part.label || labels[index(x, y, z+1)] != part.label;
+				if(!boundary) continue;
+				for(int c=0;c<8;c++){
+					points.push_back(origin.x + (x + (c & 1)) * voxelSize);
+					points.push_back(origin.y + (y + ((c >> 1) & 1)) * voxelSize);
+					points.push_back(origin.z + (z + ((c >> 2) & 1)) * voxelSize);
+				}
+			}
+		}
+	}
+	*nvoxels = count;
+	if(count == 0) return 0.0f;
+
+	// Build the hull and add up the volume of the tetrahedra from its first vertex
+	btConvexHullComputer computer;
+	computer.compute(&points[0], 3 * sizeof(float), points.size() / 3, 0.0f, 0.0f);
+	float volume = 0.0f;
+	if(computer.vertices.size() > 0){
+		btVector3 &o = computer.vertices[0];
+		for(int f=0;f<computer.faces.size();f++){
+			const btConvexHullComputer::Edge *first = &computer.edges[computer.faces[f]];
+			const btConvexHullComputer::Edge *e = first->getNextEdgeOfFace();
+			btVector3 a = computer.vertices[first->getSourceVertex()] - o;
+			btVector3 b = computer.vertices[e->getSourceVertex()] - o;
+			for(e=e->getNextEdgeOfFace();e!=first;e=e->getNextEdgeOfFace()){
+				btVector3 c = computer.vertices[e->getSourceVertex()] - o;
+				volume += a.dot(b.cross(c));
+				b = c;
+			}
+		}
+	}
+
+	// Store the hull vertices
+	if(hull){
+		hull->clear();
+		for(int i=0;i<computer.vertices.size();i++){
+			btVector3 &v = computer.vertices[i];
+			hull->push_back(v.x());
+			hull->push_back(v.y());
+			hull->push_back(v.z());
+		}
+	}
+	return fabs(volume) / 6.0f;
+}
+
+/**
+ * @brief Get the concavity of a hull
+ * @param volume Hull volume
+ * @param nvoxels Number of voxels inside the hull
+ * @return Empty hull volume, relative to the hull of the whole mesh
+ */
+float ConvexDecomposition::concavity(float volume, int nvoxels){
+	if(totalVolume <= 0.0f) return 0.0f;
+	return glm::max(volume - nvoxels * voxelSize * voxelSize * voxelSize, 0.0f) / totalVolume;
+}
+
+/**
+ * @brief Update the bounds, voxel count and concavity of a part
+ * @param part The part
+ * @return The hull volume of the part
+ */
+float ConvexDecomposition::measure(AMG_DecompositionPart &part){
+	ivec3 low = part.max, high = part.min;
+	for(int z=part.min.z;z<=part.max.z;z++){
+		for(int y=part.min.y;y<=part.max.y;y++){
+			for(int x=part.min.x;x<=part.max.x;x++){
+				if(labels[index(x, y, z)] != part.label) continue;
+				low = glm::min(low, ivec3(x, y, z));
+				high = glm::max(high, ivec3(x, y, z));
+			}
+		}
+	}
+	part.min = low;
+	part.max = high;
+	float volume = evaluate(part, -1, 0, false, &part.nvoxels, NULL);
+	part.concavity = concavity(volume, part.nvoxels);
+	return volume;
+}
+
+/**
+ * @brief Test a split candidate, as a job
+ * @param data The ConvexDecomposition
+ * @param index Candidate index
+ */
+void ConvexDecomposition::candidateJob(void *data, int index){
+	ConvexDecomposition *d = (ConvexDecomposition*) data;
+	AMG_DecompositionPart &part = d->parts[d->splitPart];
+	ivec2 &candidate = d->candidates[index];
+	int nbelow = 0, nabove = 0;
+	float below = d->evaluate(part, candidate.x, candidate.y, true, &nbelow, NULL);
+	float above = d->evaluate(part, candidate.x, candidate.y, false, &nabove, NULL);
+	if(nbelow == 0 || nabove == 0){
+		d->costs[index] = FLT_MAX;
+	}else{
+		d->costs[index] = d->concavity(below, nbelow) + d->concavity(above, nabove);
+	}
+}
+
+/**
+ * @brief Split a part by the plane which leaves the least concavity
+ * @param p Part index
+ * @return Whether the part could be split
+ */
+bool ConvexDecomposition::split(int p){
+
+	// Candidate planes along every axis
+	AMG_DecompositionPart &part = parts[p];
+	candidates.clear();
+	for(int a=0;a<3;a++){
+		int low = part.min[a] + 1, high = part.max[a];
+		int step = glm::max((high - low + 1) / AMG_DECOMPOSITION_PLANES, 1);
+		for(int k=low;k<=high;k+=step){
+			candidates.push_back(ivec2(a, k));
+		}
+	}
+	if(candidates.empty()) return false;
+
+	// Test them on the worker threads
+	splitPart = p;
+	costs.assign(candidates.size(), FLT_MAX);
+	AMG_JobCounter counter(0);
+	JobSystem::parallelFor(candidateJob, this, candidates.size(), &counter);
+	JobSystem::wait(&counter);
+	int best = -1;
+	for(unsigned int i=0;i<candidates.size();i++){
+		if(costs[i] < FLT_MAX && (best < 0 || costs[i] < costs[best])) best = i;
+	}
+	if(best < 0) return false;
+
+	// Move the voxels above the plane to a new part
+	AMG_DecompositionPart upper = part;
+	upper.label = nlabels ++;
+	ivec2 plane = candidates[best];
+	for(int z=part.min.z;z<=part.max.z;z++){
+		for(int y=part.min.y;y<=part.max.y;y++){
+			for(int x=part.min.x;x<=part.max.x;x++){
+				int id = index(x, y, z);
+				if(labels[id] == part.label && ivec3(x, y, z)[plane.x] >= plane.y) labels[id] = upper.label;
+			}
+		}
+	}
+	measure(part);
+	measure(upper);
+	parts.push_back(upper);
+	return true;
+}
+
+/**
+ * @brief Split the mesh until the parts are convex enough, or there are too many parts
+ * @param maxHulls Maximum number of hulls
+ */
+void ConvexDecomposition::compute(int maxHulls){
+	parts.clear();
+	hulls.clear();
+
+	// Start with the whole mesh
+	AMG_DecompositionPart whole;
+	whole.label = 0;
+	whole.min = ivec3(0);
+	whole.max = size - ivec3(1);
+	nlabels = 1;
+	totalVolume = 0.0f;
+	totalVolume = measure(whole);
+	if(whole.nvoxels == 0) return;
+	whole.concavity = concavity(totalVolume, whole.nvoxels);
+	parts.push_back(whole);
+
+	// Split the most concave part each time
+	while((int)parts.size() < maxHulls){
+		int worst = 0;
+		for(unsigned int i=1;i<parts.size();i++){
+			if(parts[i].concavity > parts[worst].concavity) worst = i;
+		}
+		if(parts[worst].concavity < AMG_DECOMPOSITION_CONCAVITY) break;
+		if(!split(worst)) parts[worst].concavity = -1.0f;
+	}
+
+	// Get the hull of each part
+	hulls.resize(parts.size());
+	for(unsigned int i=0;i<parts.size();i++){
+		int n;
+		evaluate(parts[i], -1, 0, false, &n, &hulls[i]);
+	}
+}
+
+/**
+ * @brief Destructor for a Convex Decomposition
+ */
+ConvexDecomposition::~ConvexDecomposition() {
+}
+
+}
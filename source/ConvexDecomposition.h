@@ -0,0 +1,76 @@
+/**
+ * @file ConvexDecomposition.h
+ * @brief Approximate convex decomposition of concave meshes, for physics
+ */
+
+#ifndef CONVEXDECOMPOSITION_H_
+#define CONVEXDECOMPOSITION_H_
+
+// Includes C/C++
+#include <vector>
+
+// Includes OpenGL
+#include <glm/glm.hpp>
+using namespace glm;
+
+// Own includes
+#include "JobSystem.h"
+
+// Defines
+#define AMG_DECOMPOSITION_RESOLUTION 32		/**< Voxels along the longest side of the mesh */
+#define AMG_DECOMPOSITION_CONCAVITY 0.02f	/**< Parts less concave than this are not split */
+#define AMG_DECOMPOSITION_PLANES 8			/**< Candidate split planes per axis */
+#define AMG_DECOMPOSITION_HULLS 16			/**< Default maximum number of hulls */
+
+namespace AMG {
+
+/**
+ * @struct AMG_DecompositionPart
+ * @brief A convex part of the decomposition, made of voxels
+ */
+typedef struct{
+	int label;					/**< Label of its voxels */
+	ivec3 min;					/**< Minimum voxel coordinates */
+	ivec3 max;					/**< Maximum voxel coordinates */
+	int nvoxels;				/**< Number of voxels */
+	float concavity;			/**< Hull volume not filled by voxels, relative to the whole mesh hull */
+}AMG_DecompositionPart;
+
+/**
+ * @class ConvexDecomposition
+ * @brief Splits a mesh into a bounded number of convex hulls, V-HACD style
+ * @note The mesh is voxelized and the most concave part is clipped by axis aligned planes,
+ * until the maximum number of hulls is reached. Split candidates are tested on the JobSystem
+ */
+class ConvexDecomposition {
+private:
+	ivec3 size;									/**< Grid size, in voxels */
+	vec3 origin;								/**< Position of the grid corner */
+	float voxelSize;							/**< Voxel side length */
+	std::vector<int> labels;					/**< Part label of each voxel, -1 for empty voxels */
+	std::vector<AMG_DecompositionPart> parts;	/**< Current parts */
+	std::vector<std::vector<float> > hulls;		/**< Hull points (x, y, z) of each part */
+	float totalVolume;							/**< Hull volume of the whole mesh */
+	int nlabels;								/**< Number of labels used */
+	int splitPart;								/**< Part whose split candidates are being tested */
+	std::vector<ivec2> candidates;				/**< Candidate split planes (axis, voxel coordinate) */
+	std::vector<float> costs;					/**< Concavity after each candidate split */
+	int index(int x, int y, int z){ return (z * size.y + y) * size.x + x; }
+	void voxelize(const float *vertices, int nvertices, const unsigned short *indices, int nindices);
+	float evaluate(const AMG_DecompositionPart &part, int splitAxis, int split, bool below, int *nvoxels, std::vector<float> *hull);
+	float concavity(float volume, int nvoxels);
+	float measure(AMG_DecompositionPart &part);
+	bool split(int p);
+	static void candidateJob(void *data, int index);
+public:
+	int getNHulls(){ return hulls.size(); }
+	std::vector<float> &getHull(int i){ return hulls[i]; }
+
+	ConvexDecomposition(const float *vertices, int nvertices, const unsigned short *indices, int nindices);
+	void compute(int maxHulls);
+	virtual ~ConvexDecomposition();
+};
+
+}
+
+#endif
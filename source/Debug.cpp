@@ -5,6 +5,7 @@
 // Includes C/C++
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 
 // Own includes
 #include "Debug.h"
@@ -12,6 +13,9 @@
 
 namespace AMG {
 
+// Static variables
+bool Debug::verbose = false;
+
 /**
  * @brief Show an error and exit program
  * @param code Error code
@@ -76,6 +80,9 @@ void Debug::showError(int code, void *param){
 		case 18:
 			fprintf(stderr, "Couldn't create an audio context\n");
 			break;
+		case 19:
+			fprintf(stderr, "Texture array layer doesn't match the first one: %s\n", (char*)param);
+			break;
 		default:
 			fprintf(stderr, "Unknown error\n");
 			break;
@@ -87,4 +94,17 @@ void Debug::showError(int code, void *param){
 	exit(1);
 }
 
+/**
+ * @brief Print a message, only if the verbose mode is enabled
+ * @param format Format of the message, as in printf
+ */
+void Debug::log(const char *format, ...){
+	if(!verbose) return;
+	va_list args;
+	va_start(args, format);
+	vfprintf(stdout, format, args);
+	va_end(args);
+	fflush(stdout);
+}
+
 }
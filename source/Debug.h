@@ -31,6 +31,7 @@ enum ErrorCodes {
 	NO_VERTEX_DATA,					/**< When accessing unexistent vertex data (in a MeshData) */
 	NO_AUDIO_DEVICE,				/**< When an audio device is not supported */
 	NO_AUDIO_CONTEXT,				/**< When an audio context can't be created */
+	TEXTURE_ARRAY_MISMATCH,			/**< When a texture array layer doesn't match the first one */
 };
 
 /**
@@ -38,8 +39,12 @@ enum ErrorCodes {
  * @brief Utility and debug functions
  */
 class Debug {
+private:
+	static bool verbose;			/**< Are the log messages printed? */
 public:
+	static bool &isVerbose(){ return verbose; }
 	static void showError(int code, void *param);
+	static void log(const char *format, ...);
 };
 
 }
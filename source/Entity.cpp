@@ -5,46 +5,65 @@
 
 // Includes C/C++
 #include <stdio.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
 
 // Own includes
 #include "Entity.h"
+#include "FileSystem.h"
 
 namespace AMG {
 
-static char _fullpath[256];
-int Entity::nEntities = 0;
+static thread_local char _fullpath[256];		// One buffer per thread, so loader threads can build paths
+std::atomic<int> Entity::nEntities(0);
 
 /**
  * @brief Get the full path of an Entity
  * @param path The short path
  * @param type Type of entity we are referring, see EntityTypes
- * @return The full path for this Entity
+ * @return The full path for this Entity, valid until the next call on the same thread
+ * @note Files should be read through the FileSystem, which also looks in the pack file
  */
 char *Entity::getFullPath(const char *path, int type){
-	switch(type){
-		case AMG_MODEL:
-			sprintf(_fullpath, "Data/Model/%s", path);
-			break;
-		case AMG_FONT:
-			sprintf(_fullpath, "Data/Font/%s", path);
-			break;
-		case AMG_TEXTURE:
-			sprintf(_fullpath, "Data/Texture/%s", path);
-			break;
-		case AMG_SHADER:
-			sprintf(_fullpath, "Data/Shader/%s", path);
-			break;
-		case AMG_AUDIO:
-			sprintf(_fullpath, "Data/Audio/%s", path);
-			break;
-		case AMG_SHADERLIB:
-			sprintf(_fullpath, "Data/Shader/Engine/%s", path);
-			break;
-		default: break;
-	}
+	FileSystem::getPath(path, type, _fullpath, sizeof(_fullpath));
 	return _fullpath;
 }
 
+/**
+ * @brief Open a file in the cache folder, creating the folder if needed
+ * @param name Name of the file, inside the cache folder
+ * @param write Open it for writing? Otherwise it's opened for reading
+ * @return The opened file (binary mode), NULL if it could not be opened
+ */
+FILE *Entity::openCacheFile(const char *name, bool write){
+	if(!write) return fopen(getFullPath(name, AMG_CACHE), "rb");
+#ifdef _WIN32
+	_mkdir("Data/Cache");
+#else
+	mkdir("Data/Cache", 0755);
+#endif
+	return fopen(getFullPath(name, AMG_CACHE), "wb");
+}
+
+/**
+ * @brief Hash a block of data (64-bit FNV-1a), used to identify cached data
+ * @param data Data to be hashed
+ * @param size Size of the data, in bytes
+ * @param seed Previous hash, to hash several blocks together
+ * @return The hash value
+ */
+unsigned long long Entity::hash(const void *data, int size, unsigned long long seed){
+	const unsigned char *bytes = (const unsigned char*) data;
+	unsigned long long h = seed;
+	for(int i=0;i<size;i++){
+		h ^= bytes[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
 /**
  * @brief Constructor of an Entity
  */
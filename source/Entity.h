@@ -7,7 +7,12 @@
 #define ENTITY_H_
 
 // Includes C/C++
+#include <stdio.h>
 #include <vector>
+#include <atomic>
+
+// Defines
+#define AMG_HASH_SEED 14695981039346656037ULL	/**< Initial value of an FNV-1a hash */
 
 namespace AMG {
 
@@ -22,6 +27,7 @@ enum EntityTypes {
 	AMG_SHADER = 3,
 	AMG_AUDIO = 4,
 	AMG_SHADERLIB = 5,
+	AMG_CACHE = 6,
 };
 
 /**
@@ -30,9 +36,11 @@ enum EntityTypes {
  */
 class Entity {
 public:
-	static int nEntities;						/**< Number of entities */
+	static std::atomic<int> nEntities;			/**< Number of entities, they can be created by the loader threads */
 	Entity();
 	static char *getFullPath(const char *path, int type);
+	static FILE *openCacheFile(const char *name, bool write);
+	static unsigned long long hash(const void *data, int size, unsigned long long seed=AMG_HASH_SEED);
 	virtual ~Entity();
 	static void destroyEntities();
 };
@@ -0,0 +1,426 @@
+/**
+ * @file FileSystem.cpp
+ * @brief Virtual file system, over loose files or a pack file
+ */
+
+// Includes C/C++
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Includes LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+
+// Own includes
+#include "FileSystem.h"
+#include "Entity.h"
+
+namespace AMG {
+
+// Static variables
+char *FileSystem::base = NULL;
+long long FileSystem::mappedSize = 0;
+const AMG_PackEntry *FileSystem::entries = NULL;
+const char *FileSystem::names = NULL;
+int FileSystem::nfiles = 0;
+void *FileSystem::fileHandle = NULL;
+void *FileSystem::mappingHandle = NULL;
+std::atomic<long long> FileSystem::readBytes(0);
+std::atomic<long long> FileSystem::readTime(0);
+std::atomic<int> FileSystem::readFiles(0);
+
+// Folder of each type of entity, see EntityTypes
+static const char *folders[] = {
+	"Font/", "Model/", "Texture/", "Shader/", "Audio/", "Shader/Engine/", "Cache/",
+};
+
+/**
+ * @brief Get the current time, for the read statistics
+ * @return Time in microseconds
+ */
+static long long now(){
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Map a pack file, so its files are read from it
+ * @param pack Path of the pack file
+ * @return Whether the pack was mounted
+ * @note Called by the Renderer. If there is no pack, the Data folder is used
+ */
+bool FileSystem::mount(const char *pack){
+	unmount();
+
+	// Map the whole file
+#ifdef _WIN32
+	HANDLE file = CreateFileA(pack, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER length;
+	GetFileSizeEx(file, &length);
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mapping == NULL){
+		CloseHandle(file);
+		return false;
+	}
+	base = (char*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	fileHandle = file;
+	mappingHandle = mapping;
+	mappedSize = length.QuadPart;
+#else
+	int file = open(pack, O_RDONLY);
+	if(file < 0) return false;
+	struct stat info;
+	fstat(file, &info);
+	void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	base = (data == MAP_FAILED) ? NULL : (char*) data;
+	mappedSize = info.st_size;
+#endif
+	if(base == NULL){
+		unmount();
+		return false;
+	}
+
+	// Check the header
+	AMG_PackHeader *header = (AMG_PackHeader*) base;
+	if(mappedSize < (long long)sizeof(AMG_PackHeader) || memcmp(header->magic, "AMGP", 4) != 0 || header->version != AMG_PACK_VERSION
+			|| header->indexOffset + (long long)((unsigned long long)header->nfiles * sizeof(AMG_PackEntry)) > mappedSize){
+		fprintf(stderr, "Warning: %s is not a valid pack file\n", pack);
+		fflush(stderr);
+		unmount();
+		return false;
+	}
+	nfiles = header->nfiles;
+	entries = (const AMG_PackEntry*) (base + header->indexOffset);
+	names = (const char*) (entries + nfiles);
+
+	// Check every entry, so find and read never go outside the mapping. The name table runs to the end of the file
+	long long namesSize = mappedSize - (names - base);
+	for(int i=0;i<nfiles;i++){
+		const AMG_PackEntry *entry = &entries[i];
+		if((long long)entry->offset + entry->packedSize > mappedSize || entry->packedSize > entry->size || entry->nameOffset >= namesSize
+				|| memchr(names + entry->nameOffset, 0, namesSize - entry->nameOffset) == NULL){
+			fprintf(stderr, "Warning: %s has an invalid entry\n", pack);
+			fflush(stderr);
+			unmount();
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Unmap the pack file, files are read from the Data folder again
+ */
+void FileSystem::unmount(){
+#ifdef _WIN32
+	if(base) UnmapViewOfFile(base);
+	if(mappingHandle) CloseHandle((HANDLE)mappingHandle);
+	if(fileHandle) CloseHandle((HANDLE)fileHandle);
+#else
+	if(base) munmap(base, mappedSize);
+#endif
+	base = NULL;
+	mappedSize = 0;
+	fileHandle = NULL;
+	mappingHandle = NULL;
+	entries = NULL;
+	names = NULL;
+	nfiles = 0;
+}
+
+/**
+ * @brief Get the path of a file inside the Data folder
+ * @param path The short path
+ * @param type Type of entity we are referring, see EntityTypes
+ * @param buffer Where to store the path
+ * @param size Size of the buffer
+ */
+void FileSystem::getPath(const char *path, int type, char *buffer, int size){
+	snprintf(buffer, size, "Data/%s%s", folders[type], path);
+}
+
+/**
+ * @brief Find a file in the pack
+ * @param path The short path
+ * @param type Type of entity we are referring, see EntityTypes
+ * @return The index entry, NULL if it is not in the pack
+ */
+const AMG_PackEntry *FileSystem::find(const char *path, int type){
+	if(base == NULL) return NULL;
+
+	// Hash the name, relative to the Data folder
+	char name[AMG_PATH_SIZE];
+	snprintf(name, AMG_PATH_SIZE, "%s%s", folders[type], path);
+	unsigned long long h = Entity::hash(name, strlen(name));
+
+	// Binary search, checking the names of equal hashes
+	const AMG_PackEntry *end = entries + nfiles;
+	const AMG_PackEntry *entry = std::lower_bound(entries, end, h, [](const AMG_PackEntry &e, unsigned long long value){
+		return e.hash < value;
+	});
+	for(;entry != end && entry->hash == h;entry++){
+		if(strcmp(names + entry->nameOffset, name) == 0) return entry;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Copy the start of a packed file, decompressing it if needed
+ * @param entry The index entry
+ * @param dst Where to copy the data
+ * @param size Bytes to copy, from the start of the file
+ * @return Whether the data could be copied
+ */
+bool FileSystem::unpack(const AMG_PackEntry *entry, char *dst, int size){
+	const char *src = base + entry->offset;
+	if(entry->packedSize == entry->size){
+		memcpy(dst, src, size);
+		return true;
+	}
+	return LZ4_decompress_safe_partial(src, dst, entry->packedSize, size, size) >= size;
+}
+
+/**
+ * @brief Update the read statistics
+ * @param start When the read started, in microseconds
+ * @param bytes Bytes read
+ */
+void FileSystem::count(long long start, int bytes){
+	readTime += now() - start;
+	readBytes += bytes;
+	readFiles ++;
+}
+
+/**
+ * @brief Check whether a file exists
+ * @param path The short path
+ * @param type Type of entity we are referring, see EntityTypes
+ * @return Whether the file is in the pack or in the Data folder
+ */
+bool FileSystem::exists(const char *path, int type){
+	if(find(path, type)) return true;
+	char fullpath[AMG_PATH_SIZE];
+	getPath(path, type, fullpath, AMG_PATH_SIZE);
+	FILE *f = fopen(fullpath, "rb");
+	if(f == NULL) return false;
+	fclose(f);
+	return true;
+}
+
+/**
+ * @brief Read a whole file into memory
+ * @param path The short path
+ * @param type Type of entity we are referring, see EntityTypes
+ * @param size Size of the file, in bytes (output)
+ * @return The file data followed by a zero (to be released with free), NULL if it could not be read
+ */
+char *FileSystem::readFile(const char *path, int type, int *size){
+	long long start = now();
+	char *data = NULL;
+	*size = 0;
+
+	// From the pack
+	const AMG_PackEntry *entry = find(path, type);
+	if(entry){
+		data = (char*) malloc (entry->size + 1);
+		if(unpack(entry, data, entry->size)){
+			*size = entry->size;
+		}else{
+			free(data);
+			data = NULL;
+		}
+
+	// Or from the Data folder
+	}else{
+		char fullpath[AMG_PATH_SIZE];
+		getPath(path, type, fullpath, AMG_PATH_SIZE);
+		FILE *f = fopen(fullpath, "rb");
+		if(f == NULL) return NULL;
+		fseek(f, 0, SEEK_END);
+		long length = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		data = (char*) malloc (length + 1);
+		if(fread(data, 1, length, f) == (size_t)length){
+			*size = (int)length;
+		}else{
+			free(data);
+			data = NULL;
+		}
+		fclose(f);
+	}
+
+	if(data) data[*size] = 0;
+	count(start, *size);
+	return data;
+}
+
+/**
+ * @brief Read a part of a file
+ * @param path The short path
+ * @param type Type of entity we are referring, see EntityTypes
+ * @param dst Where to store the data
+ * @param offset Where to start reading, in bytes
+ * @param size Bytes to read
+ * @return Bytes read, -1 if the file could not be opened
+ * @note Reading the end of a compressed file decompresses all of it, so big files which are
+ * read in parts (textures, music) are better stored uncompressed
+ */
+int FileSystem::read(const char *path, int type, void *dst, int offset, int size){
+	long long start = now();
+	int n = 0;
+
+	// From the pack
+	const AMG_PackEntry *entry = find(path, type);
+	if(entry){
+		if(offset >= (int)entry->size) return 0;
+		n = std::min(size, (int)entry->size - offset);
+		if(entry->packedSize == entry->size){
+			memcpy(dst, base + entry->offset + offset, n);
+		}else{
+			char *buffer = (char*) malloc (offset + n);
+			if(!unpack(entry, buffer, offset + n)) n = 0;
+			memcpy(dst, buffer + offset, n);
+			free(buffer);
+		}
+
+	// Or from the Data folder
+	}else{
+		char fullpath[AMG_PATH_SIZE];
+		getPath(path, type, fullpath, AMG_PATH_SIZE);
+		FILE *f = fopen(fullpath, "rb");
+		if(f == NULL) return -1;
+		fseek(f, offset, SEEK_SET);
+		n = fread(dst, 1, size, f);
+		fclose(f);
+	}
+
+	count(start, n);
+	return n;
+}
+
+/**
+ * @brief Get a file straight from the mapped pack, without copying it
+ * @param path The short path
+ * @param type Type of entity we are referring, see EntityTypes
+ * @param size Size of the file, in bytes (output)
+ * @return The file data, NULL if it is not in the pack or it is compressed
+ */
+const char *FileSystem::map(const char *path, int type, int *size){
+	const AMG_PackEntry *entry = find(path, type);
+	if(entry == NULL || entry->packedSize != entry->size) return NULL;
+	*size = entry->size;
+	return base + entry->offset;
+}
+
+/**
+ * @brief List the files in a folder and its subfolders
+ * @param dir Folder to list
+ * @param prefix Prefix for the file names, relative to the root folder
+ * @param files Where to add the file names
+ * @note Hidden files and the Cache folder are skipped
+ */
+void FileSystem::listFiles(const char *dir, const char *prefix, std::vector<std::string> &files){
+	DIR *d = opendir(dir);
+	if(d == NULL) return;
+	struct dirent *ent;
+	while((ent = readdir(d)) != NULL){
+		if(ent->d_name[0] == '.') continue;
+		std::string path = std::string(dir) + "/" + ent->d_name;
+		std::string name = std::string(prefix) + ent->d_name;
+		struct stat info;
+		if(stat(path.c_str(), &info) != 0) continue;
+		if(S_ISDIR(info.st_mode)){
+			if(name != "Cache") listFiles(path.c_str(), (name + "/").c_str(), files);
+		}else{
+			files.push_back(name);
+		}
+	}
+	closedir(d);
+}
+
+/**
+ * @brief Create a pack file with the contents of a folder
+ * @param dir Folder to pack, usually "Data"
+ * @param pack Path of the pack file
+ * @return Whether the pack could be written
+ */
+bool FileSystem::build(const char *dir, const char *pack){
+
+	// Get the files
+	std::vector<std::string> files;
+	listFiles(dir, "", files);
+	FILE *f = fopen(pack, "wb");
+	if(f == NULL) return false;
+	AMG_PackHeader header;
+	memcpy(header.magic, "AMGP", 4);
+	header.version = AMG_PACK_VERSION;
+	header.nfiles = files.size();
+	header.indexOffset = 0;
+	fwrite(&header, sizeof(AMG_PackHeader), 1, f);
+
+	// Store each file, compressed if it is worth it
+	std::vector<AMG_PackEntry> index;
+	std::string nameTable;
+	for(unsigned int i=0;i<files.size();i++){
+		std::string path = std::string(dir) + "/" + files[i];
+		FILE *in = fopen(path.c_str(), "rb");
+		if(in == NULL) continue;
+		fseek(in, 0, SEEK_END);
+		int size = ftell(in);
+		fseek(in, 0, SEEK_SET);
+		char *data = (char*) malloc (size + 1);
+		size = fread(data, 1, size, in);
+		fclose(in);
+
+		int bound = LZ4_compressBound(size);
+		char *packed = (char*) malloc (bound + 1);
+		int packedSize = LZ4_compress_HC(data, packed, size, bound, LZ4HC_CLEVEL_DEFAULT);
+
+		AMG_PackEntry entry;
+		entry.hash = Entity::hash(files[i].c_str(), files[i].size());
+		entry.offset = ftell(f);
+		entry.size = size;
+		entry.nameOffset = nameTable.size();
+		if(packedSize > 0 && packedSize < size * AMG_PACK_RATIO){
+			entry.packedSize = packedSize;
+			fwrite(packed, 1, packedSize, f);
+		}else{
+			entry.packedSize = size;
+			fwrite(data, 1, size, f);
+		}
+		index.push_back(entry);
+		nameTable.append(files[i].c_str(), files[i].size() + 1);
+		free(data);
+		free(packed);
+	}
+
+	// Write the index, sorted by hash, and the names
+	while(ftell(f) % 8) fputc(0, f);
+	std::sort(index.begin(), index.end(), [](const AMG_PackEntry &a, const AMG_PackEntry &b){
+		return a.hash < b.hash;
+	});
+	header.nfiles = index.size();
+	header.indexOffset = ftell(f);
+	if(!index.empty()) fwrite(&index[0], sizeof(AMG_PackEntry), index.size(), f);
+	fwrite(nameTable.c_str(), 1, nameTable.size(), f);
+	fseek(f, 0, SEEK_SET);
+	fwrite(&header, sizeof(AMG_PackHeader), 1, f);
+	fclose(f);
+	return true;
+}
+
+}
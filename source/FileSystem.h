@@ -0,0 +1,88 @@
+/**
+ * @file FileSystem.h
+ * @brief Virtual file system, over loose files or a pack file
+ */
+
+#ifndef FILESYSTEM_H_
+#define FILESYSTEM_H_
+
+// Includes C/C++
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Defines
+#define AMG_PACK_FILE "Data.pak"		/**< Default pack file, next to the Data folder */
+#define AMG_PACK_VERSION 1				/**< Version of the pack format */
+#define AMG_PACK_RATIO 0.9f				/**< Files are stored compressed only if they shrink below this ratio */
+#define AMG_PATH_SIZE 256				/**< Size of the path buffers */
+
+namespace AMG {
+
+/**
+ * @struct AMG_PackHeader
+ * @brief Header of a pack file
+ */
+typedef struct{
+	char magic[4];						/**< Signature, "AMGP" */
+	unsigned int version;				/**< Pack format version */
+	unsigned int nfiles;				/**< Number of files */
+	unsigned int indexOffset;			/**< Where the index starts, followed by the file names */
+}AMG_PackHeader;
+
+/**
+ * @struct AMG_PackEntry
+ * @brief Entry of the pack index, which is sorted by hash
+ */
+typedef struct{
+	unsigned long long hash;			/**< Hash of the file name */
+	unsigned int offset;				/**< Where the file data starts */
+	unsigned int size;					/**< Size of the file, in bytes */
+	unsigned int packedSize;			/**< Size of the LZ4 data, equal to size if stored uncompressed */
+	unsigned int nameOffset;			/**< File name, inside the name table */
+}AMG_PackEntry;
+
+/**
+ * @class FileSystem
+ * @brief Reads the engine data from a memory mapped pack, or from the Data folder
+ * @note Files are looked up in the pack first, and then in the Data folder. Every read function
+ * is thread-safe, so the loader threads can use them
+ */
+class FileSystem {
+private:
+	static char *base;								/**< Mapped pack file, NULL if there is no pack */
+	static long long mappedSize;					/**< Size of the mapping, in bytes */
+	static const AMG_PackEntry *entries;			/**< Pack index */
+	static const char *names;						/**< Pack name table */
+	static int nfiles;								/**< Number of files in the pack */
+	static void *fileHandle;						/**< Pack file handle (Windows) */
+	static void *mappingHandle;						/**< File mapping handle (Windows) */
+	static std::atomic<long long> readBytes;		/**< Bytes read since the start */
+	static std::atomic<long long> readTime;			/**< Time spent reading, in microseconds */
+	static std::atomic<int> readFiles;				/**< Number of reads since the start */
+	FileSystem(){}
+	static const AMG_PackEntry *find(const char *path, int type);
+	static bool unpack(const AMG_PackEntry *entry, char *dst, int size);
+	static void count(long long start, int bytes);
+public:
+	static bool isMounted(){ return base != NULL; }
+	static int getNFiles(){ return nfiles; }
+	static long long getReadBytes(){ return readBytes.load(); }
+	static double getReadTime(){ return readTime.load() / 1000.0; }
+	static int getNReads(){ return readFiles.load(); }
+
+	static bool mount(const char *pack=AMG_PACK_FILE);
+	static void unmount();
+	static void getPath(const char *path, int type, char *buffer, int size);
+	static bool exists(const char *path, int type);
+	static bool isPacked(const char *path, int type){ return find(path, type) != NULL; }
+	static char *readFile(const char *path, int type, int *size);
+	static int read(const char *path, int type, void *dst, int offset, int size);
+	static const char *map(const char *path, int type, int *size);
+	static void listFiles(const char *dir, const char *prefix, std::vector<std::string> &files);
+	static bool build(const char *dir, const char *pack);
+};
+
+}
+
+#endif
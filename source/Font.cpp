@@ -13,9 +13,27 @@
 // Own includes
 #include "Font.h"
 #include "Debug.h"
+#include "FileSystem.h"
 
 namespace AMG {
 
+/**
+ * @brief Read a line from a file already in memory, the way fgets does
+ * @param line Where to store the line
+ * @param size Size of the line buffer
+ * @param cursor Current position in the file, it is advanced
+ * @param end End of the file
+ */
+static void readLine(char *line, int size, const char **cursor, const char *end){
+	int n = 0;
+	while(*cursor < end && n < size - 1){
+		char c = *(*cursor)++;
+		line[n++] = c;
+		if(c == '\n') break;
+	}
+	line[n] = 0;
+}
+
 /**
  * @brief Constructor for a Font
  */
@@ -28,24 +46,27 @@ Font::Font(const char *tex, const char *fnt){
 	// Create the glyph map
 	glyphs = std::tr1::unordered_map<char, AMG_Glyph*>();
 
-	// Open the font file
-	FILE *f = fopen(getFullPath(fnt, AMG_FONT), "rb");
-	if(f == NULL) Debug::showError(FILE_NOT_FOUND, (void*)fnt);
+	// Read the font file
+	int size = 0;
+	char *file = FileSystem::readFile(fnt, AMG_FONT, &size);
+	if(file == NULL) Debug::showError(FILE_NOT_FOUND, (void*)fnt);
+	const char *f = file;
+	const char *end = file + size;
 
 	// Read the header lines
 	float fontSize = 0.0f;
 	char line[256];
-	fgets(line, 256, f);
+	readLine(line, 256, &f, end);
 	sscanf(line, "info face=%*s size=%f", &fontSize);
-	fgets(line, 256, f);
+	readLine(line, 256, &f, end);
 	sscanf(line, "common lineHeight=%f", &lineHeight);
 	lineHeight += 8;
 	lineHeight /= fontSize;
 
 	// Get the number of characters
 	do{
-		fgets(line, 256, f);
-	}while(strncmp(line, "chars", 5) != 0);
+		readLine(line, 256, &f, end);
+	}while(strncmp(line, "chars", 5) != 0 && f < end);
 	int nchars = 0;
 	sscanf(line, "chars count=%d", &nchars);
 
@@ -55,7 +76,7 @@ Font::Font(const char *tex, const char *fnt){
 	// Read each glyph
 	for(int i=0;i<nchars;i++){
 		AMG_Glyph *glyph = &glyphBuffer[i];
-		fgets(line, 256, f);
+		readLine(line, 256, &f, end);
 		int id;
 		sscanf(line+5, "id=%d x=%f y=%f width=%f height=%f xoffset=%f yoffset=%f xadvance=%f",
 						&id, &glyph->x, &glyph->y, &glyph->width, &glyph->height, &glyph->xoffset, &glyph->yoffset, &glyph->advance);
@@ -77,8 +98,8 @@ Font::Font(const char *tex, const char *fnt){
 	// Set the space size
 	this->spaceSize = glyphs[' ']->advance;
 
-	// Close the font file
-	fclose(f);
+	// Release the font file
+	free(file);
 }
 
 /**
@@ -102,9 +123,49 @@ AMG_Glyph *Font::getCharacter(char c){
  */
 Text *Font::createText(char *text, float size, float width, float height, int *remaining){
 
+	// Create buffers
+	int bufferSize = strlen(text) * 12;
+	float *vertices = (float*) calloc (bufferSize, sizeof(float));
+	float *texcoords = (float*) calloc (bufferSize, sizeof(float));
+
+	// Write the glyphs and create the text object
+	int textBufferSize = layoutText(text, size, width, height, vertices, texcoords, remaining);
+	Text *t = new Text(vertices, texcoords, textBufferSize * sizeof(float), this->font);
+
+	// Free data
+	free(vertices);
+	free(texcoords);
+
+	// Return the created text
+	return t;
+}
+
+/**
+ * @brief Create a text object whose string can change every frame
+ * @param size Size of the text
+ * @param width Textbox width, in pixels
+ * @param height Textbox height, in pixels
+ * @note Its glyphs are written to the streaming buffer when it's drawn, there are no buffers to recreate
+ */
+Text *Font::createDynamicText(float size, float width, float height){
+	return new Text(this, this->font, size, width, height);
+}
+
+/**
+ * @brief Write the glyph quads of a text
+ * @param text The text to be rendered, in extended ASCII format
+ * @param size Size of the text
+ * @param width Textbox width, in pixels
+ * @param height Textbox height, in pixels
+ * @param vertices Where to write the vertices, room for 12 floats per character
+ * @param texcoords Where to write the texture coordinates, room for 12 floats per character
+ * @param remaining Position where it stopped writing text, if it didn't fit
+ * @return Number of floats written to each buffer
+ */
+int Font::layoutText(char *text, float size, float width, float height, float *vertices, float *texcoords, int *remaining){
+
 	// Get size of the string
 	int nchars = strlen(text);
-	int writeLen = 0;
 	int written = 0;
 
 	// Organize the text in words
@@ -117,15 +178,11 @@ Text *Font::createText(char *text, float size, float width, float height, int *r
 		int l = strlen(pch);
 		wordsSize.push_back(l);
 		words.push_back(pch);
-		writeLen += l;
 		pch = strtok (NULL, " ");
 	}
 
-	// Create buffers
-	int bufferSize = writeLen * 6 * 2;
+	// Start writing
 	int textBufferSize = 0;
-	float *vertices = (float*) calloc (bufferSize, sizeof(float));
-	float *texcoords = (float*) calloc (bufferSize, sizeof(float));
 	float cursorX = 0.0f;
 	float cursorY = 0.0f;
 
@@ -215,16 +272,9 @@ Text *Font::createText(char *text, float size, float width, float height, int *r
 		cursorX += this->spaceSize * size;
 	}
 
-	// Create text object
-	Text *t = new Text(vertices, texcoords, textBufferSize * sizeof(float), this->font);
-
 	// Free data
-	free(vertices);
-	free(texcoords);
 	free(tbuf);
-
-	// Return the created text
-	return t;
+	return textBufferSize;
 }
 
 /**
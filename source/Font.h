@@ -48,6 +48,8 @@ public:
 
 	Font(const char *tex, const char *fnt);
 	Text *createText(char *text, float size, float width, float height, int *remaining);
+	Text *createDynamicText(float size, float width, float height);
+	int layoutText(char *text, float size, float width, float height, float *vertices, float *texcoords, int *remaining);
 	virtual ~Font();
 };
 
@@ -117,11 +117,12 @@ void Framebuffer::createColorAttachments(int n){
 
 /**
  * @brief Creates a depth texture for this Framebuffer
+ * @param format Internal depth format, it must match the depth buffer when it's blitted from a multisampled one
  */
-void Framebuffer::createDepthTexture(){
+void Framebuffer::createDepthTexture(GLuint format){
 	GLuint id = (msFbo) ? msFbo : fbo;
 	glBindFramebuffer(GL_FRAMEBUFFER, id);
-	depthTexture = new Texture(width, height, GL_DEPTH_COMPONENT16, GL_DEPTH_COMPONENT, GL_DEPTH_ATTACHMENT);
+	depthTexture = new Texture(width, height, format, GL_DEPTH_COMPONENT, GL_DEPTH_ATTACHMENT);
 	unbind();
 }
 
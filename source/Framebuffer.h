@@ -40,7 +40,7 @@ public:
 	Framebuffer();
 	Framebuffer(int w, int h, int n=0, int samples=0);
 	void createColorTexture(int attachment, GLuint format1=GL_RGB, GLuint format2=GL_RGB, GLuint type=GL_UNSIGNED_BYTE);
-	void createDepthTexture();
+	void createDepthTexture(GLuint format=GL_DEPTH_COMPONENT16);
 	void start();
 	void end();
 	void bind();
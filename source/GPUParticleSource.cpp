@@ -0,0 +1,351 @@
+/**
+ * @file GPUParticleSource.cpp
+ * @brief A source for tons of particles, simulated on the GPU
+ */
+
+// Includes C/C++
+#include <stdlib.h>
+
+// Own includes
+#include "GPUParticleSource.h"
+#include "Renderer.h"
+#include "Debug.h"
+
+// Defines
+#define AMG_GPU_PARTICLE_STRIDE (AMG_GPU_PARTICLE_FLOATS * sizeof(float))	/**< Stride for the particle buffers */
+
+namespace AMG {
+
+// Static variables
+Shader *GPUParticleSource::updateShader = NULL;
+
+/**
+ * @brief Outputs captured by the simulation shader, in buffer order
+ */
+static const char *particleVaryings[] = {
+	"AMG_TFPosition", "AMG_TFScaleFrame", "AMG_TFVelocity", "AMG_TFLife",
+};
+
+/**
+ * @brief Initialize the GPU particle engine
+ */
+void GPUParticleSource::initialize(){
+	updateShader = new Shader("Effects/AMG_ParticlesUpdate", particleVaryings, 4);
+	updateShader->defineUniform("deltaTime");
+	updateShader->defineUniform("randomSeed");
+	updateShader->defineUniform("emitCount");
+	updateShader->defineUniform("emitPosition");
+	updateShader->defineUniform("emitVelocity");
+	updateShader->defineUniform("emitParams");
+	updateShader->defineUniform("collision");
+	updateShader->defineUniform("invProjection");
+	updateShader->defineUniform("sceneDepth");
+}
+
+/**
+ * @brief Finish the GPU particle engine
+ */
+void GPUParticleSource::finish(){
+	AMG_DELETE(updateShader);
+}
+
+/**
+ * @brief Constructor for a GPU Particle Source
+ * @param texPath Texture atlas path
+ * @param hframes Number of horizontal frames
+ * @param vframes Number of vertical frames
+ * @param maxparticles Maximum number of particles
+ * @note Without GPU counting support, the particle count is read back after each update
+ */
+GPUParticleSource::GPUParticleSource(const char *texPath, int hframes, int vframes, int maxparticles) {
+
+	// Choose how to count the particles
+	this->gpuCount = GLEW_ARB_transform_feedback2 && GLEW_ARB_query_buffer_object && GLEW_ARB_draw_indirect;
+	this->maxparticles = maxparticles;
+	this->nparticles = 0;
+	this->current = 0;
+	this->first = true;
+
+	// Default emission, nothing is emitted
+	this->emitRate = 0.0f;
+	this->emitTimer = 0.0f;
+	this->emitPosition = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+	this->emitVelocity = vec4(0.0f, 0.0f, 0.0f, 0.0f);
+	this->emitParams = vec3(1.0f, 1.0f, 0.0f);
+	this->collision = vec3(0.0f, 0.0f, 0.0f);
+
+	// Create the particle buffers and their VAOs
+	glGenBuffers(2, buffers);
+	glGenVertexArrays(2, updateVao);
+	glGenVertexArrays(2, renderVao);
+	if(gpuCount) glGenTransformFeedbacks(2, feedback);
+	for(int i=0;i<2;i++){
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+		glBufferData(GL_ARRAY_BUFFER, maxparticles * AMG_GPU_PARTICLE_STRIDE, NULL, GL_DYNAMIC_COPY);
+		glBindVertexArray(updateVao[i]);
+		setupAttributes(false);
+		glBindVertexArray(renderVao[i]);
+		setupAttributes(true);
+		if(gpuCount){
+			glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback[i]);
+			glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[i]);
+		}
+	}
+	if(gpuCount) glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+
+	// Buffer for the particles added from the CPU
+	glGenBuffers(1, &pendingVbo);
+	glBindBuffer(GL_ARRAY_BUFFER, pendingVbo);
+	glBufferData(GL_ARRAY_BUFFER, AMG_GPU_PARTICLE_PENDING * AMG_GPU_PARTICLE_STRIDE, NULL, GL_STREAM_DRAW);
+	glGenVertexArrays(1, &pendingVao);
+	glBindVertexArray(pendingVao);
+	setupAttributes(false);
+	glGenVertexArrays(1, &emitVao);
+	glBindVertexArray(0);
+	pending.reserve(AMG_GPU_PARTICLE_PENDING * AMG_GPU_PARTICLE_FLOATS);
+
+	// Indirect draw command: a quad per particle
+	glGenQueries(1, &query);
+	indirect = 0;
+	if(gpuCount){
+		GLuint command[4] = {6, 0, 0, 0};
+		glGenBuffers(1, &indirect);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), command, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	atlas = NULL;
+	atlas = new Texture(texPath, hframes, vframes, true);
+}
+
+/**
+ * @brief Set the vertex attributes of the bound VAO, reading the bound array buffer
+ * @param instanced Read only position, rotation, scale and frame for instanced rendering?
+ */
+void GPUParticleSource::setupAttributes(bool instanced){
+	if(instanced){
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, AMG_GPU_PARTICLE_STRIDE, (void*)0);
+		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, AMG_GPU_PARTICLE_STRIDE, (void*)(4 * sizeof(float)));
+		glVertexAttribDivisor(2, 1);
+		glVertexAttribDivisor(3, 1);
+		return;
+	}
+	int sizes[4] = {4, 2, 4, 2};
+	int offset = 0;
+	for(int i=0;i<4;i++){
+		glEnableVertexAttribArray(i);
+		glVertexAttribPointer(i, sizes[i], GL_FLOAT, GL_FALSE, AMG_GPU_PARTICLE_STRIDE, (void*)(offset * sizeof(float)));
+		offset += sizes[i];
+	}
+}
+
+/**
+ * @brief Add a new particle to this source, it will be sent to the GPU on the next update
+ * @param p Initial state of the particle
+ * @return Whether the particle was added, false if too many particles were added since the last update
+ */
+bool GPUParticleSource::addParticle(Particle p){
+	if(pending.size() >= AMG_GPU_PARTICLE_PENDING * AMG_GPU_PARTICLE_FLOATS) return false;
+	vec3 &pos = p.getPosition();
+	vec3 &vel = p.getVelocity();
+	float data[AMG_GPU_PARTICLE_FLOATS] = {
+		pos.x, pos.y, pos.z, p.getRotation(),
+		p.getScale(), 0.0f,
+		vel.x, vel.y, vel.z, p.getMass(),
+		0.0f, p.getLifeLength(),
+	};
+	pending.insert(pending.end(), data, data + AMG_GPU_PARTICLE_FLOATS);
+	return true;
+}
+
+/**
+ * @brief Set the particles this source emits on its own
+ * @param p Initial state of each emitted particle
+ * @param rate Particles emitted per second, 0 to stop emitting
+ * @param spread Random variation added to each velocity component
+ * @note Up to AMG_GPU_PARTICLE_MAX_EMIT particles are emitted per update, so the maximum rate is
+ * that times the update rate (245760 per second at 60 fps). Particles over the limit are kept for
+ * the next updates, up to one more update worth, see getEmissionBacklog()
+ */
+void GPUParticleSource::setEmission(Particle p, float rate, float spread){
+	this->emitRate = rate;
+	this->emitPosition = vec4(p.getPosition(), p.getRotation());
+	this->emitVelocity = vec4(p.getVelocity(), p.getMass());
+	this->emitParams = vec3(p.getLifeLength(), p.getScale(), spread);
+}
+
+/**
+ * @brief Make the particles collide against the depth buffer of the 3D scene
+ * @param enabled Enable collisions?
+ * @param bounce Fraction of the normal velocity kept after a collision
+ * @param friction Fraction of the tangential velocity lost on each collision
+ * @param thickness Depth behind the visible surfaces considered solid, in view units
+ * @note Only what is on screen collides. Call update() after drawing the opaque geometry
+ * so the depth is up to date (with multisampling, it's the depth of the previous frame)
+ */
+void GPUParticleSource::setCollision(bool enabled, float bounce, float friction, float thickness){
+	this->collision = (enabled) ? vec3(bounce, friction, thickness) : vec3(0.0f, 0.0f, 0.0f);
+}
+
+/**
+ * @brief Emit, simulate and kill the particles in this source
+ * @note The current shader is restored afterwards
+ */
+void GPUParticleSource::update(){
+
+	// Set the simulation uniforms
+	Shader *previous = Renderer::getCurrentShader();
+	updateShader->enable();
+	float delta = Renderer::getDelta();
+	float seed = (float)(rand() % 1024);
+	vec2 frames = vec2(atlas->getHorizontalFrames(), atlas->getVerticalFrames());
+	updateShader->setUniform("deltaTime", delta);
+	updateShader->setUniform("randomSeed", seed);
+	updateShader->setUniform("emitCount", 0);
+	updateShader->setUniform("emitPosition", emitPosition);
+	updateShader->setUniform("emitVelocity", emitVelocity);
+	updateShader->setUniform("emitParams", emitParams);
+	updateShader->setUniform(AMG_TexFrames, frames);
+
+	// Collide against the depth buffer of the 3D scene
+	Texture *depth = Renderer::get3dFramebuffer()->getDepthTexture();
+	vec3 col = (depth) ? collision : vec3(0.0f, 0.0f, 0.0f);
+	updateShader->setUniform("collision", col);
+	if(col.z > 0.0f){
+		updateShader->setUniform(AMG_V, Renderer::getView());
+		updateShader->setUniform(AMG_P, Renderer::getProjection());
+		mat4 invProjection = glm::inverse(Renderer::getProjection());
+		updateShader->setUniform("invProjection", invProjection);
+		updateShader->setUniform("sceneDepth", 0);
+		depth->bind(0);
+	}
+
+	// Capture the simulated particles onto the other buffer
+	int next = 1 - current;
+	glEnable(GL_RASTERIZER_DISCARD);
+	if(gpuCount){
+		glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback[next]);
+	}else{
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[next]);
+	}
+	glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, query);
+	glBeginTransformFeedback(GL_POINTS);
+
+	// Simulate the current particles
+	glBindVertexArray(updateVao[current]);
+	if(first){
+		// Nothing to simulate yet
+	}else if(gpuCount){
+		glDrawTransformFeedback(GL_POINTS, feedback[current]);
+	}else{
+		glDrawArrays(GL_POINTS, 0, nparticles);
+	}
+
+	// Append the particles added from the CPU
+	int npending = pending.size() / AMG_GPU_PARTICLE_FLOATS;
+	if(npending > 0){
+		glBindBuffer(GL_ARRAY_BUFFER, pendingVbo);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, pending.size() * sizeof(float), &pending[0]);
+		glBindVertexArray(pendingVao);
+		glDrawArrays(GL_POINTS, 0, npending);
+		pending.clear();
+	}
+
+	// Emit the new particles in batches, the remainder is carried to the next update
+	emitTimer = glm::min(emitTimer + delta * emitRate, 2.0f * AMG_GPU_PARTICLE_MAX_EMIT);
+	int nemit = glm::min((int)emitTimer, AMG_GPU_PARTICLE_MAX_EMIT);
+	emitTimer -= nemit;
+	if(nemit > 0){
+		updateShader->setUniform("emitCount", nemit);
+		glBindVertexArray(emitVao);
+		glDrawArrays(GL_POINTS, 0, (nemit + AMG_GPU_PARTICLE_EMIT_BATCH - 1) / AMG_GPU_PARTICLE_EMIT_BATCH);
+	}
+
+	glEndTransformFeedback();
+	glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+	if(gpuCount) glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+	glDisable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(0);
+
+	// Store the particle count as the instance count of the indirect draw, or read it back
+	if(gpuCount){
+		glBindBuffer(GL_QUERY_BUFFER, indirect);
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT, (GLuint*)sizeof(GLuint));
+		glBindBuffer(GL_QUERY_BUFFER, 0);
+	}else{
+		GLuint written = 0;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT, &written);
+		nparticles = written;
+	}
+
+	current = next;
+	first = false;
+	if(previous) previous->enable();
+}
+
+/**
+ * @brief Draw all the particles in this source, using the current (particles) shader
+ * @param Blending function to apply
+ * @note Particles are not sorted, use additive blending
+ */
+void GPUParticleSource::draw(GLuint alphaFunc){
+
+	// Set blending
+	glDepthMask(false);
+	glBlendFunc(GL_SRC_ALPHA, alphaFunc);
+
+	// Bind buffers
+	glBindVertexArray(renderVao[current]);
+	for(int i=0;i<4;i++){
+		glEnableVertexAttribArray(i);
+	}
+	Renderer::bindQuad(false);
+
+	// Bind texture
+	atlas->bind(0);
+
+	// Per frame uniforms, the billboards are expanded in the vertex shader
+	Shader *shader = Renderer::getCurrentShader();
+	vec2 frames = vec2(atlas->getHorizontalFrames(), atlas->getVerticalFrames());
+	shader->setUniform(AMG_V, Renderer::getView());
+	shader->setUniform(AMG_P, Renderer::getProjection());
+	shader->setUniform(AMG_TexFrames, frames);
+	Renderer::setModel(mat4(1.0f));
+	Renderer::updateMVP();
+
+	// Draw all particles
+	if(gpuCount){
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect);
+		glDrawArraysIndirect(GL_TRIANGLES, NULL);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}else{
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, nparticles);
+	}
+
+	// Restore blend function
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(true);
+	for(int i=0;i<4;i++){
+		glDisableVertexAttribArray(i);
+	}
+	glBindVertexArray(0);
+}
+
+/**
+ * @brief Destructor for a GPU Particle source
+ */
+GPUParticleSource::~GPUParticleSource() {
+	AMG_DELETE(atlas);
+	glDeleteBuffers(2, buffers);
+	glDeleteVertexArrays(2, updateVao);
+	glDeleteVertexArrays(2, renderVao);
+	if(gpuCount) glDeleteTransformFeedbacks(2, feedback);
+	glDeleteBuffers(1, &pendingVbo);
+	glDeleteVertexArrays(1, &pendingVao);
+	glDeleteVertexArrays(1, &emitVao);
+	glDeleteQueries(1, &query);
+	if(indirect) glDeleteBuffers(1, &indirect);
+}
+
+}
@@ -0,0 +1,78 @@
+/**
+ * @file GPUParticleSource.h
+ * @brief A source for tons of particles, simulated on the GPU
+ */
+
+#ifndef GPUPARTICLESOURCE_H_
+#define GPUPARTICLESOURCE_H_
+
+// Includes C/C++
+#include <vector>
+
+// Includes OpenGL
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+// Own includes
+#include "Entity.h"
+#include "Particle.h"
+#include "Texture.h"
+#include "Shader.h"
+
+// Defines
+#define AMG_GPU_PARTICLE_FLOATS 12		/**< Floats per particle: position, rotation, scale, frame, velocity, mass, age and life length */
+#define AMG_GPU_PARTICLE_PENDING 256	/**< Maximum number of particles added from the CPU between updates */
+#define AMG_GPU_PARTICLE_EMIT_BATCH 64	/**< Particles emitted by each point of the emission pass (AMG_EMIT_BATCH in the shader) */
+#define AMG_GPU_PARTICLE_MAX_EMIT 4096	/**< Maximum number of particles emitted per update */
+
+namespace AMG {
+
+/**
+ * @class GPUParticleSource
+ * @brief Holds a number of particles, which are emitted, simulated and killed using transform feedback
+ * @note The particle count never goes back to the CPU, so the CPU cost is the same for any number of particles
+ */
+class GPUParticleSource : private Entity {
+private:
+	static Shader *updateShader;		/**< Shader which simulates the particles */
+	Texture *atlas;						/**< Texture atlas for this source */
+	GLuint buffers[2];					/**< Particle state, ping-ponged on every update */
+	GLuint feedback[2];					/**< Transform feedback object writing to each buffer */
+	GLuint updateVao[2];				/**< VAO reading each buffer for the simulation */
+	GLuint renderVao[2];				/**< VAO reading each buffer as instanced data */
+	GLuint pendingVbo;					/**< Particles added from the CPU */
+	GLuint pendingVao;					/**< VAO reading the added particles */
+	GLuint emitVao;						/**< Empty VAO for the emission pass */
+	GLuint query;						/**< Counts the particles written by the simulation */
+	GLuint indirect;					/**< Indirect draw command, its instance count is written by the query */
+	int current;						/**< Buffer holding the latest particles */
+	int maxparticles;					/**< Maximum number of particles */
+	int nparticles;						/**< Particles written by the last update (only used without GPU counting) */
+	bool gpuCount;						/**< Are the particles counted on the GPU? */
+	bool first;							/**< Is the next update the first one? */
+	std::vector<float> pending;			/**< Particles added since the last update */
+	float emitRate;						/**< Particles emitted per second */
+	float emitTimer;					/**< Particles due but not emitted yet, the fraction and what was over the limit */
+	vec4 emitPosition;					/**< Emission position and initial rotation */
+	vec4 emitVelocity;					/**< Initial velocity and mass */
+	vec3 emitParams;					/**< Life length, scale and velocity spread of the emitted particles */
+	vec3 collision;						/**< Bounce, friction and thickness of the depth buffer collisions, no collisions if the thickness is 0 */
+	void setupAttributes(bool instanced);
+public:
+	int getMaxParticles(){ return maxparticles; }
+	float getEmissionBacklog(){ return emitTimer; }
+
+	static void initialize();
+	static void finish();
+	GPUParticleSource(const char *texPath, int hframes, int vframes, int maxparticles);
+	bool addParticle(Particle p);
+	void setEmission(Particle p, float rate, float spread);
+	void setCollision(bool enabled, float bounce=0.5f, float friction=0.2f, float thickness=0.5f);
+	void update();
+	void draw(GLuint alphaFunc);
+	virtual ~GPUParticleSource();
+};
+
+}
+
+#endif
@@ -0,0 +1,159 @@
+/**
+ * @file JobSystem.cpp
+ * @brief Worker threads used to run engine jobs in parallel
+ */
+
+// Own includes
+#include "JobSystem.h"
+
+namespace AMG {
+
+// Static variables
+std::vector<std::thread> JobSystem::workers;
+std::deque<AMG_Job> JobSystem::jobs;
+std::mutex JobSystem::mutex;
+std::condition_variable JobSystem::condition;
+bool JobSystem::running = false;
+
+/**
+ * @brief Start the worker threads
+ * @param nthreads Number of workers, 0 to use one less than the number of cores
+ */
+void JobSystem::initialize(int nthreads){
+
+	// If it was initialised
+	if(running) return;
+
+	// Get the number of workers
+	if(nthreads <= 0){
+		nthreads = (int)std::thread::hardware_concurrency() - 1;
+		if(nthreads < 1) nthreads = 1;
+	}
+
+	// Create the workers
+	running = true;
+	for(int i=0;i<nthreads;i++){
+		workers.push_back(std::thread(workerLoop));
+	}
+}
+
+/**
+ * @brief Main loop of a worker thread
+ */
+void JobSystem::workerLoop(){
+	while(true){
+		AMG_Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, []{ return !running || !jobs.empty(); });
+			if(jobs.empty()) return;		// Not running and nothing left to do
+			job = jobs.front();
+			jobs.pop_front();
+		}
+		run(job);
+	}
+}
+
+/**
+ * @brief Run a job and notify its counter
+ * @param job The job to run
+ */
+void JobSystem::run(AMG_Job &job){
+	job.callback(job.data, job.index);
+	if(job.counter) job.counter->fetch_sub(1);
+}
+
+/**
+ * @brief Run one pending job on the calling thread
+ * @return Whether a job was run
+ */
+bool JobSystem::runPending(){
+	AMG_Job job;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(jobs.empty()) return false;
+		job = jobs.front();
+		jobs.pop_front();
+	}
+	run(job);
+	return true;
+}
+
+/**
+ * @brief Queue a job
+ * @param callback Function to run
+ * @param data User data for the callback
+ * @param index Index passed to the callback
+ * @param counter Counter to track the job, can be NULL
+ * @note Jobs can be submitted from other jobs, but only wait from threads outside the pool
+ */
+void JobSystem::submit(AMG_JobCallback callback, void *data, int index, AMG_JobCounter *counter){
+	AMG_Job job = {callback, data, index, counter};
+	if(counter) counter->fetch_add(1);
+	if(workers.empty()){
+		run(job);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(job);
+	}
+	condition.notify_one();
+}
+
+/**
+ * @brief Queue a group of jobs, with indices from 0 to count - 1
+ * @param callback Function to run
+ * @param data User data for the callback
+ * @param count Number of jobs
+ * @param counter Counter to track the jobs, can be NULL
+ */
+void JobSystem::parallelFor(AMG_JobCallback callback, void *data, int count, AMG_JobCounter *counter){
+	if(count <= 0) return;
+	if(counter) counter->fetch_add(count);
+	if(workers.empty()){
+		for(int i=0;i<count;i++){
+			AMG_Job job = {callback, data, i, counter};
+			run(job);
+		}
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for(int i=0;i<count;i++){
+			AMG_Job job = {callback, data, i, counter};
+			jobs.push_back(job);
+		}
+	}
+	condition.notify_all();
+}
+
+/**
+ * @brief Wait until all the jobs tracked by a counter are done
+ * @param counter The counter to wait for
+ * @note The calling thread runs pending jobs meanwhile
+ */
+void JobSystem::wait(AMG_JobCounter *counter){
+	while(counter->load() > 0){
+		if(!runPending()){
+			std::this_thread::yield();
+		}
+	}
+}
+
+/**
+ * @brief Finish the pending jobs and stop the worker threads
+ */
+void JobSystem::finish(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	condition.notify_all();
+	for(unsigned int i=0;i<workers.size();i++){
+		workers[i].join();
+	}
+	workers.clear();
+}
+
+}
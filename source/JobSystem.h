@@ -0,0 +1,73 @@
+/**
+ * @file JobSystem.h
+ * @brief Worker threads used to run engine jobs in parallel
+ */
+
+#ifndef JOBSYSTEM_H_
+#define JOBSYSTEM_H_
+
+// Includes C/C++
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AMG {
+
+/**
+ * @typedef AMG_JobCallback
+ * @brief Function run by a job
+ * @param data User data given when submitting the job
+ * @param index Job index, from 0 to the number of jobs submitted together
+ */
+typedef void (*AMG_JobCallback)(void *data, int index);
+
+/**
+ * @typedef AMG_JobCounter
+ * @brief Counts the pending jobs of a group, zero when all of them are done
+ */
+typedef std::atomic<int> AMG_JobCounter;
+
+/**
+ * @struct AMG_Job
+ * @brief A queued job
+ */
+typedef struct{
+	AMG_JobCallback callback;		/**< Function to run */
+	void *data;						/**< User data */
+	int index;						/**< Job index */
+	AMG_JobCounter *counter;		/**< Counter decremented when the job finishes */
+}AMG_Job;
+
+/**
+ * @class JobSystem
+ * @brief Static pool of worker threads
+ * @note If there are no workers, jobs are run as soon as they are submitted
+ */
+class JobSystem {
+private:
+	static std::vector<std::thread> workers;	/**< Worker threads */
+	static std::deque<AMG_Job> jobs;			/**< Pending jobs */
+	static std::mutex mutex;					/**< Protects the job queue */
+	static std::condition_variable condition;	/**< Wakes up the workers */
+	static bool running;						/**< Workers must keep running? */
+	JobSystem(){}
+	static void workerLoop();
+	static bool runPending();
+	static void run(AMG_Job &job);
+public:
+	static int getNThreads(){ return workers.size(); }
+	static bool isDone(AMG_JobCounter *counter){ return counter->load() == 0; }
+
+	static void initialize(int nthreads=0);
+	static void submit(AMG_JobCallback callback, void *data, int index, AMG_JobCounter *counter);
+	static void parallelFor(AMG_JobCallback callback, void *data, int count, AMG_JobCounter *counter);
+	static void wait(AMG_JobCounter *counter);
+	static void finish();
+};
+
+}
+
+#endif
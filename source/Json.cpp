@@ -0,0 +1,209 @@
+/**
+ * @file Json.cpp
+ * @brief Minimal JSON parser, used to read glTF files
+ */
+
+// Includes C/C++
+#include <stdlib.h>
+#include <string.h>
+
+// Own includes
+#include "Json.h"
+
+// Defines
+#define AMG_JSON_DEPTH 64		/**< Maximum nesting of arrays and objects */
+
+namespace AMG {
+
+// Static variables
+const JsonValue JsonValue::null;
+
+/**
+ * @brief Constructor for a null JSON value
+ */
+JsonValue::JsonValue() {
+	this->type = AMG_JSON_NULL;
+	this->number = 0.0;
+}
+
+/**
+ * @brief Skip white space
+ * @param p Current position
+ * @param end End of the text
+ * @return The first position which is not white space
+ */
+static const char *skip(const char *p, const char *end){
+	while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+	return p;
+}
+
+/**
+ * @brief Parse a JSON text
+ * @param text The text, it does not need to end with a zero
+ * @param size Size of the text, in bytes
+ * @return Whether it is valid JSON
+ */
+bool JsonValue::parse(const char *text, int size){
+	const char *end = text + size;
+	const char *p = parse(text, end, 0);
+	return p != NULL && skip(p, end) == end;
+}
+
+/**
+ * @brief Parse a string, after its opening quote
+ * @param p Current position
+ * @param end End of the text
+ * @param out The string, as UTF-8
+ * @return The position after the closing quote, NULL if it is not valid
+ */
+const char *JsonValue::parseString(const char *p, const char *end, std::string &out){
+	while(p < end && *p != '"'){
+		if(*p != '\\'){
+			out += *p++;
+			continue;
+		}
+		if(++p >= end) return NULL;
+		switch(*p++){
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':{
+				if(end - p < 4) return NULL;
+				char hex[5] = {p[0], p[1], p[2], p[3], 0};
+				unsigned int c = strtoul(hex, NULL, 16);
+				p += 4;
+				if(c < 0x80){
+					out += (char)c;
+				}else if(c < 0x800){
+					out += (char)(0xC0 | (c >> 6));
+					out += (char)(0x80 | (c & 0x3F));
+				}else{
+					out += (char)(0xE0 | (c >> 12));
+					out += (char)(0x80 | ((c >> 6) & 0x3F));
+					out += (char)(0x80 | (c & 0x3F));
+				}
+				break;
+			}
+			default: return NULL;
+		}
+	}
+	return (p < end) ? p + 1 : NULL;
+}
+
+/**
+ * @brief Parse a value
+ * @param p Current position
+ * @param end End of the text
+ * @param depth Nesting level of this value
+ * @return The position after the value, NULL if it is not valid
+ */
+const char *JsonValue::parse(const char *p, const char *end, int depth){
+	p = skip(p, end);
+	if(p >= end || depth > AMG_JSON_DEPTH) return NULL;
+
+	// Objects
+	if(*p == '{'){
+		type = AMG_JSON_OBJECT;
+		p = skip(p + 1, end);
+		if(p < end && *p == '}') return p + 1;
+		while(p < end){
+			std::string key;
+			if(*p != '"' || (p = parseString(p + 1, end, key)) == NULL) return NULL;
+			p = skip(p, end);
+			if(p >= end || *p != ':') return NULL;
+			keys.push_back(key);
+			items.push_back(JsonValue());
+			if((p = items.back().parse(p + 1, end, depth + 1)) == NULL) return NULL;
+			p = skip(p, end);
+			if(p < end && *p == '}') return p + 1;
+			if(p >= end || *p != ',') return NULL;
+			p = skip(p + 1, end);
+		}
+		return NULL;
+	}
+
+	// Arrays
+	if(*p == '['){
+		type = AMG_JSON_ARRAY;
+		p = skip(p + 1, end);
+		if(p < end && *p == ']') return p + 1;
+		while(p < end){
+			items.push_back(JsonValue());
+			if((p = items.back().parse(p, end, depth + 1)) == NULL) return NULL;
+			p = skip(p, end);
+			if(p < end && *p == ']') return p + 1;
+			if(p >= end || *p != ',') return NULL;
+			p++;
+		}
+		return NULL;
+	}
+
+	// Strings
+	if(*p == '"'){
+		type = AMG_JSON_STRING;
+		return parseString(p + 1, end, string);
+	}
+
+	// Literals
+	if(end - p >= 4 && strncmp(p, "true", 4) == 0){
+		type = AMG_JSON_BOOL;
+		number = 1.0;
+		return p + 4;
+	}
+	if(end - p >= 5 && strncmp(p, "false", 5) == 0){
+		type = AMG_JSON_BOOL;
+		return p + 5;
+	}
+	if(end - p >= 4 && strncmp(p, "null", 4) == 0){
+		return p + 4;
+	}
+
+	// Numbers, copied so strtod never reads past the end
+	char buffer[64];
+	int n = 0;
+	while(p + n < end && n < 63 && strchr("+-0123456789.eE", p[n])) n++;
+	if(n == 0) return NULL;
+	memcpy(buffer, p, n);
+	buffer[n] = 0;
+	type = AMG_JSON_NUMBER;
+	number = strtod(buffer, NULL);
+	return p + n;
+}
+
+/**
+ * @brief Check whether an object has a member
+ * @param key Member name
+ * @return Whether it exists
+ */
+bool JsonValue::has(const char *key) const {
+	return !(*this)[key].isNull();
+}
+
+/**
+ * @brief Get an item of an array
+ * @param i Item index
+ * @return The item, or a null value
+ */
+const JsonValue &JsonValue::operator[](int i) const {
+	return (type == AMG_JSON_ARRAY && i >= 0 && i < (int)items.size()) ? items[i] : null;
+}
+
+/**
+ * @brief Get a member of an object
+ * @param key Member name
+ * @return The member, or a null value
+ */
+const JsonValue &JsonValue::operator[](const char *key) const {
+	if(type != AMG_JSON_OBJECT) return null;
+	for(unsigned int i=0;i<keys.size();i++){
+		if(keys[i] == key) return items[i];
+	}
+	return null;
+}
+
+}
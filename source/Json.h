@@ -0,0 +1,60 @@
+/**
+ * @file Json.h
+ * @brief Minimal JSON parser, used to read glTF files
+ */
+
+#ifndef JSON_H_
+#define JSON_H_
+
+// Includes C/C++
+#include <string>
+#include <vector>
+
+namespace AMG {
+
+/**
+ * @enum AMG_JsonType
+ * @brief Types of JSON values
+ */
+enum AMG_JsonType {
+	AMG_JSON_NULL = 0,
+	AMG_JSON_BOOL,
+	AMG_JSON_NUMBER,
+	AMG_JSON_STRING,
+	AMG_JSON_ARRAY,
+	AMG_JSON_OBJECT,
+};
+
+/**
+ * @class JsonValue
+ * @brief A parsed JSON value, with its children if it is an array or an object
+ * @note Missing members and out of range items return a null value, so lookups can be chained
+ */
+class JsonValue {
+private:
+	int type;							/**< Value type, see AMG_JsonType */
+	double number;						/**< Value of numbers and booleans */
+	std::string string;					/**< Value of strings */
+	std::vector<JsonValue> items;		/**< Items of arrays, values of objects */
+	std::vector<std::string> keys;		/**< Keys of objects */
+	static const JsonValue null;		/**< Returned when a value does not exist */
+	const char *parse(const char *p, const char *end, int depth);
+	static const char *parseString(const char *p, const char *end, std::string &out);
+public:
+	int getType() const { return type; }
+	bool isNull() const { return type == AMG_JSON_NULL; }
+	int size() const { return items.size(); }
+	double getNumber(double def=0.0) const { return (type == AMG_JSON_NUMBER || type == AMG_JSON_BOOL) ? number : def; }
+	int getInt(int def=0) const { return (type == AMG_JSON_NUMBER) ? (int)number : def; }
+	const std::string &getString() const { return string; }
+
+	JsonValue();
+	bool parse(const char *text, int size);
+	bool has(const char *key) const;
+	const JsonValue &operator[](int i) const;
+	const JsonValue &operator[](const char *key) const;
+};
+
+}
+
+#endif
@@ -22,11 +22,13 @@ namespace AMG {
  */
 LensFlare::LensFlare(const char *dir, float spacing, float *scale) {
 
-	// Load the textures
+	// Load the textures in an atlas, with their own texture if they don't fit
 	char path[256];
+	atlas = new TextureAtlas();
 	for(int i=0;i<AMG_LENS_FLARE_TEXTURES;i++){
 		sprintf(path, "%s/tex%d.dds", dir, i);
-		textures[i] = new Texture(path);
+		textures[i] = atlas->add(path);
+		if(textures[i] == NULL) textures[i] = new Texture(path);
 	}
 
 	// Load the sprite
@@ -40,7 +42,7 @@ LensFlare::LensFlare(const char *dir, float spacing, float *scale) {
 	this->spacing = spacing;
 	this->query = false;
 	this->coverage = 0.0f;
-	this->nsamples = textures[0]->getWidth() * textures[0]->getHeight() * lens_scale[0] * lens_scale[0];
+	this->nsamples = textures[0]->getFrameWidth() * textures[0]->getFrameHeight() * lens_scale[0] * lens_scale[0];
 }
 
 /**
@@ -131,6 +133,7 @@ LensFlare::~LensFlare() {
 	for(int i=0;i<AMG_LENS_FLARE_TEXTURES;i++){
 		delete textures[i];
 	}
+	AMG_DELETE(atlas);
 	glDeleteQueries(1, &queryID);
 	AMG_DELETE(sprite);
 }
@@ -10,6 +10,7 @@
 #include "Sprite.h"
 #include "Camera.h"
 #include "Light.h"
+#include "TextureAtlas.h"
 
 // Defines
 #define AMG_LENS_FLARE_TEXTURES 10		/**< Number of textures in this effect */
@@ -22,6 +23,7 @@ namespace AMG {
  */
 class LensFlare : public Entity {
 private:
+	TextureAtlas *atlas;							/**< Atlas holding the textures, so they share one bind */
 	Texture *textures[AMG_LENS_FLARE_TEXTURES];		/**< 10 lens flare textures */
 	Sprite *sprite;									/**< Sprite to draw each texture */
 	float spacing;									/**< Spacing between every 2 textures */
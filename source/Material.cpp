@@ -10,6 +10,8 @@
 // Own includes
 #include "Material.h"
 #include "Renderer.h"
+#include "AssetLoader.h"
+#include "TextureStreamer.h"
 
 namespace AMG {
 
@@ -25,6 +27,8 @@ Material::Material(){
 	this->reflectivity = 0.4f;
 	this->refractionIndex = 1.0f/1.33f;
 	this->textures = std::vector<Texture*>();
+	this->textureArray = NULL;
+	this->layer = 0;
 }
 
 /**
@@ -65,21 +69,44 @@ Material::Material(float *data) {
 	this->reflectivity = 0.4f;
 	this->refractionIndex = 1.0f/1.33f;
 	this->textures = std::vector<Texture*>();
+	this->textureArray = NULL;
+	this->layer = 0;
 }
 
 /**
  * @brief Add a texture to the texture list
+ * @param texture Path of the texture
+ * @param async Load it in the background, showing a placeholder meanwhile?
+ * @note If the TextureStreamer is enabled, the texture is streamed instead
  */
-void Material::addTexture(const char *texture){
+void Material::addTexture(const char *texture, bool async){
 	Texture *tex = NULL;
 	if(texture){
-		tex = new Texture(texture, textures.size() < Renderer::getsRGBTextures());
+		bool srgb = textures.size() < Renderer::getsRGBTextures();
+		if(TextureStreamer::isEnabled()){
+			tex = TextureStreamer::load(texture, srgb);
+		}else if(async){
+			tex = AssetLoader::loadTexture(texture, srgb)->get();
+		}else{
+			tex = new Texture(texture, srgb);
+		}
 		tex->setLod(-0.4f);			// -0.4 level of detail
 		tex->setAniso(4.0f);		// 4x anisotropic filtering
 		this->textures.push_back(tex);
 	}
 }
 
+/**
+ * @brief Use a layer of a texture array, which is not owned by this material
+ * @param textureArray Texture array, NULL to stop using it
+ * @param layer Layer to show
+ * @note Needs a shader which samples the layer with AMG_TextureArrayMap()
+ */
+void Material::setLayer(TextureArray *textureArray, int layer){
+	this->textureArray = textureArray;
+	this->layer = layer;
+}
+
 /**
  * @brief Update material information in a shader
  */
@@ -88,6 +115,7 @@ void Material::apply(){
 		textures[i]->animate();
 		textures[i]->bind(i);
 	}
+	if(textureArray) textureArray->bind(AMG_TEXTURE_ARRAY_SLOT);
 	if(diffuse.a < 1.0f){
 		glDisable(GL_CULL_FACE);
 	}else{
@@ -101,12 +129,27 @@ void Material::apply(){
 	shader->setUniform(AMG_SpecularPower, specularPower);
 	shader->setUniform(AMG_SpecularReflectivity, reflectivity);
 	shader->setUniform(AMG_RefractionIndex, refractionIndex);
+	if(textureArray){
+		float value = layer;
+		shader->setUniform(AMG_TexLayer, value);
+	}
+}
+
+/**
+ * @brief Tell the streamed textures how big the material is on screen
+ * @param pixels Size on screen, in pixels
+ */
+void Material::request(float pixels){
+	for(unsigned int i=0;i<textures.size();i++){
+		textures[i]->request(pixels);
+	}
 }
 
 void Material::disable(){
 	for(unsigned int i=0;i<textures.size();i++){
 		textures[i]->unbind(i);
 	}
+	if(textureArray) textureArray->unbind(AMG_TEXTURE_ARRAY_SLOT);
 }
 
 /**
@@ -16,6 +16,7 @@ using namespace glm;
 // Own includes
 #include "Entity.h"
 #include "Texture.h"
+#include "TextureArray.h"
 
 namespace AMG {
 
@@ -33,6 +34,8 @@ private:
 	float specularPower;			/**< Material specular power */
 	float reflectivity;				/**< Material reflectivity */
 	float refractionIndex;			/**< Refraction index */
+	TextureArray *textureArray;		/**< Texture array shared with other materials, NULL if not used */
+	int layer;						/**< Layer of the texture array */
 public:
 	vec4 &getDiffuse(){ return diffuse; }
 	vec4 &getSpecular(){ return specular; }
@@ -42,13 +45,17 @@ public:
 	float &getReflectivity(){ return reflectivity; }
 	float &getRefractionIndex(){ return refractionIndex; }
 	Texture *getTexture(int id){ return textures[id]; }
+	TextureArray *getTextureArray(){ return textureArray; }
+	int &getLayer(){ return layer; }
 
 	Material();
 	Material(Texture *texture);
 	Material(const char *path);
 	Material(const char **names);
 	Material(float *data);
-	void addTexture(const char *texture);
+	void addTexture(const char *texture, bool async=false);
+	void setLayer(TextureArray *textureArray, int layer);
+	void request(float pixels);
 	void apply();
 	void disable();
 	virtual ~Material();
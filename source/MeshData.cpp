@@ -5,6 +5,8 @@
 
 // Includes C/C++
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 
 // Own includes
 #include "MeshData.h"
@@ -13,14 +15,18 @@ namespace AMG {
 
 /**
  * @brief Constructor for a MeshData object
+ * @param deferred Keep the buffers in client memory until upload()? Then it can be built on any thread
  */
-MeshData::MeshData() {
-	glGenVertexArrays(1, &this->id);
+MeshData::MeshData(bool deferred) {
+	this->id = 0;
+	if(!deferred) glGenVertexArrays(1, &this->id);
 	info = std::vector<buffer_info>();
 	this->count = 0;
 	this->indexid = 0;
 	this->vertices = NULL;
 	this->nvertices = 0;
+	this->indices = NULL;
+	this->nindices = 0;
 }
 
 /**
@@ -34,13 +40,20 @@ MeshData::MeshData() {
  */
 void MeshData::addBuffer(void *data, int size, int comps, GLuint type, bool drawRaw){
 
-	// Add a buffer to the list
-	glBindVertexArray(this->id);
-	GLuint bufId;
-	glGenBuffers(1, &bufId);
-	glBindBuffer(GL_ARRAY_BUFFER, bufId);
-	glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
-	info.push_back((buffer_info){bufId, comps, type});
+	// Add a buffer to the list, or keep a copy until it's uploaded
+	GLuint bufId = 0;
+	if(this->id){
+		glBindVertexArray(this->id);
+		glGenBuffers(1, &bufId);
+		glBindBuffer(GL_ARRAY_BUFFER, bufId);
+		glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+	}else{
+		staged.push_back(staged_buffer());
+		staged.back().data.assign((const char*)data, (const char*)data + size);
+		staged.back().first = info.size();
+		staged.back().nattribs = 1;
+	}
+	info.push_back((buffer_info){bufId, comps, type, 0, 0});
 	if(drawRaw && type == GL_FLOAT){
 		this->count = size / (comps * sizeof(float));
 	}
@@ -52,17 +65,86 @@ void MeshData::addBuffer(void *data, int size, int comps, GLuint type, bool draw
 	}
 }
 
+/**
+ * @brief Add a buffer holding several vertex attributes, one vertex after another
+ * @param data Pointer to data, it is only uploaded or copied (it can be a mapped file)
+ * @param size Buffer size, in bytes
+ * @param stride Bytes between two vertices
+ * @param nverts Number of vertices
+ * @param attribs Description of each attribute, in attribute index order
+ * @param nattribs Number of attributes
+ * @note If it's the first buffer, the first attribute must be the position (3 floats), which is copied as vertex data
+ */
+void MeshData::addInterleavedBuffer(const void *data, int size, int stride, int nverts, const attrib_info *attribs, int nattribs){
+
+	// One buffer for every attribute
+	GLuint bufId = 0;
+	if(this->id){
+		glBindVertexArray(this->id);
+		glGenBuffers(1, &bufId);
+		glBindBuffer(GL_ARRAY_BUFFER, bufId);
+		glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+	}else{
+		staged.push_back(staged_buffer());
+		staged.back().data.assign((const char*)data, (const char*)data + size);
+		staged.back().first = info.size();
+		staged.back().nattribs = nattribs;
+	}
+	bool first = info.empty();
+	for(int i=0;i<nattribs;i++){
+		info.push_back((buffer_info){bufId, attribs[i].size, attribs[i].type, stride, attribs[i].offset});
+	}
+
+	// Keep a packed copy of the positions
+	if(first && nattribs > 0){
+		vertices = (float*) malloc (nverts * 3 * sizeof(float));
+		nvertices = nverts;
+		for(int i=0;i<nverts;i++){
+			memcpy(&vertices[i*3], (const char*)data + i * stride + attribs[0].offset, 3 * sizeof(float));
+		}
+	}
+}
+
 /**
  * @brief Sets information for the index buffer
  * @param data Pointer to the index buffer
  * @param size Index buffer size, in bytes
- * @note Call it only once
+ * @note Call it only once, the index data is kept (for further use e.g. occlusion culling)
  */
 void MeshData::setIndexBuffer(void *data, int size){
-	glGenBuffers(1, &this->indexid);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexid);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+	if(this->id){
+		glGenBuffers(1, &this->indexid);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexid);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+	}
 	this->count = size / sizeof(short);
+	this->indices = (unsigned short*) data;
+	this->nindices = this->count;
+}
+
+/**
+ * @brief Create the OpenGL objects of a deferred mesh, with the buffers added so far
+ * @note It must be called on the main thread, before drawing the mesh. It does nothing if it's uploaded
+ */
+void MeshData::upload(){
+	if(this->id) return;
+	glGenVertexArrays(1, &this->id);
+	glBindVertexArray(this->id);
+	for(unsigned int i=0;i<staged.size();i++){
+		GLuint bufId;
+		glGenBuffers(1, &bufId);
+		glBindBuffer(GL_ARRAY_BUFFER, bufId);
+		glBufferData(GL_ARRAY_BUFFER, staged[i].data.size(), staged[i].data.data(), GL_STATIC_DRAW);
+		for(int j=0;j<staged[i].nattribs;j++){
+			info[staged[i].first + j].id = bufId;
+		}
+	}
+	staged.clear();
+	if(this->indices){
+		glGenBuffers(1, &this->indexid);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexid);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->nindices * sizeof(unsigned short), this->indices, GL_STATIC_DRAW);
+	}
 }
 
 /**
@@ -96,9 +178,9 @@ void MeshData::enableBuffers(){
 		glEnableVertexAttribArray(i);
 		glBindBuffer(GL_ARRAY_BUFFER, binfo.id);
 		if(binfo.type == GL_FLOAT){
-			glVertexAttribPointer(i, binfo.size, GL_FLOAT, GL_FALSE, 0, (void*)0);
+			glVertexAttribPointer(i, binfo.size, GL_FLOAT, GL_FALSE, binfo.stride, (void*)(intptr_t)binfo.offset);
 		}else{
-			glVertexAttribIPointer(i, binfo.size, GL_UNSIGNED_SHORT, 0, (void*)0);
+			glVertexAttribIPointer(i, binfo.size, GL_UNSIGNED_SHORT, binfo.stride, (void*)(intptr_t)binfo.offset);
 		}
 	}
 }
@@ -117,12 +199,13 @@ void MeshData::disableBuffers(){
  * @brief Destructor of a MeshData object
  */
 MeshData::~MeshData() {
-	for(unsigned int i=0;i<info.size();i++){
-		glDeleteBuffers(1, &info.at(i).id);
+	for(unsigned int i=0;i<info.size() && this->id;i++){
+		if(i == 0 || info.at(i).id != info.at(i-1).id) glDeleteBuffers(1, &info.at(i).id);	// Interleaved attributes share their buffer
 	}
 	if(this->indexid) glDeleteBuffers(1, &this->indexid);
 	if(this->vertices) free(vertices);
-	glDeleteVertexArrays(1, &this->id);
+	if(this->indices) free(indices);
+	if(this->id) glDeleteVertexArrays(1, &this->id);
 }
 
 }
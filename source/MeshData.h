@@ -26,11 +26,35 @@ typedef struct{
 	GLuint id;			/**< Internal OpenGL ID of the buffer */
 	int size;			/**< Buffer size (OpenGL macro-defined) */
 	GLuint type;		/**< Type of buffer */
+	int stride;			/**< Bytes between two elements, 0 if they are tightly packed */
+	int offset;			/**< Offset of the first element, in bytes */
 }buffer_info;
 
+/**
+ * @struct attrib_info
+ * @brief Describes a vertex attribute inside an interleaved buffer
+ */
+typedef struct{
+	int size;			/**< Number of components */
+	GLuint type;		/**< Type of the components (GL_FLOAT or GL_UNSIGNED_SHORT) */
+	int offset;			/**< Offset inside each vertex, in bytes */
+}attrib_info;
+
+/**
+ * @struct staged_buffer
+ * @brief Vertex buffer kept in client memory until MeshData::upload()
+ */
+typedef struct{
+	std::vector<char> data;	/**< Buffer contents */
+	int first;				/**< First attribute reading the buffer, in the info vector */
+	int nattribs;			/**< Number of attributes reading the buffer */
+}staged_buffer;
+
 /**
  * @class MeshData
  * @brief Holds data for a Mesh
+ * @note A deferred mesh keeps its buffers in client memory, so it can be built on any thread,
+ * and creates the OpenGL objects in upload(), on the main thread
  */
 class MeshData : public Entity {
 protected:
@@ -40,13 +64,21 @@ protected:
 	int count;							/**< Number of indices / vertices in the mesh (raw mode) */
 	float *vertices;					/**< Buffer holding a mesh's vertices */
 	int nvertices;						/**< Number of vertices in the mesh */
+	unsigned short *indices;			/**< Buffer holding a mesh's indices */
+	int nindices;						/**< Number of indices in the mesh */
+	std::vector<staged_buffer> staged;	/**< Buffers waiting for upload(), only for deferred meshes */
 public:
 	float *getVertices(){ return vertices; }
 	int getNVertices(){ return nvertices; }
+	unsigned short *getIndices(){ return indices; }
+	int getNIndices(){ return nindices; }
+	bool isUploaded(){ return id != 0; }
 
-	MeshData();
+	MeshData(bool deferred=false);
 	void addBuffer(void *data, int size, int comps, GLuint type, bool drawRaw=false);
+	void addInterleavedBuffer(const void *data, int size, int stride, int nverts, const attrib_info *attribs, int nattribs);
 	void setIndexBuffer(void *data, int size);
+	void upload();
 	void draw();
 	void drawRaw();
 	void enableBuffers();
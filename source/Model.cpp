@@ -6,22 +6,362 @@
 // Includes C/C++
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Includes OpenGL
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 // Own includes
 #include "Model.h"
 #include "Debug.h"
 #include "Bone.h"
+#include "AssetLoader.h"
+#include "FileSystem.h"
+#include "Json.h"
+
+// Defines
+#define GLB_CHUNK_JSON 0x4E4F534A		/**< "JSON" chunk of a .glb file */
+#define GLB_CHUNK_BIN 0x004E4942		/**< "BIN" chunk of a .glb file */
 
 namespace AMG {
 
 /**
- * @brief Constructor for a 3D Model
- * @param path Path for the *.amd file
- * @param tangent Use tangent space data?
+ * @brief Read data from a file already in memory, the way fread does
+ * @param dst Where to copy the data
+ * @param size Size of each element, in bytes
+ * @param count Number of elements
+ * @param cursor Current position in the file, it is advanced
+ * @param end End of the file
+ * @note Data past the end of the file is filled with zeros
+ */
+static void readData(void *dst, size_t size, size_t count, const char **cursor, const char *end){
+	size_t n = size * count;
+	size_t left = end - *cursor;
+	if(n > left){
+		memset((char*)dst + left, 0, n - left);
+		n = left;
+	}
+	memcpy(dst, *cursor, n);
+	*cursor += n;
+}
+
+/**
+ * @struct AMG_GLTFAccessor
+ * @brief A glTF accessor, pointing inside the binary chunk of a .glb file
+ */
+typedef struct{
+	const char *data;		/**< First element */
+	int count;				/**< Number of elements */
+	int comps;				/**< Components of each element */
+	int componentType;		/**< OpenGL type of the components */
+	int stride;				/**< Bytes between two elements */
+	bool normalized;		/**< Are integer components normalized to [0, 1] or [-1, 1]? */
+	int view;				/**< Buffer view holding the data */
+}AMG_GLTFAccessor;
+
+/**
+ * @struct AMG_GLTFChannel
+ * @brief An animation channel, with its keys already read
+ */
+typedef struct{
+	std::vector<float> times;	/**< Time of each key, in seconds */
+	std::vector<float> values;	/**< Value of each key */
+	int comps;					/**< Components of each value, 3 for translations and 4 for rotations */
+	bool step;					/**< Use the previous key instead of interpolating? */
+}AMG_GLTFChannel;
+
+/**
+ * @brief Get an accessor of a .glb file
+ * @param json The glTF document
+ * @param bin Binary chunk of the file
+ * @param binSize Size of the binary chunk, in bytes
+ * @param index Accessor index, it can be -1
+ * @param acc The accessor (output)
+ * @return Whether the accessor exists and is inside the binary chunk
+ * @note Sparse accessors and external buffers are not supported
+ */
+static bool getAccessor(const JsonValue &json, const char *bin, int binSize, int index, AMG_GLTFAccessor *acc){
+	const JsonValue &a = json["accessors"][index];
+	if(bin == NULL || a.isNull() || !a.has("bufferView")) return false;
+	const JsonValue &v = json["bufferViews"][a["bufferView"].getInt()];
+	if(v.isNull() || v["buffer"].getInt() != 0) return false;
+
+	// Element size
+	static const char *types[] = {"SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4"};
+	static const int comps[] = {1, 2, 3, 4, 4, 9, 16};
+	acc->comps = 0;
+	for(int i=0;i<7;i++){
+		if(a["type"].getString() == types[i]) acc->comps = comps[i];
+	}
+	acc->componentType = a["componentType"].getInt();
+	int csize = 1;
+	if(acc->componentType == GL_FLOAT || acc->componentType == GL_UNSIGNED_INT) csize = 4;
+	if(acc->componentType == GL_SHORT || acc->componentType == GL_UNSIGNED_SHORT) csize = 2;
+
+	// Position inside the binary chunk
+	acc->count = a["count"].getInt();
+	acc->stride = v["byteStride"].getInt(csize * acc->comps);
+	acc->normalized = a["normalized"].getNumber() != 0.0;
+	acc->view = a["bufferView"].getInt();
+	long long offset = v["byteOffset"].getInt() + a["byteOffset"].getInt();
+	acc->data = bin + offset;
+	return acc->comps > 0 && acc->count > 0 && offset >= 0
+			&& offset + (long long)(acc->count - 1) * acc->stride + csize * acc->comps <= binSize;
+}
+
+/**
+ * @brief Read an element of an accessor as floats
+ * @param acc The accessor
+ * @param i Element index
+ * @param out Where to write the components
+ * @param n Number of components to write, the missing ones are zero
+ */
+static void readFloats(const AMG_GLTFAccessor &acc, int i, float *out, int n){
+	const char *p = acc.data + i * acc.stride;
+	for(int k=0;k<n;k++){
+		out[k] = 0.0f;
+		if(k >= acc.comps) continue;
+		switch(acc.componentType){
+			case GL_FLOAT:
+				memcpy(&out[k], p + k*4, sizeof(float));
+				break;
+			case GL_UNSIGNED_BYTE:
+				out[k] = ((unsigned char*)p)[k] / (acc.normalized ? 255.0f : 1.0f);
+				break;
+			case GL_BYTE:
+				out[k] = glm::max(((signed char*)p)[k] / (acc.normalized ? 127.0f : 1.0f), -1.0f);
+				break;
+			case GL_UNSIGNED_SHORT:{
+				unsigned short s;
+				memcpy(&s, p + k*2, sizeof(s));
+				out[k] = s / (acc.normalized ? 65535.0f : 1.0f);
+				break;
+			}
+			case GL_SHORT:{
+				short s;
+				memcpy(&s, p + k*2, sizeof(s));
+				out[k] = glm::max(s / (acc.normalized ? 32767.0f : 1.0f), -1.0f);
+				break;
+			}
+			case GL_UNSIGNED_INT:{
+				unsigned int u;
+				memcpy(&u, p + k*4, sizeof(u));
+				out[k] = (float)u;
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Read a component of an accessor as an unsigned integer
+ * @param acc The accessor
+ * @param i Element index
+ * @param k Component index
+ * @return The value, 0 if it is not an unsigned integer type
+ */
+static unsigned int readUInt(const AMG_GLTFAccessor &acc, int i, int k){
+	const char *p = acc.data + i * acc.stride;
+	if(acc.componentType == GL_UNSIGNED_BYTE) return ((unsigned char*)p)[k];
+	if(acc.componentType == GL_UNSIGNED_SHORT){
+		unsigned short s;
+		memcpy(&s, p + k*2, sizeof(s));
+		return s;
+	}
+	if(acc.componentType == GL_UNSIGNED_INT){
+		unsigned int u;
+		memcpy(&u, p + k*4, sizeof(u));
+		return u;
+	}
+	return 0;
+}
+
+/**
+ * @brief Split a matrix in translation, rotation and scale
+ * @param m The matrix
+ * @param pos Translation (output)
+ * @param rot Rotation (output)
+ * @param scale Scale (output), can be NULL
  */
-Model::Model(const char *path, bool tangent) {
+static void decomposeMatrix(const mat4 &m, vec3 *pos, quat *rot, vec3 *scale){
+	vec3 s = vec3(glm::length(vec3(m[0])), glm::length(vec3(m[1])), glm::length(vec3(m[2])));
+	s = glm::max(s, vec3(1e-8f));
+	*pos = vec3(m[3]);
+	*rot = glm::normalize(glm::quat_cast(mat3(vec3(m[0]) / s.x, vec3(m[1]) / s.y, vec3(m[2]) / s.z)));
+	if(scale) *scale = s;
+}
+
+/**
+ * @brief Get the local matrix of a glTF node
+ * @param node The node
+ * @return Its transformation, relative to its parent
+ */
+static mat4 getNodeMatrix(const JsonValue &node){
+	const JsonValue &m = node["matrix"];
+	if(m.size() == 16){
+		float data[16];
+		for(int i=0;i<16;i++) data[i] = m[i].getNumber();
+		return glm::make_mat4(data);
+	}
+	const JsonValue &t = node["translation"];
+	const JsonValue &r = node["rotation"];
+	const JsonValue &s = node["scale"];
+	vec3 pos = vec3(t[0].getNumber(), t[1].getNumber(), t[2].getNumber());
+	quat rot = quat(r[3].getNumber(1.0), r[0].getNumber(), r[1].getNumber(), r[2].getNumber());
+	vec3 scale = vec3(s[0].getNumber(1.0), s[1].getNumber(1.0), s[2].getNumber(1.0));
+	return glm::translate(mat4(1.0f), pos) * glm::toMat4(rot) * glm::scale(mat4(1.0f), scale);
+}
+
+/**
+ * @brief Get the world matrix of a glTF node
+ * @param nodes List of nodes
+ * @param parents Parent of each node, -1 for root nodes
+ * @param n Node index, it can be -1
+ * @return Its transformation, relative to the scene
+ */
+static mat4 getWorldMatrix(const JsonValue &nodes, const std::vector<int> &parents, int n){
+	mat4 m = mat4(1.0f);
+	for(int depth=0;n >= 0 && depth < (int)parents.size();depth++){
+		m = getNodeMatrix(nodes[n]) * m;
+		n = parents[n];
+	}
+	return m;
+}
+
+/**
+ * @brief Get the name of a material texture, as a DDS file
+ * @param json The glTF document
+ * @param info Texture info of the material (e.g. baseColorTexture)
+ * @return The texture name, empty if it is embedded in the file
+ */
+static std::string getTextureName(const JsonValue &json, const JsonValue &info){
+	if(info.isNull()) return std::string();
+	const JsonValue &texture = json["textures"][info["index"].getInt(-1)];
+	std::string uri = json["images"][texture["source"].getInt(-1)]["uri"].getString();
+	size_t slash = uri.find_last_of("/\\");
+	if(slash != std::string::npos) uri = uri.substr(slash + 1);
+	size_t dot = uri.find_last_of('.');
+	if(dot != std::string::npos) uri = uri.substr(0, dot);
+	return uri.empty() ? uri : uri + ".dds";
+}
 
-	// Initialize variables
+/**
+ * @brief Read the keys of an animation channel
+ * @param json The glTF document
+ * @param bin Binary chunk of the file
+ * @param binSize Size of the binary chunk, in bytes
+ * @param sampler Animation sampler of the channel
+ * @param comps Components of each value
+ * @param channel The channel (output)
+ * @return Whether the keys could be read
+ */
+static bool readChannel(const JsonValue &json, const char *bin, int binSize, const JsonValue &sampler, int comps, AMG_GLTFChannel *channel){
+	AMG_GLTFAccessor input, output;
+	if(!getAccessor(json, bin, binSize, sampler["input"].getInt(-1), &input)) return false;
+	if(!getAccessor(json, bin, binSize, sampler["output"].getInt(-1), &output)) return false;
+	bool cubic = sampler["interpolation"].getString() == "CUBICSPLINE";
+	int nkeys = glm::min(input.count, cubic ? output.count / 3 : output.count);
+	channel->comps = comps;
+	channel->step = sampler["interpolation"].getString() == "STEP";
+	channel->times.resize(nkeys);
+	channel->values.resize(nkeys * comps);
+	for(int i=0;i<nkeys;i++){
+		readFloats(input, i, &channel->times[i], 1);
+		readFloats(output, cubic ? i*3 + 1 : i, &channel->values[i * comps], comps);	// Cubic splines: skip the tangents
+	}
+	return nkeys > 0;
+}
+
+/**
+ * @brief Sample an animation channel
+ * @param channel The channel
+ * @param time Time, in seconds
+ * @param out The value, interpolated between the nearest keys
+ */
+static void sampleChannel(const AMG_GLTFChannel &channel, float time, float *out){
+	int nkeys = channel.times.size();
+	int k = 0;
+	while(k + 1 < nkeys && channel.times[k + 1] <= time) k++;
+	const float *a = &channel.values[k * channel.comps];
+	if(k + 1 >= nkeys || time <= channel.times[k] || channel.step){
+		memcpy(out, a, channel.comps * sizeof(float));
+		return;
+	}
+	const float *b = &channel.values[(k + 1) * channel.comps];
+	float f = (time - channel.times[k]) / (channel.times[k + 1] - channel.times[k]);
+	if(channel.comps == 4){
+		quat q = glm::slerp(quat(a[3], a[0], a[1], a[2]), quat(b[3], b[0], b[1], b[2]), f);
+		out[0] = q.x; out[1] = q.y; out[2] = q.z; out[3] = q.w;
+	}else{
+		for(int i=0;i<channel.comps;i++) out[i] = a[i] + (b[i] - a[i]) * f;
+	}
+}
+
+/**
+ * @brief Calculate smooth normals, for meshes which don't have them
+ * @param positions Vertex positions
+ * @param indices Triangle indices
+ * @param nindices Number of indices
+ * @param normals The normals (output)
+ */
+static void computeNormals(const std::vector<vec3> &positions, const unsigned short *indices, int nindices, std::vector<vec3> &normals){
+	normals.assign(positions.size(), vec3(0.0f));
+	for(int i=0;i+2<nindices;i+=3){
+		vec3 n = glm::cross(positions[indices[i+1]] - positions[indices[i]], positions[indices[i+2]] - positions[indices[i]]);
+		for(int k=0;k<3;k++) normals[indices[i+k]] += n;
+	}
+	for(unsigned int i=0;i<normals.size();i++){
+		float len = glm::length(normals[i]);
+		normals[i] = (len > 0.0f) ? normals[i] / len : vec3(0.0f, 1.0f, 0.0f);
+	}
+}
+
+/**
+ * @brief Calculate the tangent space from the texture coordinates
+ * @param positions Vertex positions
+ * @param uvs Vertex texture coordinates
+ * @param normals Vertex normals
+ * @param indices Triangle indices
+ * @param nindices Number of indices
+ * @param tangents The tangents (output)
+ * @param bitangents The bitangents (output)
+ */
+static void computeTangents(const std::vector<vec3> &positions, const std::vector<vec2> &uvs, const std::vector<vec3> &normals,
+		const unsigned short *indices, int nindices, std::vector<vec3> &tangents, std::vector<vec3> &bitangents){
+	tangents.assign(positions.size(), vec3(0.0f));
+	bitangents.assign(positions.size(), vec3(0.0f));
+	for(int i=0;i+2<nindices;i+=3){
+		int i0 = indices[i], i1 = indices[i+1], i2 = indices[i+2];
+		vec3 e1 = positions[i1] - positions[i0], e2 = positions[i2] - positions[i0];
+		vec2 d1 = uvs[i1] - uvs[i0], d2 = uvs[i2] - uvs[i0];
+		float det = d1.x * d2.y - d2.x * d1.y;
+		if(glm::abs(det) < 1e-12f) continue;
+		vec3 t = (e1 * d2.y - e2 * d1.y) / det;
+		vec3 b = (e2 * d1.x - e1 * d2.x) / det;
+		for(int k=0;k<3;k++){
+			tangents[indices[i+k]] += t;
+			bitangents[indices[i+k]] += b;
+		}
+	}
+	for(unsigned int i=0;i<positions.size();i++){
+		vec3 n = normals[i];
+		vec3 t = tangents[i] - n * glm::dot(n, tangents[i]);
+		if(glm::length(t) < 1e-6f) t = glm::cross(n, (glm::abs(n.y) < 0.99f) ? vec3(0, 1, 0) : vec3(1, 0, 0));
+		t = glm::normalize(t);
+		float sign = (glm::dot(glm::cross(n, t), bitangents[i]) < 0.0f) ? -1.0f : 1.0f;
+		tangents[i] = t;
+		bitangents[i] = glm::cross(n, t) * sign;
+	}
+}
+
+/**
+ * @brief Constructor for an empty 3D Model, which draws nothing until it is loaded
+ */
+Model::Model() {
 	this->nobjects = 0;
 	this->nmaterials = 0;
 	this->nanimations = 0;
@@ -29,19 +369,53 @@ Model::Model(const char *path, bool tangent) {
 	this->materials = NULL;
 	this->animations = NULL;
 	this->fps = 0;
+	this->uploaded = false;
+}
 
-	// Open file
-	FILE *f = fopen(getFullPath(path, AMG_MODEL), "rb");
-	if(f == NULL) Debug::showError(FILE_NOT_FOUND, (void*)path);
+/**
+ * @brief Constructor for a 3D Model
+ * @param path Path for the *.amd or *.glb file
+ * @param tangent Use tangent space data?
+ * @note Files stored uncompressed in the pack are read straight from the mapped pack
+ */
+Model::Model(const char *path, bool tangent) : Model() {
+	int size = 0;
+	char *copy = NULL;
+	const char *data = FileSystem::map(path, AMG_MODEL, &size);
+	if(data == NULL) data = copy = FileSystem::readFile(path, AMG_MODEL, &size);
+	if(data == NULL) Debug::showError(FILE_NOT_FOUND, (void*)path);
+	parse(path, data, size, tangent, false);
+	upload(false);
+	if(copy) free(copy);
+}
+
+/**
+ * @brief Parse a 3D Model from a file already in memory
+ * @param path Path for the *.amd or *.glb file
+ * @param file Contents of the file
+ * @param size Size of the file, in bytes
+ * @param tangent Use tangent space data?
+ * @param deferred Keep the object buffers in client memory until upload()?
+ * @note Deferred models can be parsed on any thread. The material textures are loaded by upload()
+ */
+void Model::parse(const char *path, const char *file, int size, bool tangent, bool deferred){
+	const char *f = file;
+	const char *end = file + size;
+
+	// Binary glTF files have their own loader
+	if(size >= 4 && memcmp(file, "glTF", 4) == 0){
+		parseGLB(path, file, size, tangent, deferred);
+		return;
+	}
 
 	// Check signature
 	char sign[3];
-	fread(sign, sizeof(char), 3, f);
+	readData(sign, sizeof(char), 3, &f, end);
 	if(sign[0] != 'A' || sign[1] != 'M' || sign[2] != 'D') Debug::showError(WRONG_SIGNATURE, (void*)path);
 
 	// Set up material information
 	nmaterials = 0;
-	fread(&nmaterials, sizeof(unsigned char), 1, f);
+	readData(&nmaterials, sizeof(unsigned char), 1, &f, end);
 	materials = (Material**) calloc (nmaterials, sizeof(Material*));
 
 	// Read all materials
@@ -50,27 +424,27 @@ Model::Model(const char *path, bool tangent) {
 
 		// Create the material
 		float buff[11];
-		fread(buff, sizeof(float), 11, f);
+		readData(buff, sizeof(float), 11, &f, end);
 		materials[i] = new Material(buff);
 
 		// Read the number of textures
 		unsigned char ntex;
-		fread(&ntex, sizeof(unsigned char), 1, f);
+		readData(&ntex, sizeof(unsigned char), 1, &f, end);
 
 		// Load each texture
 		for(unsigned int j=0;j<ntex;j++){
-			int len;
-			fread(&len, sizeof(unsigned char), 1, f);
+			int len = 0;
+			readData(&len, sizeof(unsigned char), 1, &f, end);
 			if(len > 0){
-				fread(texpath, len, sizeof(char), f);
+				readData(texpath, len, sizeof(char), &f, end);
 				texpath[len] = 0;
-				materials[i]->addTexture(texpath);
+				textures.push_back(std::make_pair(i, std::string(texpath)));
 			}
 		}
 	}
 
 	// Set up object information
-	fread(&nobjects, sizeof(unsigned char), 1, f);
+	readData(&nobjects, sizeof(unsigned char), 1, &f, end);
 	objects = (Object**) calloc (nobjects, sizeof(Object*));
 
 	// Temporal variables
@@ -82,7 +456,7 @@ Model::Model(const char *path, bool tangent) {
 
 	// Read each object
 	for(unsigned int i=0;i<nobjects;i++){
-		fread(&nvertices, sizeof(unsigned short), 1, f);
+		readData(&nvertices, sizeof(unsigned short), 1, &f, end);
 		unsigned int vertices_size = nvertices*3*sizeof(float);
 		unsigned int texcoords_size = nvertices*2*sizeof(float);
 		float *vertices = (float*) malloc (vertices_size);
@@ -90,27 +464,30 @@ Model::Model(const char *path, bool tangent) {
 		float *normals = (float*) malloc (vertices_size);
 		float *tangents = (float*) malloc (vertices_size);
 		float *bitangents = (float*) malloc (vertices_size);
-		fread(vertices, sizeof(float), nvertices*3, f);
-		fread(texcoords, sizeof(float), nvertices*2, f);
-		fread(normals, sizeof(float), nvertices*3, f);
-		fread(tangents, sizeof(float), nvertices*3, f);
-		fread(bitangents, sizeof(float), nvertices*3, f);
-		fread(&nindices, sizeof(unsigned short), 1, f);
+		readData(vertices, sizeof(float), nvertices*3, &f, end);
+		readData(texcoords, sizeof(float), nvertices*2, &f, end);
+		readData(normals, sizeof(float), nvertices*3, &f, end);
+		readData(tangents, sizeof(float), nvertices*3, &f, end);
+		readData(bitangents, sizeof(float), nvertices*3, &f, end);
+		readData(&nindices, sizeof(unsigned short), 1, &f, end);
 		unsigned short *indices = (unsigned short*) malloc (nindices*sizeof(unsigned short));
-		fread(indices, sizeof(unsigned short), nindices, f);
-		fread(&ngroups, sizeof(unsigned char), 1, f);
+		readData(indices, sizeof(unsigned short), nindices, &f, end);
+		readData(&ngroups, sizeof(unsigned char), 1, &f, end);
 		unsigned short *groups = (unsigned short*) malloc (ngroups*3*sizeof(unsigned short));
-		fread(groups, sizeof(unsigned short), 3*ngroups, f);
+		readData(groups, sizeof(unsigned short), 3*ngroups, &f, end);
 
 		// Read bounding box, pos-rot-scale information
-		fread(posdata, sizeof(float), 13, f);
+		readData(posdata, sizeof(float), 13, &f, end);
 
 		// Create a new object
-		objects[i] = new Object();
+		char source[256];
+		sprintf(source, "%s.%d", path, i);
+		objects[i] = new Object(deferred);
+		objects[i]->getSource() = source;
 		objects[i]->getBBox() = vec3(posdata[0], posdata[2], posdata[1]);
-		objects[i]->getPosition() = vec3(posdata[3], posdata[5], -posdata[4]);
-		objects[i]->getRotation() = quat(posdata[9], posdata[6], posdata[7], posdata[8]);
-		objects[i]->getScale() = vec3(posdata[10], posdata[12], posdata[11]);
+		objects[i]->setPosition(vec3(posdata[3], posdata[5], -posdata[4]));
+		objects[i]->setRotation(quat(posdata[9], posdata[6], posdata[7], posdata[8]));
+		objects[i]->setScale(vec3(posdata[10], posdata[12], posdata[11]));
 		objects[i]->addBuffer(vertices, vertices_size, 3, GL_FLOAT);
 		objects[i]->addBuffer(texcoords, texcoords_size, 2, GL_FLOAT);
 		objects[i]->addBuffer(normals, vertices_size, 3, GL_FLOAT);
@@ -122,20 +499,20 @@ Model::Model(const char *path, bool tangent) {
 		objects[i]->setMaterialGroups(groups, ngroups, materials, nmaterials);
 
 		// Read bone information
-		fread(&nbones, sizeof(unsigned char), 1, f);
+		readData(&nbones, sizeof(unsigned char), 1, &f, end);
 		bone_t *bones = (bone_t*) calloc (nbones, sizeof(bone_t));
 
 		// Read each bone
 		for(unsigned char j=0;j<nbones;j++){
 			bone_t *bone = &bones[j];
-			fread(&bone->parent, sizeof(unsigned short), 1, f);
-			fread(&bone->nchildren, sizeof(unsigned short), 1, f);
+			readData(&bone->parent, sizeof(unsigned short), 1, &f, end);
+			readData(&bone->nchildren, sizeof(unsigned short), 1, &f, end);
 			if(bone->nchildren > 0){
 				bone->children = (unsigned short*) malloc (bone->nchildren * sizeof(unsigned short));
-				fread(bone->children, sizeof(unsigned short), bone->nchildren, f);
+				readData(bone->children, sizeof(unsigned short), bone->nchildren, &f, end);
 			}
-			fread(bone->localbindmatrix, sizeof(float), 16, f);
-			fread(bone->matrix_inv, sizeof(float), 16, f);
+			readData(bone->localbindmatrix, sizeof(float), 16, &f, end);
+			readData(bone->matrix_inv, sizeof(float), 16, &f, end);
 		}
 
 		// Create our bone structure
@@ -144,9 +521,9 @@ Model::Model(const char *path, bool tangent) {
 		// Load up the weights buffer
 		if(nbones > 0){
 			float *weights = (float*) malloc (nvertices*4*sizeof(float));
-			fread(weights, sizeof(float), 4*nvertices, f);
+			readData(weights, sizeof(float), 4*nvertices, &f, end);
 			unsigned short *weights_bones = (unsigned short*) malloc (nvertices*4*sizeof(unsigned short));
-			fread(weights_bones, sizeof(unsigned short), 4*nvertices, f);
+			readData(weights_bones, sizeof(unsigned short), 4*nvertices, &f, end);
 			objects[i]->addBuffer(weights, nvertices*4*sizeof(float), 4, GL_FLOAT);
 			objects[i]->addBuffer(weights_bones, nvertices*4*sizeof(unsigned short), 4, GL_UNSIGNED_SHORT);
 			free(weights);
@@ -156,16 +533,15 @@ Model::Model(const char *path, bool tangent) {
 		// Free temporary data
 		free(texcoords);
 		free(normals);
-		free(indices);
 		free(tangents);
 		free(bitangents);
-		// Vertices and groups are deleted in its Object
+		// Vertices, indices and groups are deleted in its Object
 	}
 
 	// Read animation data
-	fread(&this->nanimations, sizeof(unsigned char), 1, f);
+	readData(&this->nanimations, sizeof(unsigned char), 1, &f, end);
 	if(this->nanimations > 0){
-		fread(&this->fps, sizeof(unsigned char), 1, f);
+		readData(&this->fps, sizeof(unsigned char), 1, &f, end);
 
 		// Prepare temporary buffers
 		float *data = (float*) malloc (7*nbones*sizeof(float));
@@ -174,11 +550,11 @@ Model::Model(const char *path, bool tangent) {
 		this->animations = (Animation**) calloc (this->nanimations, sizeof(Animation*));
 		for(unsigned int j=0;j<this->nanimations;j++){
 			unsigned int nkeyframes = 0;
-			fread(&nkeyframes, sizeof(unsigned short), 1, f);
+			readData(&nkeyframes, sizeof(unsigned short), 1, &f, end);
 			Keyframe **keyframes = (Keyframe**) calloc (nkeyframes, sizeof(Keyframe*));
 			for(unsigned int i=0;i<nkeyframes;i++){
-				fread(&instant, sizeof(float), 1, f);
-				fread(data, sizeof(float), 7*nbones, f);
+				readData(&instant, sizeof(float), 1, &f, end);
+				readData(data, sizeof(float), 7*nbones, &f, end);
 				keyframes[i] = new Keyframe(instant, data, nbones);
 			}
 			this->animations[j] = new Animation(keyframes, nkeyframes);
@@ -187,15 +563,338 @@ Model::Model(const char *path, bool tangent) {
 		free(data);
 	}
 
-	// Close file
-	fclose(f);
+}
+
+/**
+ * @brief Create the OpenGL objects of a parsed model, and load its material textures
+ * @param async Load the material textures in the background?
+ * @note It must be called on the main thread
+ */
+void Model::upload(bool async){
+	for(unsigned int i=0;i<nobjects;i++){
+		objects[i]->upload();
+	}
+	for(unsigned int i=0;i<textures.size();i++){
+		materials[textures[i].first]->addTexture(textures[i].second.c_str(), async);
+	}
+	textures.clear();
+	uploaded = true;
+}
+
+/**
+ * @brief Parse a 3D Model from a binary glTF 2.0 file already in memory
+ * @param path Path for the *.glb file
+ * @param file Contents of the file, it can be a mapped file
+ * @param size Size of the file, in bytes
+ * @param tangent Use tangent space data?
+ * @param deferred Keep the object buffers in client memory until upload()?
+ * @note Each mesh primitive becomes an Object, the first skin is used by the animations and
+ * textures are loaded as DDS files with the same name. Vertex data which is already interleaved
+ * is uploaded straight from the file, unless the model is deferred
+ */
+void Model::parseGLB(const char *path, const char *file, int size, bool tangent, bool deferred){
+
+	// Read the header and the chunks
+	unsigned int header[5];
+	if(size < 20) Debug::showError(WRONG_SIGNATURE, (void*)path);
+	memcpy(header, file, sizeof(header));
+	if(header[1] != 2 || header[4] != GLB_CHUNK_JSON || header[3] > (unsigned int)size - 20) Debug::showError(UNSUPPORTED_FORMAT, (void*)path);
+	JsonValue json;
+	if(!json.parse(file + 20, header[3])) Debug::showError(UNSUPPORTED_FORMAT, (void*)path);
+	const char *bin = NULL;
+	int binSize = 0;
+	int binStart = 20 + ((header[3] + 3) & ~3);
+	if(binStart + 8 <= size){
+		unsigned int chunk[2];
+		memcpy(chunk, file + binStart, sizeof(chunk));
+		if(chunk[1] == GLB_CHUNK_BIN && chunk[0] <= (unsigned int)(size - binStart - 8)){
+			bin = file + binStart + 8;
+			binSize = chunk[0];
+		}
+	}
+
+	// Read the materials
+	const JsonValue &mats = json["materials"];
+	nmaterials = mats.size();
+	materials = (Material**) calloc (nmaterials, sizeof(Material*));
+	for(unsigned int i=0;i<nmaterials;i++){
+		float data[11] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.5f, 1.0f, 1.0f};
+		const JsonValue &pbr = mats[i]["pbrMetallicRoughness"];
+		const JsonValue &color = pbr["baseColorFactor"];
+		for(int k=0;k<color.size() && k<4;k++) data[(k < 3) ? k : 4] = color[k].getNumber();
+		materials[i] = new Material(data);
+		std::string diffuse = getTextureName(json, pbr["baseColorTexture"]);
+		std::string normal = getTextureName(json, mats[i]["normalTexture"]);
+		if(!diffuse.empty()) textures.push_back(std::make_pair(i, diffuse));
+		if(!normal.empty()) textures.push_back(std::make_pair(i, normal));
+	}
+
+	// Get the parent of each node, and which nodes are bones
+	const JsonValue &nodes = json["nodes"];
+	int nnodes = nodes.size();
+	std::vector<int> parents(nnodes, -1);
+	for(int i=0;i<nnodes;i++){
+		const JsonValue &children = nodes[i]["children"];
+		for(int j=0;j<children.size();j++){
+			int c = children[j].getInt(-1);
+			if(c >= 0 && c < nnodes) parents[c] = i;
+		}
+	}
+	int animSkin = -1;
+	std::vector<int> jointOf(nnodes, -1);
+
+	// Count the objects, one for each triangle primitive
+	const JsonValue &meshes = json["meshes"];
+	nobjects = 0;
+	for(int i=0;i<nnodes;i++){
+		const JsonValue &prims = meshes[nodes[i]["mesh"].getInt(-1)]["primitives"];
+		for(int j=0;j<prims.size();j++){
+			if(prims[j]["mode"].getInt(4) == 4) nobjects++;
+		}
+	}
+	objects = (Object**) calloc (nobjects, sizeof(Object*));
+
+	// Create each object
+	int n = 0;
+	for(int i=0;i<nnodes;i++){
+		const JsonValue &node = nodes[i];
+		const JsonValue &prims = meshes[node["mesh"].getInt(-1)]["primitives"];
+		for(int j=0;j<prims.size();j++){
+			const JsonValue &prim = prims[j];
+			const JsonValue &attr = prim["attributes"];
+			if(prim["mode"].getInt(4) != 4) continue;
+
+			// Get the vertex attributes
+			AMG_GLTFAccessor pos, uv, nrm, tan, joints, weights, idx;
+			if(!getAccessor(json, bin, binSize, attr["POSITION"].getInt(-1), &pos) || pos.count > 65536) Debug::showError(UNSUPPORTED_FORMAT, (void*)path);
+			bool hasUV = getAccessor(json, bin, binSize, attr["TEXCOORD_0"].getInt(-1), &uv) && uv.count == pos.count;
+			bool hasNormal = getAccessor(json, bin, binSize, attr["NORMAL"].getInt(-1), &nrm) && nrm.count == pos.count;
+			bool hasTangent = getAccessor(json, bin, binSize, attr["TANGENT"].getInt(-1), &tan) && tan.count == pos.count;
+			int skin = node["skin"].getInt(-1);
+			bool skinned = skin >= 0 && getAccessor(json, bin, binSize, attr["JOINTS_0"].getInt(-1), &joints) && joints.count == pos.count
+					&& getAccessor(json, bin, binSize, attr["WEIGHTS_0"].getInt(-1), &weights) && weights.count == pos.count;
+			int nverts = pos.count;
+
+			// Get the indices, as 16 bit
+			int nindices = nverts;
+			bool hasIndices = getAccessor(json, bin, binSize, prim["indices"].getInt(-1), &idx);
+			if(hasIndices) nindices = idx.count;
+			unsigned short *indices = (unsigned short*) malloc (nindices * sizeof(unsigned short));
+			for(int k=0;k<nindices;k++){
+				unsigned int index = hasIndices ? readUInt(idx, k, 0) : k;
+				indices[k] = (index < (unsigned int)nverts) ? index : 0;
+			}
+
+			// Create the object
+			char source[256];
+			sprintf(source, "%s.%d", path, n);
+			Object *obj = new Object(deferred);
+			objects[n++] = obj;
+			obj->getSource() = source;
+			if(!skinned){		// Skinned meshes are placed by their bones
+				decomposeMatrix(getWorldMatrix(nodes, parents, i), &obj->getPosition(), &obj->getRotation(), &obj->getScale());
+			}
+			vec3 bbox = vec3(0.0f);
+			for(int k=0;k<nverts;k++){
+				float p[3];
+				readFloats(pos, k, p, 3);
+				bbox = glm::max(bbox, glm::abs(glm::make_vec3(p)));
+			}
+			obj->getBBox() = bbox;
+
+			// Upload the vertices straight from the file, if they are already interleaved like the engine wants them
+			bool direct = !tangent && hasUV && hasNormal && pos.view == uv.view && pos.view == nrm.view && pos.stride == uv.stride && pos.stride == nrm.stride
+					&& pos.componentType == GL_FLOAT && uv.componentType == GL_FLOAT && nrm.componentType == GL_FLOAT && uv.comps == 2
+					&& json["bufferViews"][pos.view].has("byteStride");
+			if(skinned){
+				direct = direct && joints.view == pos.view && weights.view == pos.view && joints.stride == pos.stride && weights.stride == pos.stride
+						&& joints.componentType == GL_UNSIGNED_SHORT && weights.componentType == GL_FLOAT;
+			}
+			if(direct){
+				const JsonValue &view = json["bufferViews"][pos.view];
+				const char *start = bin + view["byteOffset"].getInt();
+				attrib_info attribs[5] = {
+					{3, GL_FLOAT, (int)(pos.data - start)}, {2, GL_FLOAT, (int)(uv.data - start)}, {3, GL_FLOAT, (int)(nrm.data - start)},
+					{4, GL_FLOAT, skinned ? (int)(weights.data - start) : 0}, {4, GL_UNSIGNED_SHORT, skinned ? (int)(joints.data - start) : 0},
+				};
+				int viewSize = glm::min(view["byteLength"].getInt(), (int)(bin + binSize - start));
+				obj->addInterleavedBuffer(start, viewSize, pos.stride, nverts, attribs, skinned ? 5 : 3);
+			}else{
+
+				// Read the attributes, calculating the missing ones
+				std::vector<vec3> positions(nverts), normals(nverts), tangents, bitangents;
+				std::vector<vec2> uvs(nverts, vec2(0.0f));
+				for(int k=0;k<nverts;k++){
+					readFloats(pos, k, &positions[k].x, 3);
+					if(hasUV) readFloats(uv, k, &uvs[k].x, 2);
+					if(hasNormal) readFloats(nrm, k, &normals[k].x, 3);
+				}
+				if(!hasNormal) computeNormals(positions, indices, nindices, normals);
+				if(tangent && hasTangent){
+					tangents.resize(nverts);
+					bitangents.resize(nverts);
+					for(int k=0;k<nverts;k++){
+						float t[4];
+						readFloats(tan, k, t, 4);
+						tangents[k] = glm::make_vec3(t);
+						bitangents[k] = glm::cross(normals[k], tangents[k]) * t[3];
+					}
+				}else if(tangent){
+					computeTangents(positions, uvs, normals, indices, nindices, tangents, bitangents);
+				}
+
+				// Interleave them, in the same order as the AMD loader
+				attrib_info attribs[7];
+				int nattribs = 0, offset = 0;
+				int sizes[7] = {3, 2, 3, 3, 3, 4, 4};
+				for(int k=0;k<7;k++){
+					if(k >= 3 && k <= 4 && !tangent) continue;
+					if(k >= 5 && !skinned) continue;
+					attribs[nattribs++] = (attrib_info){sizes[k], (k == 6) ? (GLuint)GL_UNSIGNED_SHORT : (GLuint)GL_FLOAT, offset};
+					offset += sizes[k] * ((k == 6) ? sizeof(unsigned short) : sizeof(float));
+				}
+				int stride = offset;
+				char *buffer = (char*) malloc (nverts * stride);
+				for(int k=0;k<nverts;k++){
+					char *v = buffer + k * stride;
+					memcpy(v + attribs[0].offset, &positions[k].x, 3 * sizeof(float));
+					memcpy(v + attribs[1].offset, &uvs[k].x, 2 * sizeof(float));
+					memcpy(v + attribs[2].offset, &normals[k].x, 3 * sizeof(float));
+					if(tangent){
+						memcpy(v + attribs[3].offset, &tangents[k].x, 3 * sizeof(float));
+						memcpy(v + attribs[4].offset, &bitangents[k].x, 3 * sizeof(float));
+					}
+					if(skinned){
+						float w[4];
+						unsigned short b[4];
+						readFloats(weights, k, w, 4);
+						for(int c=0;c<4;c++) b[c] = readUInt(joints, k, c);
+						memcpy(v + attribs[nattribs - 2].offset, w, sizeof(w));
+						memcpy(v + attribs[nattribs - 1].offset, b, sizeof(b));
+					}
+				}
+				obj->addInterleavedBuffer(buffer, nverts * stride, stride, nverts, attribs, nattribs);
+				free(buffer);
+			}
+
+			// Indices and a single material group
+			int material = prim["material"].getInt(-1);
+			unsigned short *groups = (unsigned short*) malloc (3 * sizeof(unsigned short));
+			groups[0] = 0;
+			groups[1] = nindices / 3;
+			groups[2] = (material >= 0) ? material : 0xFFFF;
+			obj->setIndexBuffer(indices, nindices * sizeof(unsigned short));
+			obj->setMaterialGroups(groups, 1, materials, nmaterials);
+
+			// Bones, from the skin joints
+			if(!skinned) continue;
+			const JsonValue &skinJoints = json["skins"][skin]["joints"];
+			int nbones = skinJoints.size();
+			if(animSkin < 0){
+				animSkin = skin;
+				for(int k=0;k<nbones;k++){
+					int node = skinJoints[k].getInt(-1);
+					if(node >= 0 && node < nnodes) jointOf[node] = k;
+				}
+			}
+			AMG_GLTFAccessor ibm;
+			bool hasIBM = getAccessor(json, bin, binSize, json["skins"][skin]["inverseBindMatrices"].getInt(-1), &ibm) && ibm.comps == 16 && ibm.count >= nbones;
+			bone_t *bones = (bone_t*) calloc (nbones, sizeof(bone_t));
+			for(int k=0;k<nbones;k++){
+				int node = skinJoints[k].getInt(-1);
+				bone_t *bone = &bones[k];
+				bone->parent = 0xFFFF;
+				std::vector<unsigned short> children;
+				for(int c=0;c<nbones;c++){
+					int other = skinJoints[c].getInt(-1);
+					if(other >= 0 && other < nnodes && parents[other] == node) children.push_back(c);
+					if(node >= 0 && node < nnodes && parents[node] == other) bone->parent = c;
+				}
+				bone->nchildren = children.size();
+				if(bone->nchildren > 0){
+					bone->children = (unsigned short*) malloc (bone->nchildren * sizeof(unsigned short));
+					memcpy(bone->children, children.data(), bone->nchildren * sizeof(unsigned short));
+				}
+
+				// The root bone also takes the transformation of the nodes above it
+				mat4 local = (bone->parent == 0xFFFF) ? getWorldMatrix(nodes, parents, node) : getNodeMatrix(nodes[node]);
+				memcpy(bone->localbindmatrix, glm::value_ptr(local), 16 * sizeof(float));
+				mat4 inv = mat4(1.0f);
+				if(hasIBM) readFloats(ibm, k, glm::value_ptr(inv), 16);
+				memcpy(bone->matrix_inv, glm::value_ptr(inv), 16 * sizeof(float));
+			}
+			obj->createBoneHierarchy(bones, nbones);
+		}
+	}
+
+	// Read the animations of the first skin, sampling every bone at every key time
+	const JsonValue &anims = json["animations"];
+	if(animSkin < 0 || anims.size() == 0) return;
+	const JsonValue &skinJoints = json["skins"][animSkin]["joints"];
+	int nbones = skinJoints.size();
+	this->fps = AMG_GLTF_FPS;
+	this->nanimations = anims.size();
+	this->animations = (Animation**) calloc (this->nanimations, sizeof(Animation*));
+	float *data = (float*) malloc (7 * nbones * sizeof(float));
+	for(unsigned int a=0;a<this->nanimations;a++){
+		std::vector<AMG_GLTFChannel> translations(nbones), rotations(nbones);
+		std::vector<float> times;
+		const JsonValue &channels = anims[a]["channels"];
+		for(int c=0;c<channels.size();c++){
+			const JsonValue &target = channels[c]["target"];
+			int node = target["node"].getInt(-1);
+			int bone = (node >= 0 && node < nnodes) ? jointOf[node] : -1;
+			const JsonValue &sampler = anims[a]["samplers"][channels[c]["sampler"].getInt(-1)];
+			AMG_GLTFChannel *channel = NULL;
+			if(bone >= 0 && target["path"].getString() == "translation") channel = &translations[bone];
+			if(bone >= 0 && target["path"].getString() == "rotation") channel = &rotations[bone];
+			if(channel && readChannel(json, bin, binSize, sampler, (channel == &translations[bone]) ? 3 : 4, channel)){
+				times.insert(times.end(), channel->times.begin(), channel->times.end());
+			}
+		}
+		std::sort(times.begin(), times.end());
+		times.erase(std::unique(times.begin(), times.end()), times.end());
+		if(times.empty()) times.push_back(0.0f);
+		if(times.size() == 1) times.push_back(times[0] + 1.0f / AMG_GLTF_FPS);		// Animations need two keyframes
+
+		// Build the keyframes
+		Keyframe **keyframes = (Keyframe**) calloc (times.size(), sizeof(Keyframe*));
+		for(unsigned int t=0;t<times.size();t++){
+			for(int k=0;k<nbones;k++){
+				int node = skinJoints[k].getInt(-1);
+				vec3 p;
+				quat r;
+				decomposeMatrix(getNodeMatrix(nodes[node]), &p, &r, NULL);
+				float value[4];
+				if(!translations[k].times.empty()){
+					sampleChannel(translations[k], times[t], value);
+					p = glm::make_vec3(value);
+				}
+				if(!rotations[k].times.empty()){
+					sampleChannel(rotations[k], times[t], value);
+					r = quat(value[3], value[0], value[1], value[2]);
+				}
+				int parent = (node >= 0 && node < nnodes) ? parents[node] : -1;
+				if(parent < 0 || jointOf[parent] < 0){		// Root bone: add the nodes above it
+					mat4 m = getWorldMatrix(nodes, parents, parent) * glm::translate(mat4(1.0f), p) * glm::toMat4(r);
+					decomposeMatrix(m, &p, &r, NULL);
+				}
+				float *d = &data[k * 7];
+				d[0] = p.x; d[1] = p.y; d[2] = p.z;
+				d[3] = r.x; d[4] = r.y; d[5] = r.z; d[6] = r.w;
+			}
+			keyframes[t] = new Keyframe((times[t] - times[0]) * AMG_GLTF_FPS, data, nbones);
+		}
+		this->animations[a] = new Animation(keyframes, times.size());
+	}
+	free(data);
 }
 
 /**
  * @brief Draw a 3D model previously loaded
  */
 void Model::draw(){
-	for(unsigned int i=0;i<nobjects;i++){
+	for(unsigned int i=0;i<getNObjects();i++){
 		objects[i]->draw();
 	}
 }
@@ -204,7 +903,7 @@ void Model::draw(){
  * @brief Draw a 3D model previously loaded, in the simplest way possible
  */
 void Model::drawSimple(){
-	for(unsigned int i=0;i<nobjects;i++){
+	for(unsigned int i=0;i<getNObjects();i++){
 		objects[i]->drawSimple();
 	}
 }
@@ -215,7 +914,7 @@ void Model::drawSimple(){
  * @param animIndex Which animation to apply to the object
  */
 void Model::animate(unsigned int objIndex, unsigned int animIndex){
-	if(objIndex < nobjects && animIndex < nanimations){
+	if(objIndex < getNObjects() && animIndex < getNAnimations()){
 		animations[animIndex]->increaseTime(fps * Renderer::getDelta());
 		Keyframe *first, *last;
 		float progress = animations[animIndex]->getKeyframes(&first, &last);
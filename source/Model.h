@@ -6,6 +6,10 @@
 #ifndef MODEL_H_
 #define MODEL_H_
 
+// Includes C/C++
+#include <string>
+#include <vector>
+
 // Own includes
 #include "Entity.h"
 #include "Object.h"
@@ -13,11 +17,14 @@
 #include "Renderer.h"
 #include "Animation.h"
 
+// Defines
+#define AMG_GLTF_FPS 24		/**< Frames per second of the animations read from glTF files */
+
 namespace AMG {
 
 /**
  * @class Model
- * @brief Holds a 3D model and a loader for *.amd files
+ * @brief Holds a 3D model and a loader for *.amd and binary glTF (*.glb) files
  */
 class Model: public Entity {
 private:
@@ -28,9 +35,16 @@ private:
 	Material **materials;			/**< List of materials */
 	Object **objects;				/**< List of objects */
 	Animation **animations;			/**< List of animations */
+	std::vector<std::pair<unsigned int, std::string> > textures;	/**< Material index and path of the textures to load in upload() */
+	bool uploaded;					/**< Was it uploaded? It's empty until then, even if it's being parsed */
+	Model();
+	void parse(const char *path, const char *file, int size, bool tangent, bool deferred);
+	void parseGLB(const char *path, const char *file, int size, bool tangent, bool deferred);
+	void upload(bool async);
+	friend class ModelAsset;
 public:
-	unsigned int getNObjects(){ return nobjects; }
-	unsigned int getNAnimations(){ return nanimations; }
+	unsigned int getNObjects(){ return (uploaded) ? nobjects : 0; }
+	unsigned int getNAnimations(){ return (uploaded) ? nanimations : 0; }
 	Object *getObject(int i){ return objects[i]; }
 	Animation *getAnimation(int i){ return animations[i]; }
 
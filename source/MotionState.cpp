@@ -0,0 +1,75 @@
+/**
+ * @file MotionState.cpp
+ * @brief Links a Bullet rigid body with the Transform of an Object
+ */
+
+// Own includes
+#include "MotionState.h"
+
+namespace AMG {
+
+/**
+ * @brief Constructor for a Motion State
+ * @param transform Transform to be driven by the rigid body
+ * @param moved List where this motion state is added when the simulation moves it
+ */
+MotionState::MotionState(Transform *transform, std::vector<MotionState*> *moved) {
+	this->transform = transform;
+	this->moved = moved;
+	this->pending = false;
+	snapshot();
+	simulated = kinematic;
+}
+
+/**
+ * @brief Get the initial transform of the body, or the current one for kinematic bodies
+ * @param worldTrans Where to store the transform
+ * @note Called from the physics thread, so it only reads the pose stored by snapshot()
+ */
+void MotionState::getWorldTransform(btTransform &worldTrans) const {
+	worldTrans = kinematic;
+}
+
+/**
+ * @brief Store the current pose of the Transform, to be read by the simulation
+ * @note Called from the main thread while the physics thread is idle, see World::update()
+ */
+void MotionState::snapshot(){
+	const vec3 &pos = transform->readPosition();
+	const quat &rot = transform->readRotation();
+	kinematic.setIdentity();
+	kinematic.setOrigin(btVector3(pos.x, pos.y, pos.z));
+	kinematic.setRotation(btQuaternion(rot.x, rot.y, rot.z, rot.w));
+}
+
+/**
+ * @brief Store the transform of a body moved by the simulation
+ * @param worldTrans New transform of the body, interpolated between the fixed steps
+ * @note Called from the physics thread, the Transform is not touched until apply()
+ */
+void MotionState::setWorldTransform(const btTransform &worldTrans){
+	simulated = worldTrans;
+	if(!pending){
+		pending = true;
+		moved->push_back(this);
+	}
+}
+
+/**
+ * @brief Write the last simulated pose into the Transform, marking it as dirty
+ */
+void MotionState::apply(){
+	const btVector3 &pos = simulated.getOrigin();
+	btQuaternion rot = simulated.getRotation();
+	transform->setPosition(vec3(pos.x(), pos.y(), pos.z()));
+	transform->setRotation(quat(rot.w(), rot.x(), rot.y(), rot.z()));
+	pending = false;
+}
+
+/**
+ * @brief Destructor for a Motion State
+ */
+MotionState::~MotionState() {
+}
+
+}
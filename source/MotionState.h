@@ -0,0 +1,48 @@
+/**
+ * @file MotionState.h
+ * @brief Links a Bullet rigid body with the Transform of an Object
+ */
+
+#ifndef MOTIONSTATE_H_
+#define MOTIONSTATE_H_
+
+// Includes C/C++
+#include <vector>
+
+// Includes Bullet
+#include <btBulletDynamicsCommon.h>
+
+// Own includes
+#include "Transform.h"
+
+namespace AMG {
+
+/**
+ * @class MotionState
+ * @brief Motion state which buffers the simulated pose and then writes it into an engine Transform
+ * @note Bullet only calls setWorldTransform() for the bodies it has moved, so
+ * static and sleeping bodies are never touched. The simulation can run on another
+ * thread, so the Transform is only read by snapshot() and written by apply(), from the main thread
+ */
+class MotionState : public btMotionState {
+private:
+	Transform *transform;				/**< Transform updated by the physics engine */
+	btTransform simulated;				/**< Last (interpolated) pose written by the simulation */
+	btTransform kinematic;				/**< Pose of the Transform when the step started, read by the simulation */
+	std::vector<MotionState*> *moved;	/**< List of moved motion states, waiting to be applied */
+	bool pending;						/**< Is this motion state in the moved list? */
+public:
+	Transform *getTransform(){ return transform; }
+	bool isPending(){ return pending; }
+
+	MotionState(Transform *transform, std::vector<MotionState*> *moved);
+	virtual void getWorldTransform(btTransform &worldTrans) const;
+	virtual void setWorldTransform(const btTransform &worldTrans);
+	void snapshot();
+	void apply();
+	virtual ~MotionState();
+};
+
+}
+
+#endif
@@ -6,10 +6,12 @@
 // Includes C/C++
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // Own includes
 #include "Music.h"
 #include "Debug.h"
+#include "FileSystem.h"
 
 namespace AMG {
 
@@ -21,6 +23,66 @@ static ov_callbacks vorbis_callbacks = {
   (long (*)(void *))                            ftell
 };
 
+/**
+ * @struct AMG_MemoryStream
+ * @brief Ogg file held in memory, for the files inside the pack
+ */
+typedef struct{
+	const char *data;			/**< File data */
+	long long size;				/**< Size of the file, in bytes */
+	long long position;			/**< Read position */
+	char *owned;				/**< Data to release on close, NULL if it is mapped */
+}AMG_MemoryStream;
+
+/**
+ * @brief Internal libvorbis callback to read from memory
+ */
+static size_t memoryRead(void *ptr, size_t size, size_t nmemb, void *source){
+	AMG_MemoryStream *stream = (AMG_MemoryStream*) source;
+	if(size == 0) return 0;
+	size_t n = size * nmemb;
+	if(n > (size_t)(stream->size - stream->position)) n = stream->size - stream->position;
+	n -= n % size;
+	memcpy(ptr, stream->data + stream->position, n);
+	stream->position += n;
+	return n / size;
+}
+
+/**
+ * @brief Internal libvorbis callback to seek in memory
+ */
+static int memorySeek(void *source, ogg_int64_t offset, int whence){
+	AMG_MemoryStream *stream = (AMG_MemoryStream*) source;
+	long long position = offset;
+	if(whence == SEEK_CUR) position += stream->position;
+	else if(whence == SEEK_END) position += stream->size;
+	if(position < 0 || position > stream->size) return -1;
+	stream->position = position;
+	return 0;
+}
+
+/**
+ * @brief Internal libvorbis callback to release the memory
+ */
+static int memoryClose(void *source){
+	AMG_MemoryStream *stream = (AMG_MemoryStream*) source;
+	if(stream->owned) free(stream->owned);
+	delete stream;
+	return 0;
+}
+
+/**
+ * @brief Internal libvorbis callback to get the position in memory
+ */
+static long memoryTell(void *source){
+	return (long)((AMG_MemoryStream*) source)->position;
+}
+
+// Internal libvorbis callbacks, for files in memory
+static ov_callbacks memory_callbacks = {
+	memoryRead, memorySeek, memoryClose, memoryTell
+};
+
 /**
  * @brief Internal function to decode a block of the vorbis ogg file
  * @param psOggVorbisFile Vorbis file to read from
@@ -59,15 +121,26 @@ static unsigned long DecodeOggVorbis(OggVorbis_File *psOggVorbisFile, char *pDec
  */
 Music::Music(const char *path) : AudioSource(0.0f, 1.0f, 0.0f){
 
-	// Open the music file
-	FILE *file = fopen(Entity::getFullPath(path, AMG_AUDIO), "rb");
-	if(file == NULL){
-		Debug::showError(FILE_NOT_FOUND, (void*)path);
+	// Files in the pack are decoded from memory, mapped if they are not compressed
+	if(FileSystem::isPacked(path, AMG_AUDIO)){
+		int size = 0;
+		AMG_MemoryStream *stream = new AMG_MemoryStream();
+		stream->owned = NULL;
+		stream->position = 0;
+		stream->data = FileSystem::map(path, AMG_AUDIO, &size);
+		if(stream->data == NULL) stream->data = stream->owned = FileSystem::readFile(path, AMG_AUDIO, &size);
+		stream->size = size;
+		ov_open_callbacks(stream, &vorbisFile, NULL, 0, memory_callbacks);
+
+	// Loose files are streamed from disk
+	}else{
+		FILE *file = fopen(Entity::getFullPath(path, AMG_AUDIO), "rb");
+		if(file == NULL){
+			Debug::showError(FILE_NOT_FOUND, (void*)path);
+		}
+		ov_open_callbacks(file, &vorbisFile, NULL, 0, vorbis_callbacks);
 	}
 
-	// Start the vorbis handle
-	ov_open_callbacks(file, &vorbisFile, NULL, 0, vorbis_callbacks);
-
 	// Get information about the file
 	vorbis_info *psVorbisInfo = ov_info(&vorbisFile, -1);
 	if(psVorbisInfo){
@@ -6,21 +6,22 @@
 // Includes C/C++
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 // Own includes
 #include "Object.h"
 #include "Debug.h"
 #include "Renderer.h"
+#include "OcclusionCulling.h"
 
 namespace AMG {
 
 /**
  * @brief Constructor for an Object
+ * @param deferred Keep its buffers in client memory until upload()? See MeshData
  */
-Object::Object() {
-	this->position = vec3(0.0f, 0.0f, 0.0f);
-	this->rotation = quat(1, 0, 0, 0);
-	this->scale = vec3(1.0f, 1.0f, 1.0f);
+Object::Object(bool deferred) : MeshData(deferred) {
+	this->transform.setZUp(true);
 	this->groups = NULL;
 	this->ngroups = 0;
 	this->materials = NULL;		// References from a Model object
@@ -28,6 +29,8 @@ Object::Object() {
 	this->rootBone = NULL;
 	this->bbox = vec3(0.0f, 0.0f, 0.0f);
 	this->visible = true;
+	this->occluder = false;
+	this->bodyIndex = -1;
 }
 
 /**
@@ -64,15 +67,31 @@ void Object::createBoneHierarchy(bone_t *bones, unsigned int nbones){
 	free(bones);
 }
 
+/**
+ * @brief Set whether this object hides other objects in the occlusion culling engine
+ * @param occluder Use it as an occluder?
+ * @note Occluders should have few triangles, as they are rasterized on the CPU
+ */
+void Object::setOccluder(bool occluder){
+	if(occluder && !this->occluder){
+		OcclusionCulling::addOccluder(this);
+	}else if(!occluder && this->occluder){
+		OcclusionCulling::removeOccluder(this);
+	}
+	this->occluder = occluder;
+}
+
 /**
  * @brief Draw an Object
  */
 void Object::draw(){
 
 	// Transform the object
-	Renderer::setTransformationZ(position, rotation, scale);
+	Renderer::setModel(transform.getModelMatrix());
 	Renderer::updateMVP();
 	visible = Renderer::isBBoxVisible(bbox);
+	if(visible && OcclusionCulling::isActive())
+		visible = OcclusionCulling::isBBoxVisible(bbox, Renderer::getModel());
 	if(!visible) return;
 
 	// Transform each bone
@@ -80,12 +99,14 @@ void Object::draw(){
 		rootBone->calculateBoneMatrix(NULL);
 
 	this->enableBuffers();
+	float pixels = Renderer::getScreenSize(bbox);
 
 	for(unsigned int i=0;i<ngroups;i++){
 		int first = groups[i*3 + 0]*3;
 		int last = groups[i*3 + 1]*3;
 		int mat_index = groups[i*3 + 2];
 		if(groups[i*3 + 2] < nmaterials){		// Valid range of materials
+			materials[mat_index]->request(pixels);
 			materials[mat_index]->apply();
 			glDrawElements(GL_TRIANGLES, last - first, GL_UNSIGNED_SHORT, (void*)(first << 1));
 			materials[mat_index]->disable();
@@ -101,7 +122,7 @@ void Object::draw(){
 void Object::drawSimple(){
 
 	// Transform the object
-	Renderer::setTransformationZ(position, rotation, scale);
+	Renderer::setModel(transform.getModelMatrix());
 	Renderer::updateMVP();
 	visible = Renderer::isBBoxVisible(bbox);
 	if(!visible) return;
@@ -112,7 +133,7 @@ void Object::drawSimple(){
 	buffer_info &binfo = info.at(0);
 	glEnableVertexAttribArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, binfo.id);
-	glVertexAttribPointer(0, binfo.size, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	glVertexAttribPointer(0, binfo.size, GL_FLOAT, GL_FALSE, binfo.stride, (void*)(intptr_t)binfo.offset);
 
 	// Draw elements
 	glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_SHORT, NULL);
@@ -125,6 +146,7 @@ void Object::drawSimple(){
  * Destructor for an Object
  */
 Object::~Object() {
+	if(occluder) OcclusionCulling::removeOccluder(this);
 	if(groups) free(groups);
 	if(rootBone) delete rootBone;
 }
@@ -6,6 +6,9 @@
 #ifndef OBJECT_H_
 #define OBJECT_H_
 
+// Includes C/C++
+#include <string>
+
 // Includes OpenGL
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
@@ -17,6 +20,7 @@ using namespace glm;
 #include "MeshData.h"
 #include "Material.h"
 #include "Bone.h"
+#include "Transform.h"
 
 namespace AMG {
 
@@ -29,27 +33,39 @@ private:
 	Bone *rootBone;					/**< Bone hierarchy, NULL if there are no bones */
 	vec3 bbox;						/**< Bounding box, without transformations */
 	bool visible;					/**< Is this object visible? */
+	bool occluder;					/**< Does this object hide other objects? (occlusion culling) */
+	std::string source;				/**< Model file and object index (e.g. "level.amd.0"), used to name its sidecar files */
+	int bodyIndex;					/**< Index of its rigid body in the physics World, -1 if it has none */
 protected:
 	Material **materials;			/**< Buffer of materials, same for a Model */
 	unsigned int nmaterials;		/**< Number of materials, same for a Model */
 	unsigned short *groups;			/**< Buffer of material groups, each entry has a material index */
 	unsigned int ngroups;			/**< Number of groups in this object */
-	vec3 position;					/**< Object position */
-	quat rotation;					/**< Object rotation */
-	vec3 scale;						/**< Object scale */
+	Transform transform;			/**< Object position, rotation and scale, with its cached model matrix */
 public:
 	unsigned int getNMaterials(){ return nmaterials; }
 	Material *getMaterial(int i){ return materials[i]; }
 	Bone *getRootBone(){ return rootBone; }
-	vec3 &getPosition(){ return position; }
-	quat &getRotation(){ return rotation; }
-	vec3 &getScale(){ return scale; }
+	vec3 &getPosition(){ return transform.getPosition(); }
+	quat &getRotation(){ return transform.getRotation(); }
+	vec3 &getScale(){ return transform.getScale(); }
+	const vec3 &readPosition() const { return transform.readPosition(); }
+	const quat &readRotation() const { return transform.readRotation(); }
+	const vec3 &readScale() const { return transform.readScale(); }
+	void setPosition(const vec3 &p){ transform.setPosition(p); }
+	void setRotation(const quat &r){ transform.setRotation(r); }
+	void setScale(const vec3 &s){ transform.setScale(s); }
+	Transform &getTransform(){ return transform; }
 	vec3 &getBBox(){ return bbox; }
 	bool isVisible(){ return visible; }
+	bool isOccluder(){ return occluder; }
+	std::string &getSource(){ return source; }
+	int &getBodyIndex(){ return bodyIndex; }
 
-	Object();
+	Object(bool deferred=false);
 	void setMaterialGroups(unsigned short *groups, unsigned int ngroups, Material **materials, unsigned int nmaterials);
 	void createBoneHierarchy(bone_t *bones, unsigned int nbones);
+	void setOccluder(bool occluder);
 	void draw();
 	void drawSimple();
 	virtual ~Object();
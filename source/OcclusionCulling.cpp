@@ -0,0 +1,345 @@
+/**
+ * @file OcclusionCulling.cpp
+ * @brief Software occlusion culling, using a low resolution depth buffer
+ */
+
+// Includes C/C++
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+
+// Includes OpenGL
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/transform.hpp>
+
+// Own includes
+#include "OcclusionCulling.h"
+#include "Renderer.h"
+#include "Debug.h"
+#include "Simd.h"
+
+namespace AMG {
+
+// Static variables
+float *OcclusionCulling::depthBuffer = NULL;
+int OcclusionCulling::width = 0;
+int OcclusionCulling::height = 0;
+int OcclusionCulling::tilesX = 0;
+int OcclusionCulling::tilesY = 0;
+bool OcclusionCulling::active = false;
+bool OcclusionCulling::pending = false;
+mat4 OcclusionCulling::viewProjection;
+std::vector<Object*> OcclusionCulling::occluders;
+std::vector<mat4> OcclusionCulling::occluderMVP;
+std::vector<vec4> OcclusionCulling::clipVertices;
+std::vector<AMG_OccluderTriangle> OcclusionCulling::triangles;
+std::vector< std::vector<int> > OcclusionCulling::bins;
+AMG_JobCounter OcclusionCulling::counter(0);
+
+/**
+ * @brief Initialize the occlusion culling engine
+ * @param w Depth buffer width, in pixels (rounded up to a multiple of 4)
+ * @param h Depth buffer height, in pixels
+ */
+void OcclusionCulling::initialize(int w, int h){
+	width = (w + 3) & ~3;
+	height = h;
+	tilesX = (width + AMG_OCCLUSION_TILE_SIZE - 1) / AMG_OCCLUSION_TILE_SIZE;
+	tilesY = (height + AMG_OCCLUSION_TILE_SIZE - 1) / AMG_OCCLUSION_TILE_SIZE;
+	depthBuffer = (float*) malloc (width * height * sizeof(float));
+	for(int i=0;i<width*height;i++){
+		depthBuffer[i] = 1.0f;
+	}
+	bins = std::vector< std::vector<int> >(tilesX * tilesY);
+	active = false;
+	pending = false;
+}
+
+/**
+ * @brief Add an occluder
+ * @param obj Object which can hide other objects, it should have few triangles
+ * @note Called by Object::setOccluder()
+ */
+void OcclusionCulling::addOccluder(Object *obj){
+	if(obj->getVertices() == NULL || obj->getIndices() == NULL){
+		Debug::showError(NO_VERTEX_DATA, NULL);
+	}
+	if(std::find(occluders.begin(), occluders.end(), obj) == occluders.end()){
+		occluders.push_back(obj);
+	}
+}
+
+/**
+ * @brief Remove an occluder
+ * @param obj Object to remove
+ */
+void OcclusionCulling::removeOccluder(Object *obj){
+	std::vector<Object*>::iterator it = std::find(occluders.begin(), occluders.end(), obj);
+	if(it != occluders.end()){
+		occluders.erase(it);
+	}
+}
+
+/**
+ * @brief Start rasterizing the occluders on the worker threads
+ * @note Call it after updating the camera
+ */
+void OcclusionCulling::start(){
+
+	// Check there is something to do
+	if(depthBuffer == NULL || pending || occluders.empty()) return;
+
+	// Snapshot the matrices, as the render thread changes them meanwhile
+	viewProjection = Renderer::getPerspective() * Renderer::getView();
+	occluderMVP.resize(occluders.size());
+	for(unsigned int i=0;i<occluders.size();i++){
+		Object *o = occluders[i];
+		Transform::multiply(viewProjection, o->getTransform().getModelMatrix(), occluderMVP[i]);
+	}
+
+	// Launch the rasterization
+	pending = true;
+	JobSystem::submit(setupJob, NULL, 0, &counter);
+}
+
+/**
+ * @brief Transform and bin the occluder triangles, then launch one job per tile
+ * @param data Unused
+ * @param index Unused
+ */
+void OcclusionCulling::setupJob(void *data, int index){
+
+	// Clear previous data
+	triangles.clear();
+	for(unsigned int i=0;i<bins.size();i++){
+		bins[i].clear();
+	}
+
+	for(unsigned int i=0;i<occluders.size();i++){
+
+		// Transform the vertices to clip space
+		Object *o = occluders[i];
+		float *vertices = o->getVertices();
+		unsigned short *indices = o->getIndices();
+		int nvertices = o->getNVertices();
+		int nindices = o->getNIndices();
+		mat4 &mvp = occluderMVP[i];
+		clipVertices.resize(nvertices);
+		for(int j=0;j<nvertices;j++){
+			clipVertices[j] = mvp * vec4(vertices[j*3 + 0], vertices[j*3 + 1], vertices[j*3 + 2], 1.0f);
+		}
+
+		// Build each triangle
+		for(int j=0;j+2<nindices;j+=3){
+			AMG_OccluderTriangle t;
+			bool clipped = false;
+			for(int k=0;k<3;k++){
+				vec4 &v = clipVertices[indices[j + k]];
+				if(v.w < AMG_OCCLUSION_NEAR){		// Crosses the near plane, skipping it is conservative
+					clipped = true;
+					break;
+				}
+				t.x[k] = (v.x / v.w * 0.5f + 0.5f) * width;
+				t.y[k] = (v.y / v.w * 0.5f + 0.5f) * height;
+				t.z[k] = v.z / v.w * 0.5f + 0.5f;
+			}
+			if(clipped) continue;
+
+			// Discard degenerate triangles
+			float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+			if(fabsf(area) < 1e-6f) continue;
+
+			// Calculate the bounding rectangle, and discard the triangle if it is off screen
+			t.minX = glm::max((int)floorf(glm::min(t.x[0], glm::min(t.x[1], t.x[2]))), 0);
+			t.minY = glm::max((int)floorf(glm::min(t.y[0], glm::min(t.y[1], t.y[2]))), 0);
+			t.maxX = glm::min((int)ceilf(glm::max(t.x[0], glm::max(t.x[1], t.x[2]))), width - 1);
+			t.maxY = glm::min((int)ceilf(glm::max(t.y[0], glm::max(t.y[1], t.y[2]))), height - 1);
+			if(t.minX > t.maxX || t.minY > t.maxY) continue;
+
+			// Add the triangle to every tile it touches
+			int id = triangles.size();
+			triangles.push_back(t);
+			for(int ty=t.minY/AMG_OCCLUSION_TILE_SIZE;ty<=t.maxY/AMG_OCCLUSION_TILE_SIZE;ty++){
+				for(int tx=t.minX/AMG_OCCLUSION_TILE_SIZE;tx<=t.maxX/AMG_OCCLUSION_TILE_SIZE;tx++){
+					bins[ty * tilesX + tx].push_back(id);
+				}
+			}
+		}
+	}
+
+	// Rasterize the tiles in parallel
+	JobSystem::parallelFor(rasterizeJob, NULL, tilesX * tilesY, &counter);
+}
+
+/**
+ * @brief Clear a tile and rasterize all the triangles that overlap it
+ * @param data Unused
+ * @param index Tile index
+ */
+void OcclusionCulling::rasterizeJob(void *data, int index){
+
+	// Get the tile rectangle
+	int x0 = (index % tilesX) * AMG_OCCLUSION_TILE_SIZE;
+	int y0 = (index / tilesX) * AMG_OCCLUSION_TILE_SIZE;
+	int x1 = glm::min(x0 + AMG_OCCLUSION_TILE_SIZE, width);
+	int y1 = glm::min(y0 + AMG_OCCLUSION_TILE_SIZE, height);
+
+	// Clear the tile
+	AMG_Float4 cleared = simdSet(1.0f);
+	for(int y=y0;y<y1;y++){
+		float *row = &depthBuffer[y * width];
+		for(int x=x0;x<x1;x+=4){
+			simdStore(&row[x], cleared);
+		}
+	}
+
+	// Rasterize each triangle
+	std::vector<int> &bin = bins[index];
+	for(unsigned int i=0;i<bin.size();i++){
+		rasterizeTriangle(triangles[bin[i]], x0, y0, x1, y1);
+	}
+}
+
+/**
+ * @brief Rasterize a triangle inside a tile, keeping the nearest depth
+ * @param t Triangle to rasterize
+ * @param x0 Tile minimum X coordinate, in pixels (multiple of 4)
+ * @param y0 Tile minimum Y coordinate, in pixels
+ * @param x1 Tile maximum X coordinate, not included (multiple of 4)
+ * @param y1 Tile maximum Y coordinate, not included
+ */
+void OcclusionCulling::rasterizeTriangle(AMG_OccluderTriangle &t, int x0, int y0, int x1, int y1){
+
+	// Make the triangle counter-clockwise
+	float x[3] = {t.x[0], t.x[1], t.x[2]};
+	float y[3] = {t.y[0], t.y[1], t.y[2]};
+	float z[3] = {t.z[0], t.z[1], t.z[2]};
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if(area < 0.0f){
+		std::swap(x[1], x[2]);
+		std::swap(y[1], y[2]);
+		std::swap(z[1], z[2]);
+		area = -area;
+	}
+
+	// Edge equations (E = A*x + B*y + C), edge i is opposite to vertex i
+	float A[3], B[3], C[3];
+	for(int i=0;i<3;i++){
+		int a = (i + 1) % 3;
+		int b = (i + 2) % 3;
+		A[i] = y[a] - y[b];
+		B[i] = x[b] - x[a];
+		C[i] = x[a] * y[b] - x[b] * y[a];
+	}
+
+	// Depth plane equation, from barycentric coordinates
+	float invArea = 1.0f / area;
+	float zx = (z[0] * A[0] + z[1] * A[1] + z[2] * A[2]) * invArea;
+	float zy = (z[0] * B[0] + z[1] * B[1] + z[2] * B[2]) * invArea;
+	float zc = (z[0] * C[0] + z[1] * C[1] + z[2] * C[2]) * invArea;
+
+	// Clip the bounding rectangle against the tile
+	int minX = glm::max(t.minX, x0) & ~3;
+	int maxX = glm::min(t.maxX, x1 - 1);
+	int minY = glm::max(t.minY, y0);
+	int maxY = glm::min(t.maxY, y1 - 1);
+
+	// Rasterize four pixels at once
+	AMG_Float4 zero = simdSet(0.0f);
+	AMG_Float4 laneOffset = simdSet(0.5f, 1.5f, 2.5f, 3.5f);
+	AMG_Float4 A0 = simdSet(A[0]), A1 = simdSet(A[1]), A2 = simdSet(A[2]), ZX = simdSet(zx);
+	for(int py=minY;py<=maxY;py++){
+		float fy = py + 0.5f;
+		AMG_Float4 rowE0 = simdSet(B[0] * fy + C[0]);
+		AMG_Float4 rowE1 = simdSet(B[1] * fy + C[1]);
+		AMG_Float4 rowE2 = simdSet(B[2] * fy + C[2]);
+		AMG_Float4 rowZ = simdSet(zy * fy + zc);
+		float *row = &depthBuffer[py * width];
+		for(int px=minX;px<=maxX;px+=4){
+			AMG_Float4 fx = simdAdd(simdSet((float)px), laneOffset);
+			AMG_Float4 e0 = simdAdd(simdMul(A0, fx), rowE0);
+			AMG_Float4 e1 = simdAdd(simdMul(A1, fx), rowE1);
+			AMG_Float4 e2 = simdAdd(simdMul(A2, fx), rowE2);
+			AMG_Float4 inside = simdAnd(simdCmpGe(e0, zero), simdAnd(simdCmpGe(e1, zero), simdCmpGe(e2, zero)));
+			if(simdMask(inside) == 0) continue;
+			AMG_Float4 depth = simdAdd(simdMul(ZX, fx), rowZ);
+			AMG_Float4 old = simdLoad(&row[px]);
+			simdStore(&row[px], simdSelect(inside, simdMin(old, depth), old));
+		}
+	}
+}
+
+/**
+ * @brief Wait for the rasterization and enable the bounding box tests
+ * @note Call it before drawing the main scene
+ */
+void OcclusionCulling::wait(){
+	if(!pending) return;
+	JobSystem::wait(&counter);
+	pending = false;
+	active = true;
+}
+
+/**
+ * @brief Disable the bounding box tests
+ * @note Call it before drawing from other points of view (reflections, cube maps...)
+ */
+void OcclusionCulling::end(){
+	active = false;
+}
+
+/**
+ * @brief Checks whether a bounding box is hidden by the occluders
+ * @param box Maximum coordinate of the bounding box
+ * @param model Model matrix of the bounding box
+ * @return false if the box is fully occluded, true otherwise
+ */
+bool OcclusionCulling::isBBoxVisible(vec3 box, mat4 &model){
+
+	// Project the bounding box onto the screen
+	mat4 mvp = viewProjection * model;
+	float minX = (float)width, minY = (float)height, maxX = 0.0f, maxY = 0.0f, minZ = 1.0f;
+	for(int i=0;i<8;i++){
+		vec4 p = mvp * vec4((i & 1) ? -box.x : box.x, (i & 2) ? -box.y : box.y, (i & 4) ? -box.z : box.z, 1.0f);
+		if(p.w < AMG_OCCLUSION_NEAR) return true;		// Too near to the camera
+		float sx = (p.x / p.w * 0.5f + 0.5f) * width;
+		float sy = (p.y / p.w * 0.5f + 0.5f) * height;
+		minX = glm::min(minX, sx);
+		minY = glm::min(minY, sy);
+		maxX = glm::max(maxX, sx);
+		maxY = glm::max(maxY, sy);
+		minZ = glm::min(minZ, p.z / p.w * 0.5f + 0.5f);
+	}
+
+	// Clip the rectangle against the screen, frustum culling is done somewhere else
+	int x0 = glm::max((int)floorf(minX), 0) & ~3;
+	int y0 = glm::max((int)floorf(minY), 0);
+	int x1 = glm::min((int)ceilf(maxX), width - 1);
+	int y1 = glm::min((int)ceilf(maxY), height - 1);
+	if(x0 > x1 || y0 > y1) return true;
+
+	// Visible if any pixel in the rectangle is farther than the box
+	AMG_Float4 depth = simdSet(minZ);
+	for(int y=y0;y<=y1;y++){
+		float *row = &depthBuffer[y * width];
+		for(int x=x0;x<=x1;x+=4){
+			if(simdMask(simdCmpGe(simdLoad(&row[x]), depth)) != 0) return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Terminate the occlusion culling engine
+ */
+void OcclusionCulling::finish(){
+	if(pending) JobSystem::wait(&counter);
+	if(depthBuffer) free(depthBuffer);
+	depthBuffer = NULL;
+	pending = false;
+	active = false;
+	occluders.clear();
+}
+
+}
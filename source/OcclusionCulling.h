@@ -0,0 +1,81 @@
+/**
+ * @file OcclusionCulling.h
+ * @brief Software occlusion culling, using a low resolution depth buffer
+ */
+
+#ifndef OCCLUSIONCULLING_H_
+#define OCCLUSIONCULLING_H_
+
+// Includes C/C++
+#include <vector>
+
+// Includes OpenGL
+#include <glm/glm.hpp>
+using namespace glm;
+
+// Own includes
+#include "Object.h"
+#include "JobSystem.h"
+
+// Defines
+#define AMG_OCCLUSION_TILE_SIZE 32		/**< Width and height of a rasterization tile, in pixels */
+#define AMG_OCCLUSION_NEAR 0.1f			/**< Minimum W for a vertex to be rasterized */
+
+namespace AMG {
+
+/**
+ * @struct AMG_OccluderTriangle
+ * @brief A triangle in screen space, ready to be rasterized
+ */
+typedef struct{
+	float x[3];			/**< X coordinates, in pixels */
+	float y[3];			/**< Y coordinates, in pixels */
+	float z[3];			/**< Depth, from 0 (near) to 1 (far) */
+	int minX, minY;		/**< Bounding rectangle minimum, in pixels */
+	int maxX, maxY;		/**< Bounding rectangle maximum, in pixels */
+}AMG_OccluderTriangle;
+
+/**
+ * @class OcclusionCulling
+ * @brief Rasterizes occluder Objects on the CPU and tests bounding boxes against them
+ * @note Start it before the shadow pass, so the rasterization runs meanwhile on the worker threads
+ */
+class OcclusionCulling {
+private:
+	static float *depthBuffer;								/**< Depth buffer, one float per pixel */
+	static int width;										/**< Depth buffer width, in pixels (multiple of 4) */
+	static int height;										/**< Depth buffer height, in pixels */
+	static int tilesX;										/**< Number of horizontal tiles */
+	static int tilesY;										/**< Number of vertical tiles */
+	static bool active;										/**< Are the bounding box tests enabled? */
+	static bool pending;									/**< Is there a rasterization in progress? */
+	static mat4 viewProjection;								/**< View projection matrix used in this frame */
+	static std::vector<Object*> occluders;					/**< Objects which hide other objects */
+	static std::vector<mat4> occluderMVP;					/**< MVP matrix of each occluder, for this frame */
+	static std::vector<vec4> clipVertices;					/**< Transformed vertices of the current occluder */
+	static std::vector<AMG_OccluderTriangle> triangles;		/**< Triangles to rasterize */
+	static std::vector< std::vector<int> > bins;			/**< Triangles overlapping each tile */
+	static AMG_JobCounter counter;							/**< Pending rasterization jobs */
+	OcclusionCulling(){}
+	static void setupJob(void *data, int index);
+	static void rasterizeJob(void *data, int index);
+	static void rasterizeTriangle(AMG_OccluderTriangle &t, int x0, int y0, int x1, int y1);
+public:
+	static bool isActive(){ return active; }
+	static int getWidth(){ return width; }
+	static int getHeight(){ return height; }
+	static float *getDepthBuffer(){ return depthBuffer; }
+
+	static void initialize(int w=256, int h=128);
+	static void addOccluder(Object *obj);
+	static void removeOccluder(Object *obj);
+	static void start();
+	static void wait();
+	static void end();
+	static bool isBBoxVisible(vec3 box, mat4 &model);
+	static void finish();
+};
+
+}
+
+#endif
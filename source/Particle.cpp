@@ -5,7 +5,6 @@
 
 // Own includes
 #include "Particle.h"
-#include "Renderer.h"
 
 namespace AMG {
 
@@ -25,41 +24,6 @@ Particle::Particle(vec3 position, vec3 velocity, float mass, float lifeLength, f
 	this->lifeLength = lifeLength;
 	this->rotation = rotation;
 	this->scale = scale;
-	this->elapsedTime = 0.0f;
-	this->life = 0.0f;
-}
-
-/**
- * @brief Update a particle life cycle
- * @return Whether the particle is dead or not
- */
-bool Particle::update(){
-	float delta = Renderer::getDelta();
-	velocity.y += -1.0f * mass * delta;
-	position += velocity * delta;
-	elapsedTime += delta;
-	life = elapsedTime / lifeLength;
-	return (elapsedTime > lifeLength);
-}
-
-/**
- * @brief Operator less than for a Particle, used for sorting
- * @param p Particle to compare this
- * @return Whether this is less than p
- */
-bool Particle::operator<(Particle &p){
-	Camera *cam = Renderer::getCamera();
-	vec3 v1 = this->position - cam->getPosition();
-	vec3 v2 = p.position - cam->getPosition();
-	float d1 = glm::dot(v1, v1);
-	float d2 = glm::dot(v2, v2);
-	return d1 > d2;
-}
-
-/**
- * @brief Destructor for a Particle
- */
-Particle::~Particle() {
 }
 
 }
@@ -0,0 +1,187 @@
+/**
+ * @file ParticleEmitter.cpp
+ * @brief Spawns particles on a ParticleSource
+ */
+
+// Includes C/C++
+#include <stdlib.h>
+#include <math.h>
+
+// Own includes
+#include "ParticleEmitter.h"
+#include "Renderer.h"
+
+namespace AMG {
+
+/**
+ * @brief Constructor for a Particle Emitter
+ * @param source Source where the particles are spawned
+ * @param particle Initial state of every particle, its position is relative to the emitter
+ * @param rate Particles spawned per second
+ */
+ParticleEmitter::ParticleEmitter(ParticleSource *source, Particle particle, float rate) : particle(particle) {
+	this->source = source;
+	this->position = vec3(0.0f, 0.0f, 0.0f);
+	this->shape = AMG_EMITTER_POINT;
+	this->size = vec3(0.0f, 0.0f, 0.0f);
+	this->spread = 0.0f;
+	this->rate = rate;
+	this->burstCount = 0;
+	this->burstInterval = 0.0f;
+	this->burstTimer = 0.0f;
+	this->pendingBurst = 0;
+	this->accumulator = 0.0f;
+	this->priority = 0.5f;
+	this->nearDistance = 0.0f;
+	this->farDistance = 0.0f;
+	this->enabled = true;
+	if(source) source->addEmitter(this);
+}
+
+/**
+ * @brief Set the volume where the particles are spawned
+ * @param shape Spawn shape, see AMG_EmitterShape
+ * @param size Spawn shape size
+ */
+void ParticleEmitter::setShape(int shape, vec3 size){
+	this->shape = shape;
+	this->size = size;
+}
+
+/**
+ * @brief Spawn particles periodically, besides the continuous rate
+ * @param count Particles on each burst
+ * @param interval Time between bursts, 0 to disable them
+ */
+void ParticleEmitter::setBurst(int count, float interval){
+	this->burstCount = count;
+	this->burstInterval = interval;
+	this->burstTimer = 0.0f;
+}
+
+/**
+ * @brief Set the camera distances used to throttle this emitter
+ * @param nearDistance Distance where the spawn rate starts to go down
+ * @param farDistance Distance where nothing is spawned, 0 to disable distance throttling
+ */
+void ParticleEmitter::setDistances(float nearDistance, float farDistance){
+	this->nearDistance = nearDistance;
+	this->farDistance = farDistance;
+}
+
+/**
+ * @brief Spawn a number of particles on the next update
+ * @param count Number of particles
+ * @note Bursts are not throttled by distance, but they still need room in the pool and the budget
+ */
+void ParticleEmitter::burst(int count){
+	pendingBurst += count;
+}
+
+/**
+ * @brief Get how much of the spawn rate can be used right now
+ * @return A factor from 0 (spawn nothing) to 1 (full rate)
+ */
+float ParticleEmitter::getThrottle(){
+
+	// Budget: low priority emitters stop first as the budget fills up
+	float limit = AMG_EMITTER_THROTTLE + (1.0f - AMG_EMITTER_THROTTLE) * priority;
+	if(ParticleSource::getBudgetUsage() >= limit) return 0.0f;
+
+	// Distance: full rate when near the camera, nothing when far
+	Camera *cam = Renderer::getCamera();
+	if(cam == NULL || farDistance <= nearDistance) return 1.0f;
+	float d = glm::length(position - cam->getPosition());
+	return glm::clamp((farDistance - d) / (farDistance - nearDistance), 0.0f, 1.0f);
+}
+
+/**
+ * @brief Get a random number
+ * @return A number between -1 and 1
+ */
+float ParticleEmitter::random(){
+	return (rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+}
+
+/**
+ * @brief Spawn particles on the source, until it's full
+ * @param n Number of particles
+ */
+void ParticleEmitter::spawn(int n){
+	vec3 &basePosition = particle.getPosition();
+	vec3 &baseVelocity = particle.getVelocity();
+	for(int i=0;i<n;i++){
+
+		// Choose the position and velocity
+		vec3 pos = position + basePosition;
+		vec3 vel = baseVelocity;
+		if(shape == AMG_EMITTER_SPHERE){
+			vec3 r = vec3(random(), random(), random());
+			if(glm::dot(r, r) > 1.0f) r = glm::normalize(r);
+			pos += r * size.x;
+		}else if(shape == AMG_EMITTER_BOX){
+			pos += vec3(random(), random(), random()) * size;
+		}else if(shape == AMG_EMITTER_CONE){
+			float speed = glm::length(vel);
+			vec3 dir = (speed > 0.0f) ? vel / speed : vec3(0.0f, 1.0f, 0.0f);
+			vec3 side = glm::normalize(glm::cross(dir, (fabs(dir.y) < 0.99f) ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+			vec3 up = glm::cross(dir, side);
+			float angle = (random() * 0.5f + 0.5f) * size.x;
+			float turn = random() * 3.141592f;
+			vel = (dir * cosf(angle) + (side * cosf(turn) + up * sinf(turn)) * sinf(angle)) * speed;
+		}
+		vel += vec3(random(), random(), random()) * spread;
+
+		// Add it, stopping when the pool or the budget are full
+		Particle p(pos, vel, particle.getMass(), particle.getLifeLength(), particle.getRotation(), particle.getScale());
+		if(!source->addParticle(p)) return;
+	}
+}
+
+/**
+ * @brief Spawn the particles for this frame
+ * @param delta Time since the last update
+ * @note Called by the ParticleSource when it is updated
+ */
+void ParticleEmitter::update(float delta){
+	if(!enabled || source == NULL){
+		pendingBurst = 0;
+		return;
+	}
+
+	// Continuous rate
+	float throttle = getThrottle();
+	accumulator += rate * delta * throttle;
+	int n = (int)accumulator;
+	accumulator -= n;
+
+	// Periodic bursts
+	if(burstCount > 0 && burstInterval > 0.0f){
+		burstTimer += delta;
+		while(burstTimer >= burstInterval){
+			burstTimer -= burstInterval;
+			n += (int)(burstCount * throttle);
+		}
+	}
+
+	// Requested bursts
+	n += pendingBurst;
+	pendingBurst = 0;
+	spawn(n);
+}
+
+/**
+ * @brief Forget the source, called when it is destroyed
+ */
+void ParticleEmitter::detach(){
+	source = NULL;
+}
+
+/**
+ * @brief Destructor for a Particle Emitter
+ */
+ParticleEmitter::~ParticleEmitter() {
+	if(source) source->removeEmitter(this);
+}
+
+}
@@ -0,0 +1,81 @@
+/**
+ * @file ParticleEmitter.h
+ * @brief Spawns particles on a ParticleSource
+ */
+
+#ifndef PARTICLEEMITTER_H_
+#define PARTICLEEMITTER_H_
+
+// Includes OpenGL
+#include <glm/glm.hpp>
+using namespace glm;
+
+// Own includes
+#include "Particle.h"
+#include "ParticleSource.h"
+
+// Defines
+#define AMG_EMITTER_THROTTLE 0.75f		/**< Budget usage where the lowest priority emitters stop spawning */
+
+namespace AMG {
+
+/**
+ * @enum AMG_EmitterShape
+ * @brief Shape of the volume where the particles are spawned
+ */
+enum AMG_EmitterShape {
+	AMG_EMITTER_POINT = 0,		/**< All the particles start at the emitter position */
+	AMG_EMITTER_SPHERE,			/**< Inside a sphere, size.x is the radius */
+	AMG_EMITTER_BOX,			/**< Inside a box, size holds the half extents */
+	AMG_EMITTER_CONE,			/**< At the emitter position, with the velocity inside a cone of size.x radians */
+};
+
+/**
+ * @class ParticleEmitter
+ * @brief Spawns particles from a template, at a given rate or in bursts
+ * @note Particles come from the source's preallocated pool and the global particle budget.
+ * When the budget fills up, low priority emitters stop first, and far emitters spawn less
+ */
+class ParticleEmitter {
+private:
+	ParticleSource *source;		/**< Source which holds the particles */
+	Particle particle;			/**< Initial state of every particle, relative to the emitter */
+	vec3 position;				/**< Emitter position */
+	int shape;					/**< Spawn shape, see AMG_EmitterShape */
+	vec3 size;					/**< Spawn shape size */
+	float spread;				/**< Random variation added to each velocity component */
+	float rate;					/**< Particles spawned per second */
+	int burstCount;				/**< Particles spawned on each periodic burst */
+	float burstInterval;		/**< Time between periodic bursts, 0 to disable them */
+	float burstTimer;			/**< Time since the last periodic burst */
+	int pendingBurst;			/**< Particles requested with burst() */
+	float accumulator;			/**< Fraction of particle left from the previous updates */
+	float priority;				/**< Priority, from 0 (lowest) to 1 (highest) */
+	float nearDistance;			/**< Camera distance where throttling starts */
+	float farDistance;			/**< Camera distance where nothing is spawned */
+	bool enabled;				/**< Is this emitter spawning particles? */
+	float random();
+	void spawn(int n);
+public:
+	vec3 &getPosition(){ return position; }
+	Particle &getParticle(){ return particle; }
+	float &getSpread(){ return spread; }
+	float &getRate(){ return rate; }
+	float &getPriority(){ return priority; }
+	bool &isEnabled(){ return enabled; }
+	ParticleSource *getSource(){ return source; }
+
+	ParticleEmitter(ParticleSource *source, Particle particle, float rate);
+	void setShape(int shape, vec3 size);
+	void setBurst(int count, float interval);
+	void setDistances(float nearDistance, float farDistance);
+	void burst(int count);
+	float getThrottle();
+	void update(float delta);
+	void detach();
+	virtual ~ParticleEmitter();
+};
+
+}
+
+#endif
@@ -4,18 +4,29 @@
  */
 
 // Includes C/C++
-#include <algorithm>
+#include <float.h>
+#include <string.h>
 
 // Own includes
 #include "ParticleSource.h"
 #include "Renderer.h"
 #include "Debug.h"
+#include "Simd.h"
+#include "StreamBuffer.h"
+#include "ParticleEmitter.h"
 
 // Defines
-#define AMG_PVBO_STRIDE 21 * sizeof(float)		/**< Stride for the particle source VBO */
+#define AMG_PVBO_FLOATS 6							/**< Floats per particle in the VBO: position, rotation, scale and frame */
+#define AMG_PVBO_STRIDE (AMG_PVBO_FLOATS * sizeof(float))	/**< Stride for the particle source VBO */
+#define AMG_PVBO_ATTRIBS 4							/**< Vertex attributes used by the particle VAO */
+#define AMG_PARTICLE_ARRAYS 12					/**< Number of float arrays per particle source */
 
 namespace AMG {
 
+// Static variables
+int ParticleSource::budget = AMG_PARTICLE_BUDGET;
+int ParticleSource::totalParticles = 0;
+
 /**
  * @brief Constructor for a Particle Source
  * @param texPath Texture atlas path
@@ -25,46 +36,195 @@ namespace AMG {
  */
 ParticleSource::ParticleSource(const char *texPath, int hframes, int vframes, int maxparticles) {
 
-	// Setup instanced rendering stuff
+	// Setup instanced rendering stuff, the instance data goes to the streaming buffer
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
-	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, maxparticles * AMG_PVBO_STRIDE, NULL, GL_STREAM_DRAW);
-	addInstancedAttribute(2, 4, 0);			// MVP columns
-	addInstancedAttribute(3, 4, 4);
-	addInstancedAttribute(4, 4, 8);
-	addInstancedAttribute(5, 4, 12);
-	addInstancedAttribute(6, 4, 16);		// Texture frame position
-	addInstancedAttribute(7, 1, 20);		// Texture blend factor
-	vboData = (float*) malloc (maxparticles * AMG_PVBO_STRIDE);
-
-	particles = std::vector<Particle>();
-	particles.reserve(maxparticles);
+	glVertexAttribDivisor(2, 1);			// Position and rotation
+	glVertexAttribDivisor(3, 1);			// Scale and texture frame
+	glBindVertexArray(0);
+
+	// Allocate the particle arrays, padded so they can be processed 4 by 4
+	int stride = (maxparticles + 3) & ~3;
+	this->nparticles = 0;
+	this->maxparticles = maxparticles;
+	data = (float*) calloc (AMG_PARTICLE_ARRAYS * stride, sizeof(float));
+	posX = data;
+	posY = data + stride;
+	posZ = data + stride * 2;
+	velX = data + stride * 3;
+	velY = data + stride * 4;
+	velZ = data + stride * 5;
+	mass = data + stride * 6;
+	elapsed = data + stride * 7;
+	lifeLength = data + stride * 8;
+	rotation = data + stride * 9;
+	scale = data + stride * 10;
+	depth = data + stride * 11;
+	keys = (unsigned short*) malloc (stride * sizeof(unsigned short));
+	order = (unsigned int*) malloc (stride * sizeof(unsigned int));
+	orderTmp = (unsigned int*) malloc (stride * sizeof(unsigned int));
 
 	atlas = NULL;
 	atlas = new Texture(texPath, hframes, vframes, true);
 }
 
 /**
- * @brief Add an instanced attribute to the bind VAO
+ * @brief Point an instanced attribute of the bound VAO to the bound buffer
+ * @param attribute Attribute index
+ * @param dataSize Number of floats in the attribute
+ * @param base Offset of the instance data in the buffer, in bytes
+ * @param offset Offset of the attribute in each instance, in floats
  */
-void ParticleSource::addInstancedAttribute(int attribute, int dataSize, int offset){
-	glVertexAttribPointer(attribute, dataSize, GL_FLOAT, GL_FALSE, AMG_PVBO_STRIDE, (void*)(offset * sizeof(float)));
-	glVertexAttribDivisor(attribute, 1);
+void ParticleSource::addInstancedAttribute(int attribute, int dataSize, GLintptr base, int offset){
+	glVertexAttribPointer(attribute, dataSize, GL_FLOAT, GL_FALSE, AMG_PVBO_STRIDE, (void*)(base + offset * sizeof(float)));
 }
 
 /**
- * @brief Update all the particles in this source
+ * @brief Add a new particle to this source
+ * @param p Initial state of the particle
+ * @return Whether the particle was added, false if the source or the global budget are full
  */
-void ParticleSource::update(){
-	for(unsigned int i=0;i<particles.size();i++){
-		Particle &p = particles[i];
-		if(p.update()){
-			particles.erase(particles.begin() + i);
+bool ParticleSource::addParticle(Particle p){
+	if(nparticles >= maxparticles || totalParticles >= budget) return false;
+	int i = nparticles++;
+	totalParticles ++;
+	posX[i] = p.getPosition().x;
+	posY[i] = p.getPosition().y;
+	posZ[i] = p.getPosition().z;
+	velX[i] = p.getVelocity().x;
+	velY[i] = p.getVelocity().y;
+	velZ[i] = p.getVelocity().z;
+	mass[i] = p.getMass();
+	elapsed[i] = 0.0f;
+	lifeLength[i] = p.getLifeLength();
+	rotation[i] = p.getRotation();
+	scale[i] = p.getScale();
+	order[i] = i;
+	return true;
+}
+
+/**
+ * @brief Apply gravity and velocity to all the particles, 4 at a time
+ * @param delta Time step
+ */
+void ParticleSource::integrate(float delta){
+	AMG_Float4 d = simdSet(delta);
+	AMG_Float4 g = simdSet(-delta);
+	for(int i=0;i<nparticles;i+=4){
+		AMG_Float4 vy = simdAdd(simdLoad(velY + i), simdMul(simdLoad(mass + i), g));
+		simdStore(velY + i, vy);
+		simdStore(posX + i, simdAdd(simdLoad(posX + i), simdMul(simdLoad(velX + i), d)));
+		simdStore(posY + i, simdAdd(simdLoad(posY + i), simdMul(vy, d)));
+		simdStore(posZ + i, simdAdd(simdLoad(posZ + i), simdMul(simdLoad(velZ + i), d)));
+		simdStore(elapsed + i, simdAdd(simdLoad(elapsed + i), d));
+	}
+}
+
+/**
+ * @brief Remove the dead particles, moving the last particle into each hole
+ */
+void ParticleSource::removeDead(){
+	int stride = (maxparticles + 3) & ~3;
+	int i = 0;
+	while(i < nparticles){
+		if(elapsed[i] > lifeLength[i]){
+			int last = --nparticles;
+			totalParticles --;
+			for(int k=0;k<AMG_PARTICLE_ARRAYS;k++){
+				data[k*stride + i] = data[k*stride + last];
+			}
+		}else{
+			i ++;
+		}
+	}
+}
+
+/**
+ * @brief Sort the particles back to front, with a radix sort on their quantized view depth
+ * @note Only the order buffer is sorted, the particle arrays are left untouched
+ */
+void ParticleSource::sort(){
+
+	// Calculate the view depth of each particle
+	mat4 &view = Renderer::getView();
+	AMG_Float4 vx = simdSet(-view[0][2]);
+	AMG_Float4 vy = simdSet(-view[1][2]);
+	AMG_Float4 vz = simdSet(-view[2][2]);
+	AMG_Float4 vw = simdSet(-view[3][2]);
+	for(int i=0;i<nparticles;i+=4){
+		AMG_Float4 z = simdAdd(simdMul(simdLoad(posX + i), vx), simdMul(simdLoad(posY + i), vy));
+		z = simdAdd(z, simdAdd(simdMul(simdLoad(posZ + i), vz), vw));
+		simdStore(depth + i, z);
+	}
+
+	// Quantize it to 16 bits, farthest particles get the lowest keys
+	float dmin = FLT_MAX, dmax = -FLT_MAX;
+	for(int i=0;i<nparticles;i++){
+		if(depth[i] < dmin) dmin = depth[i];
+		if(depth[i] > dmax) dmax = depth[i];
+	}
+	float s = (dmax > dmin) ? 65535.0f / (dmax - dmin) : 0.0f;
+	for(int i=0;i<nparticles;i++){
+		keys[i] = 65535 - (unsigned short)((depth[i] - dmin) * s);
+		order[i] = i;
+	}
+
+	// Two 8 bit passes, the result ends up in the order buffer again
+	unsigned int *src = order;
+	unsigned int *dst = orderTmp;
+	for(int shift=0;shift<16;shift+=8){
+		int offsets[256];
+		memset(offsets, 0, sizeof(offsets));
+		for(int i=0;i<nparticles;i++){
+			offsets[(keys[src[i]] >> shift) & 0xFF] ++;
+		}
+		int sum = 0;
+		for(int b=0;b<256;b++){
+			int c = offsets[b];
+			offsets[b] = sum;
+			sum += c;
+		}
+		for(int i=0;i<nparticles;i++){
+			dst[offsets[(keys[src[i]] >> shift) & 0xFF]++] = src[i];
 		}
+		unsigned int *t = src;
+		src = dst;
+		dst = t;
 	}
-	std::sort(particles.begin(), particles.end());
+}
+
+/**
+ * @brief Attach an emitter to this source, called by the emitter itself
+ * @param emitter The emitter to attach
+ */
+void ParticleSource::addEmitter(ParticleEmitter *emitter){
+	emitters.push_back(emitter);
+}
+
+/**
+ * @brief Detach an emitter from this source, called by the emitter itself
+ * @param emitter The emitter to detach
+ */
+void ParticleSource::removeEmitter(ParticleEmitter *emitter){
+	for(unsigned int i=0;i<emitters.size();i++){
+		if(emitters[i] == emitter){
+			emitters.erase(emitters.begin() + i);
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Spawn, update and sort all the particles in this source
+ */
+void ParticleSource::update(){
+	float delta = Renderer::getDelta();
+	for(unsigned int i=0;i<emitters.size();i++){
+		emitters[i]->update(delta);
+	}
+	integrate(delta);
+	removeDead();
+	sort();
 }
 
 /**
@@ -79,7 +239,7 @@ void ParticleSource::draw(GLuint alphaFunc){
 
 	// Bind buffers
 	glBindVertexArray(vao);
-	for(int i=0;i<8;i++){
+	for(int i=0;i<AMG_PVBO_ATTRIBS;i++){
 		glEnableVertexAttribArray(i);
 	}
 	Renderer::bindQuad(false);
@@ -87,31 +247,42 @@ void ParticleSource::draw(GLuint alphaFunc){
 	// Bind texture
 	atlas->bind(0);
 
-	// Fill particle's buffer
-	int offset = 0;
-	for(unsigned int i=0;i<particles.size();i++){
-		Particle &p = particles[i];
-		atlas->getCurrentFrame() = p.getLife() * atlas->getNFrames();
-		atlas->animate();
-		Renderer::setTransformationBillboard(p.getPosition(), p.getRotation(), p.getScale());
-		Renderer::updateMVP();
-		Renderer::storeMVP(vboData, offset * 21);
-		atlas->storeFrameData(vboData, offset * 21 + 16);
-		offset ++;
-	}
+	// Per frame uniforms, the billboards are expanded in the vertex shader
+	Shader *shader = Renderer::getCurrentShader();
+	vec2 frames = vec2(atlas->getHorizontalFrames(), atlas->getVerticalFrames());
+	shader->setUniform(AMG_V, Renderer::getView());
+	shader->setUniform(AMG_P, Renderer::getProjection());
+	shader->setUniform(AMG_TexFrames, frames);
+	Renderer::setModel(mat4(1.0f));
+	Renderer::updateMVP();
 
-	// Update particle's buffer VBO
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, particles.size() * AMG_PVBO_STRIDE, NULL, GL_STREAM_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, particles.size() * AMG_PVBO_STRIDE, vboData);
+	// Write the instance data straight into the streaming buffer, back to front
+	GLintptr base = 0;
+	float *d = (float*) StreamBuffer::map(nparticles * AMG_PVBO_STRIDE, &base);
+	if(d){
+		float nframes = atlas->getNFrames();
+		for(int i=0;i<nparticles;i++){
+			int p = order[i];
+			d[0] = posX[p];
+			d[1] = posY[p];
+			d[2] = posZ[p];
+			d[3] = rotation[p];
+			d[4] = scale[p];
+			d[5] = (elapsed[p] / lifeLength[p]) * nframes;
+			d += AMG_PVBO_FLOATS;
+		}
+		StreamBuffer::unmap();
+		addInstancedAttribute(2, 4, base, 0);
+		addInstancedAttribute(3, 2, base, 4);
 
-	// Draw all particles
-	glDrawArraysInstanced(GL_TRIANGLES, 0, 6, particles.size());
+		// Draw all particles
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, nparticles);
+	}
 
 	// Restore blend function
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glDepthMask(true);
-	for(int i=0;i<8;i++){
+	for(int i=0;i<AMG_PVBO_ATTRIBS;i++){
 		glDisableVertexAttribArray(i);
 	}
 }
@@ -120,10 +291,16 @@ void ParticleSource::draw(GLuint alphaFunc){
  * @brief Destructor for a Particle source
  */
 ParticleSource::~ParticleSource() {
+	for(unsigned int i=0;i<emitters.size();i++){
+		emitters[i]->detach();
+	}
+	totalParticles -= nparticles;
 	AMG_DELETE(atlas);
-	glDeleteBuffers(1, &vbo);
 	glDeleteVertexArrays(1, &vao);
-	if(vboData) free(vboData);
+	if(data) free(data);
+	if(keys) free(keys);
+	if(order) free(order);
+	if(orderTmp) free(orderTmp);
 }
 
 }
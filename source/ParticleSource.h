@@ -7,7 +7,7 @@
 #define PARTICLESOURCE_H_
 
 // Includes C/C++
-#include <list>
+#include <vector>
 
 // Includes OpenGL
 #include <GL/glew.h>
@@ -18,24 +18,55 @@
 #include "Particle.h"
 #include "Texture.h"
 
+// Defines
+#define AMG_PARTICLE_BUDGET 100000		/**< Default maximum number of particles alive in all sources */
+
 namespace AMG {
 
+class ParticleEmitter;
+
 /**
  * @class ParticleSource
  * @brief Holds a number of particles and processed them, as well as rendering them
+ * @note Particles are stored as a structure of arrays, each array padded to a multiple of 4
  */
 class ParticleSource : private Entity {
 private:
+	static int budget;					/**< Maximum number of particles alive in all sources */
+	static int totalParticles;			/**< Number of particles alive in all sources */
 	Texture *atlas;						/**< Texture atlas for this source */
-	GLuint vbo;							/**< VBO for instanced rendering */
 	GLuint vao;							/**< VAO for this source */
-	float *vboData;						/**< VBO data to be updated */
-	std::vector<Particle> particles;	/**< Vector holding all the particles for this source */
-	void addInstancedAttribute(int attribute, int dataSize, int offset);
+	int nparticles;						/**< Number of alive particles */
+	int maxparticles;					/**< Maximum number of particles */
+	float *data;						/**< Memory block holding all the particle arrays */
+	float *posX, *posY, *posZ;			/**< Particle positions */
+	float *velX, *velY, *velZ;			/**< Particle velocities */
+	float *mass;						/**< How much each particle is affected by gravity */
+	float *elapsed;						/**< Time since each particle was created */
+	float *lifeLength;					/**< Time of life of each particle */
+	float *rotation;					/**< Rotation of each particle, in radians */
+	float *scale;						/**< Scale of each particle */
+	float *depth;						/**< View depth of each particle, used for sorting */
+	unsigned short *keys;				/**< Quantized depth of each particle */
+	unsigned int *order;				/**< Particle indices, sorted back to front */
+	unsigned int *orderTmp;				/**< Temporary buffer for the radix sort */
+	std::vector<ParticleEmitter*> emitters;	/**< Emitters spawning particles in this source */
+	void addInstancedAttribute(int attribute, int dataSize, GLintptr base, int offset);
+	void integrate(float delta);
+	void removeDead();
+	void sort();
 public:
-	std::vector<Particle> &getParticles(){ return particles; }
+	int getNParticles(){ return nparticles; }
+	int getMaxParticles(){ return maxparticles; }
+	static int getBudget(){ return budget; }
+	static void setBudget(int b){ budget = b; }
+	static int getTotalParticles(){ return totalParticles; }
+	static float getBudgetUsage(){ return (budget > 0) ? (float)totalParticles / (float)budget : 1.0f; }
 
 	ParticleSource(const char *texPath, int hframes, int vframes, int maxparticles);
+	bool addParticle(Particle p);
+	void addEmitter(ParticleEmitter *emitter);
+	void removeEmitter(ParticleEmitter *emitter);
 	void update();
 	void draw(GLuint alphaFunc);
 	virtual ~ParticleSource();
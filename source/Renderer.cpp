@@ -15,6 +15,14 @@
 #include "Renderer.h"
 #include "Debug.h"
 #include "Framebuffer.h"
+#include "JobSystem.h"
+#include "AssetLoader.h"
+#include "TextureStreamer.h"
+#include "UploadPool.h"
+#include "FileSystem.h"
+#include "Transform.h"
+#include "StreamBuffer.h"
+#include "GPUParticleSource.h"
 
 namespace AMG {
 
@@ -25,6 +33,7 @@ AMG_FunctionCallback Renderer::renderCb;
 AMG_FunctionCallback Renderer::render2dCb;
 AMG_FunctionCallback Renderer::unloadCb;
 AMG_FunctionCallback Renderer::postCb;
+AMG_FunctionCallback Renderer::physicsCb;
 mat4 *Renderer::projection;
 mat4 Renderer::perspective, Renderer::ortho;
 mat4 Renderer::invPerspective;
@@ -92,10 +101,14 @@ void Renderer::initialize(int w, int h, const char *title, bool fullscreen, int
 	// Initialise variables
 	width = w;
 	height = h;
+
+	// Mount the data pack, if there is one
+	FileSystem::mount();
 	renderCb = NULL;
 	render2dCb = NULL;
 	unloadCb = NULL;
 	postCb = NULL;
+	physicsCb = NULL;
 	FPS = 60.0f;
 	fogColor = vec4(0.2f, 0.2f, 0.2f, 1.0f);
 	fogDensity = 0.0f;
@@ -152,9 +165,19 @@ void Renderer::initialize(int w, int h, const char *title, bool fullscreen, int
 	glEnable(GL_MULTISAMPLE);
 	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
+	// Let the driver use as many shader compiler threads as it wants
+	if(GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
 	// Input configuration
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 
+	// Start the worker threads and the streaming buffer
+	JobSystem::initialize();
+	StreamBuffer::initialize();
+	UploadPool::initialize();
+	AssetLoader::initialize();
+
 	// Calculate matrices
 	model = mat4(1.0f);
 	mvp = mat4(1.0f);
@@ -176,10 +199,12 @@ void Renderer::initialize(int w, int h, const char *title, bool fullscreen, int
 
 	// Load shaders
 	hdrGammaShader = new Shader("Effects/AMG_HDRGamma");
+	GPUParticleSource::initialize();
 
 	// Create the 3D framebuffer
 	defaultFB = new Framebuffer(width, height, 1, samples);
 	defaultFB->createColorTexture(0, GL_RGB16F, GL_RGB, GL_FLOAT);
+	defaultFB->createDepthTexture(GL_DEPTH_COMPONENT24);
 	fbSprite = new Sprite(defaultFB->getColorTexture(0));
 	fbSprite->getScaleY() = -1.0f;
 	fbSprite->getPosition() = vec3(width / 2.0f, height / 2.0f, 0.0f);
@@ -193,9 +218,11 @@ void Renderer::initialize(int w, int h, const char *title, bool fullscreen, int
 
 /**
  * @brief Creates a physics world for this Renderer
+ * @param threaded Simulate on a separate thread, while the next frame is rendered?
+ * @param multithreaded Use Bullet's multithreaded solver, if available?
  */
-void Renderer::createWorld(){
-	world = new World();
+void Renderer::createWorld(bool threaded, bool multithreaded){
+	world = new World(threaded, multithreaded);
 }
 
 
@@ -261,9 +288,15 @@ void Renderer::update(){
 			running = false;
 		}
 
+		// Upload the assets loaded in the background
+		UploadPool::update();
+		TextureStreamer::update();
+		AssetLoader::update();
+
 		// Render the 3D scene onto the framebuffer
 		glClearColor(fogColor.r, fogColor.g, fogColor.b, fogColor.a);
 		defaultFB->start();
+		Transform::updateAll();
 		if(renderCb) renderCb();
 
 		defaultFB->end();
@@ -290,10 +323,11 @@ void Renderer::update(){
 		set3dMode(true);
 
 		glfwSwapBuffers(window);
+		StreamBuffer::endFrame();
 		frames ++;
 
-		// Update the physics world
-		if(world) world->update(getDelta());
+		// Update the physics world, picking and queries run between two steps
+		if(world) world->update(getDelta(), physicsCb);
 	}
 }
 
@@ -310,6 +344,7 @@ int Renderer::exitProcess(){
 		if(window) glfwDestroyWindow(window);
 		if(world) delete world;
 		if(hdrGammaShader) delete hdrGammaShader;
+		GPUParticleSource::finish();
 		if(fbSprite) delete fbSprite;
 		if(defaultFB) delete defaultFB;
 
@@ -317,11 +352,16 @@ int Renderer::exitProcess(){
 		glDeleteBuffers(1, &quadVertices);
 		glDeleteBuffers(1, &quadTexcoords);
 		glDeleteVertexArrays(1, &quadID);
+		StreamBuffer::finish();
+		AssetLoader::finish();
+		UploadPool::finish();
 
 		// Unload data
 		if(unloadCb) unloadCb();
+		JobSystem::finish();
+		FileSystem::unmount();
 		if(Entity::nEntities > 0){
-			fprintf(stderr, "Warning: %d resources were not unloaded\n", Entity::nEntities);
+			fprintf(stderr, "Warning: %d resources were not unloaded\n", Entity::nEntities.load());
 			fflush(stderr);
 		}
 
@@ -614,4 +654,16 @@ bool Renderer::isBBoxVisible(vec3 box){
 	return false;
 }
 
+/**
+ * @brief Estimate the size of a bounding box on screen, after calling updateMVP
+ * @param box Bounding box, in object coordinates
+ * @return Size on screen, in pixels
+ */
+float Renderer::getScreenSize(vec3 box){
+	vec4 center = mv * vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	float radius = glm::length(vec3(mv * vec4(box, 0.0f)));
+	float distance = glm::max(-center.z, 0.1f);
+	return radius * (*projection)[1][1] / distance * height;		// Diameter in NDC, times half the screen height
+}
+
 }
@@ -45,6 +45,7 @@ private:
 	static AMG_FunctionCallback render2dCb;		/**< 2D rendering callback */
 	static AMG_FunctionCallback unloadCb;		/**< Unload callback */
 	static AMG_FunctionCallback postCb;			/**< Post-processing callback */
+	static AMG_FunctionCallback physicsCb;		/**< Physics callback, run while the simulation is idle */
 	static mat4 *projection;					/**< Current projection matrix */
 	static mat4 perspective, ortho;				/**< Precalculated perspective and ortho matrices */
 	static mat4 view;							/**< View matrix */
@@ -88,6 +89,7 @@ public:
 	static mat4 &getPerspective(){ return perspective; }
 	static mat4 &getOrtho(){ return ortho; }
 	static mat4 &getInversePerspective(){ return invPerspective; }
+	static mat4 &getProjection(){ return *projection; }
 	static Shader *getCurrentShader(){ return currentShader; }
 	static World *getWorld(){ return world; }
 	static float getFOV(){ return fov; }
@@ -101,9 +103,12 @@ public:
 	static void setRender2dCallback(AMG_FunctionCallback cb){ render2dCb = cb; }
 	static void setUnloadCallback(AMG_FunctionCallback cb){ unloadCb = cb; }
 	static void setPostCallback(AMG_FunctionCallback cb){ postCb = cb; }
+	static void setPhysicsCallback(AMG_FunctionCallback cb){ physicsCb = cb; }
 	static Camera *getCamera(){ return camera; }
 	static void setRenderDistance(float distance){ renderDistance = distance; }
 	static mat4 &getView(){ return view; }
+	static mat4 &getModel(){ return model; }
+	static mat4 &getZUpConversion(){ return zupConversion; }
 	static float &getHDRExposure(){ return hdrExposure; }
 	static float &getGammaCorrection(){ return gammaCorrection; }
 	static void setsRGBTextures(int t){ srgbTextures = t; }
@@ -117,6 +122,7 @@ public:
 
 	static void initialize(int w, int h, const char *title, bool fullscreen, int samples=4);
 	static void update();
+	static void setModel(const mat4 &m){ model = m; }
 	static void setTransformationZ(vec3 pos, quat rot, vec3 scale);
 	static void setTransformation(vec3 pos, quat rot, vec3 scale);
 	static void setTransformation(vec3 pos);
@@ -130,11 +136,12 @@ public:
 	static void updateCamera(Camera *cam);
 	static void getMousePosition(double *x, double *y);
 	static bool getKey(int code);
-	static void createWorld();
+	static void createWorld(bool threaded=true, bool multithreaded=false);
 	static void resize(int w, int h);
 	static void bindQuad(bool vao);
 	static void setFOV(float fieldOfView);
 	static bool isBBoxVisible(vec3 box);
+	static float getScreenSize(vec3 box);
 };
 
 }
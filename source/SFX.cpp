@@ -11,80 +11,94 @@
 // Own includes
 #include "SFX.h"
 #include "Debug.h"
+#include "FileSystem.h"
 
 namespace AMG {
 
+/**
+ * @brief Constructor for an empty sound effect, which plays nothing until its data is created
+ */
+SFX::SFX() {
+	id = 0;
+}
+
 /**
  * @brief Constructor for a sound effect
  * @param path Path to the sound effect file
  * @note Only PCM sound data is supported
  */
-SFX::SFX(const char *path) {
+SFX::SFX(const char *path) : SFX() {
+	AMG_SoundData data;
+	int error = SFX::readSound(path, &data);
+	if(error != NO_ERROR) Debug::showError(error, (void*)path);
+	create(&data);
+	free(data.data);
+}
 
-	// Open the WAV file
-	FILE *f = fopen(Entity::getFullPath(path, AMG_AUDIO), "rb");
-	if(f == NULL) Debug::showError(FILE_NOT_FOUND, (void*)path);
+/**
+ * @brief Read a *.wav file, without touching OpenAL
+ * @param path Path to the sound effect file
+ * @param sound Sound data (output), its data must be released with free
+ * @return NO_ERROR, or the error found, see ErrorCodes
+ * @note It can be called from any thread
+ */
+int SFX::readSound(const char *path, AMG_SoundData *sound){
 
-	// Check the RIFF signature
-	char sign[4];
-	fread(sign, 4, sizeof(char), f);
-	if(strncmp(sign, "RIFF", 4) != 0){
-		Debug::showError(WRONG_SIGNATURE, (void*)path);
-	}
+	// Read the WAV file
+	sound->data = NULL;
+	int size = 0;
+	char *file = FileSystem::readFile(path, AMG_AUDIO, &size);
+	if(file == NULL) return FILE_NOT_FOUND;
 
-	// Check the WAVE signature
-	fseek(f, 4, SEEK_CUR);
-	fread(sign, 4, sizeof(char), f);
-	if(strncmp(sign, "WAVE", 4) != 0){
-		Debug::showError(WRONG_SIGNATURE, (void*)path);
+	// Check the RIFF and WAVE signatures
+	if(size < 44 || strncmp(file, "RIFF", 4) != 0 || strncmp(file + 8, "WAVE", 4) != 0){
+		free(file);
+		return WRONG_SIGNATURE;
 	}
 
 	// Read the format header
-	fseek(f, 4, SEEK_CUR);
-	int a;
-	fread(&a, sizeof(int), 1, f);
-	if(a != 16){
-		Debug::showError(UNSUPPORTED_FORMAT, (void*)path);			// Must be 16
-	}
-	a = 0;
-	fread(&a, sizeof(unsigned short), 1, f);
-	if(a != 1){
-		Debug::showError(UNSUPPORTED_FORMAT, (void*)path);			// Must be 1
+	unsigned int fmtSize = *(unsigned int*)(file + 16);
+	unsigned short fmtType = *(unsigned short*)(file + 20);
+	if(fmtSize != 16 || fmtType != 1){
+		free(file);
+		return UNSUPPORTED_FORMAT;			// Must be 16 and 1
 	}
 
 	// Read the data header
-	unsigned short nchannels;
-	unsigned int samplerate;
-	unsigned short bitspersample;
-	fread(&nchannels, sizeof(unsigned short), 1, f);
-	fread(&samplerate, sizeof(unsigned int), 1, f);
-	fseek(f, 6, SEEK_CUR);
-	fread(&bitspersample, sizeof(unsigned short), 1, f);
-	fseek(f, 4, SEEK_CUR);		// Ignore "data" text
+	unsigned short nchannels = *(unsigned short*)(file + 22);
+	unsigned int samplerate = *(unsigned int*)(file + 24);
+	unsigned short bitspersample = *(unsigned short*)(file + 34);
+	unsigned int data_size = *(unsigned int*)(file + 40);		// After the "data" text
+	if(data_size > (unsigned int)size - 44) data_size = size - 44;
 
 	// Read data
-	unsigned int data_size;
-	fread(&data_size, sizeof(unsigned int), 1, f);
-	void *data = malloc (data_size);
-	fread(data, data_size, 1, f);
+	sound->data = malloc (data_size);
+	memcpy(sound->data, file + 44, data_size);
+	sound->size = data_size;
+	sound->samplerate = samplerate;
+	free(file);
 
-	// Close the file
-	fclose(f);
+	// Choose the OpenAL format
+	sound->format = AL_FORMAT_MONO8;
+	if(nchannels == 2) sound->format += 2;
+	if(bitspersample == 16) sound->format ++;
+	return NO_ERROR;
+}
 
-	// Create OpenAL buffers
-	int format = AL_FORMAT_MONO8;
-	if(nchannels == 2) format += 2;
-	if(bitspersample == 16) format ++;
+/**
+ * @brief Create the OpenAL buffer from data already read
+ * @param sound Sound data, see SFX::readSound
+ */
+void SFX::create(AMG_SoundData *sound){
 	alGenBuffers(1, &id);
-	alBufferData(id, format, data, data_size, samplerate);
-	free(data);
+	alBufferData(id, sound->format, sound->data, sound->size, sound->samplerate);
 }
 
 /**
  * @brief Destructor for a sound effect
  */
 SFX::~SFX() {
-	alDeleteBuffers(1, &id);
+	if(id) alDeleteBuffers(1, &id);
 }
 
 }
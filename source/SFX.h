@@ -15,6 +15,17 @@
 
 namespace AMG {
 
+/**
+ * @struct AMG_SoundData
+ * @brief PCM sound read from a *.wav file, ready to be uploaded
+ */
+typedef struct{
+	ALenum format;				/**< OpenAL format */
+	unsigned int samplerate;	/**< Samples per second */
+	void *data;					/**< PCM data */
+	unsigned int size;			/**< Size of the data, in bytes */
+}AMG_SoundData;
+
 /**
  * @class SFX
  * @brief Sound effect loading and play back in uncompressed .wav format
@@ -24,7 +35,10 @@ private:
 	ALuint id;		/**< ID for the sound attachment */
 public:
 	ALuint getID(){ return id; }
+	SFX();
 	SFX(const char *path);
+	void create(AMG_SoundData *sound);
+	static int readSound(const char *path, AMG_SoundData *sound);
 	virtual ~SFX();
 };
 
@@ -4,8 +4,10 @@
  */
 
 // Includes C/C++
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include <iostream>
-#include <fstream>
 #include <sstream>
 #include <vector>
 
@@ -13,6 +15,7 @@
 #include "Shader.h"
 #include "Debug.h"
 #include "Renderer.h"
+#include "FileSystem.h"
 
 namespace AMG {
 
@@ -27,31 +30,88 @@ const char *Shader::uniformsTable[] = {
 	"AMG_CharEdge", "AMG_CharBorderWidth", "AMG_CharBorderEdge", "AMG_CharShadowOffset",
 	"AMG_CharOutlineColor", "AMG_SSAOSamples", "AMG_SSAOProjection", "AMG_DView", "AMG_HDRExposure",
 	"AMG_GammaValue", "AMG_SpecularReflectivity", "AMG_SSAOKernelSize", "AMG_SSAOKernelRadius", "AMG_WorldAmbient",
-	"AMG_RefractionIndex",
+	"AMG_RefractionIndex", "AMG_V", "AMG_P", "AMG_TexFrames", "AMG_TexLayer",
 };
+static const char *stageExtensions[] = {"vs", "fs", "gs"};
+static const GLenum stageTypes[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER};
+
+// Static variables
+bool Shader::cacheEnabled = true;
+int Shader::nprograms = 0;
+int Shader::ncached = 0;
+double Shader::loadTime = 0.0;
+unsigned long long Shader::driverHash = 0;
+int Shader::nshared = 0;
+std::tr1::unordered_map<std::string, std::string> Shader::fileCache;
+std::tr1::unordered_map<unsigned long long, AMG_ShaderProgram> Shader::programs;
+
+/**
+ * @brief Read a shader file, keeping its text in memory for the next Shaders
+ * @param path Path to the file
+ * @param type AMG_SHADER, or AMG_SHADERLIB for included files
+ * @param text Output, the text of the file
+ * @return Whether the file could be read
+ */
+bool Shader::readShaderFile(const char *path, int type, std::string &text){
+	char key[512];
+	sprintf(key, "%d:%s", type, path);
+	std::tr1::unordered_map<std::string, std::string>::const_iterator got = fileCache.find(key);
+	if(got != fileCache.end()){
+		text = got->second;
+		return true;
+	}
+	int size = 0;
+	char *file = FileSystem::readFile(path, type, &size);
+	if(file == NULL) return false;
+	text = std::string(file, size);
+	free(file);
+	fileCache[key] = text;
+	return true;
+}
 
 /**
  * @brief Load a file onto a string, doing preprocessing step
  * @param path Path to the file to be loaded
+ * @param type AMG_SHADER, or AMG_SHADERLIB for included files
+ * @param defines Names to #define after the #version line, NULL for included files
+ * @param included Files already included in this stage, each one is only included once
  * @return The code onto that file on a std::string
  */
-std::string Shader::loadShaderCode(const char *path){
-	std::ifstream ShaderStream(path, std::ios::in);
+std::string Shader::loadShaderCode(const char *path, int type, const std::vector<std::string> *defines, std::vector<std::string> &included){
+	std::string file;
 	std::string ShaderCode;
-	if(ShaderStream.is_open()){
+	if(readShaderFile(path, type, file)){
+		std::istringstream ShaderStream(file);
 		std::string line;
 		std::stringstream sstr;
+		bool injected = (defines == NULL);
 		while (std::getline(ShaderStream, line)){
 			if(line.find("#include") != std::string::npos){
 				int start = line.find("<") + 1;
 				int end = line.find(">");
-				sstr << loadShaderCode(getFullPath(line.substr(start, end - start).c_str(), AMG_SHADERLIB));
+				std::string include = line.substr(start, end - start);
+				if(std::find(included.begin(), included.end(), include) == included.end()){
+					included.push_back(include);
+					sstr << loadShaderCode(include.c_str(), AMG_SHADERLIB, NULL, included);
+				}
 			}else{
 				sstr << line + "\n";
+				if(!injected && line.find("#version") != std::string::npos){
+					for(unsigned int i=0;i<defines->size();i++)
+						sstr << "#define " << (*defines)[i] << "\n";
+					injected = true;
+				}
 			}
 		}
 		ShaderCode = sstr.str();
-		ShaderStream.close();
+
+		// No #version line, the defines go first
+		if(!injected){
+			std::string header;
+			for(unsigned int i=0;i<defines->size();i++)
+				header += "#define " + (*defines)[i] + "\n";
+			ShaderCode = header + ShaderCode;
+		}
 	}else{
 		Debug::showError(5, (void*)path);
 	}
@@ -59,11 +119,12 @@ std::string Shader::loadShaderCode(const char *path){
 }
 
 /**
- * @brief Load a shader, used internally
- * @param path Shader code file path
+ * @brief Start compiling a shader, used internally
+ * @param code Preprocessed shader code
  * @param type GL_VERTEX_SHADER, GL_FRAGMENT_SHADER or GL_GEOMETRY_SHADER
+ * @note The compilation status is checked later by complete(), so the driver can compile in parallel
  */
-int Shader::loadShader(const char *path, int type){
+int Shader::loadShader(const std::string &code, int type){
 
 	// Create shader objects
 	GLuint id = glCreateShader(type);
@@ -71,28 +132,81 @@ int Shader::loadShader(const char *path, int type){
 		Debug::showError(4, NULL);
 	}
 
-	// Load shader code
-	std::string ShaderCode = loadShaderCode(getFullPath(path, AMG_SHADER));
-
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
-
 	// Compile shader
-	char const *SourcePointer = ShaderCode.c_str();
+	char const *SourcePointer = code.c_str();
 	glShaderSource(id, 1, &SourcePointer, NULL);
 	glCompileShader(id);
+	return id;
+}
+
+/**
+ * @brief Check whether a shader file exists, used internally
+ * @param path Shader code file path
+ * @return Whether the file can be opened
+ */
+bool Shader::shaderExists(const char *path){
+	return FileSystem::exists(path, AMG_SHADER);
+}
 
-	// Get compilation status
-	glGetShaderiv(id, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(id, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if(InfoLogLength > 0){
-		std::vector<char> ShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(id, InfoLogLength, NULL, &ShaderErrorMessage[0]);
-		fprintf(stderr, "[%s]\n", path);
-		Debug::showError(6, &ShaderErrorMessage[0]);
+/**
+ * @brief Get a hash which identifies the OpenGL driver, used internally
+ * @return The hash of the vendor, renderer and version strings
+ * @note Program binaries are only valid on the driver which created them
+ */
+unsigned long long Shader::getDriverHash(){
+	if(driverHash == 0){
+		GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+		driverHash = AMG_HASH_SEED;
+		for(int i=0;i<4;i++){
+			const char *s = (const char*)glGetString(names[i]);
+			if(s) driverHash = Entity::hash(s, strlen(s) + 1, driverHash);
+		}
 	}
+	return driverHash;
+}
 
-	return id;
+/**
+ * @brief Load this program from the binary cache, used internally
+ * @param name Name of the cache file
+ * @return Whether the program was loaded and linked
+ * @note A binary rejected by the driver (for example after an update) is not an error, the program is compiled again
+ */
+bool Shader::loadBinary(const char *name){
+	if(!GLEW_ARB_get_program_binary) return false;
+	FILE *f = Entity::openCacheFile(name, false);
+	if(f == NULL) return false;
+	GLenum format = 0;
+	int length = 0;
+	GLint status = GL_FALSE;
+	if(fread(&format, sizeof(GLenum), 1, f) == 1 && fread(&length, sizeof(int), 1, f) == 1 && length > 0){
+		std::vector<char> data(length);
+		if(fread(&data[0], 1, length, f) == (size_t)length){
+			glProgramBinary(programID, format, &data[0], length);
+			glGetProgramiv(programID, GL_LINK_STATUS, &status);
+		}
+	}
+	fclose(f);
+	return status == GL_TRUE;
+}
+
+/**
+ * @brief Save this program to the binary cache, used internally
+ * @param name Name of the cache file
+ */
+void Shader::saveBinary(const char *name){
+	if(!GLEW_ARB_get_program_binary) return;
+	GLint length = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0) return;
+	std::vector<char> data(length);
+	GLenum format = 0;
+	glGetProgramBinary(programID, length, NULL, &format, &data[0]);
+	FILE *f = Entity::openCacheFile(name, true);
+	if(f == NULL) return;
+	fwrite(&format, sizeof(GLenum), 1, f);
+	fwrite(&length, sizeof(int), 1, f);
+	fwrite(&data[0], 1, length, f);
+	fclose(f);
 }
 
 /**
@@ -101,120 +215,265 @@ int Shader::loadShader(const char *path, int type){
  * @note Vertex shaders must have a .vs extension, fragment shaders .fs, and geometry shaders .gs
  */
 Shader::Shader(const char *file_path) {
+	create(file_path, std::vector<std::string>(), NULL, 0);
+}
 
-	// Create shader objects
+/**
+ * @brief Constructor for a permutation of a Shader, like Shader("default", {"FORWARD"})
+ * @param file_path Shader file path (without extension)
+ * @param defines Names defined right after the #version line, "NAME VALUE" also works
+ * @note Permutations with the same code share a single program
+ */
+Shader::Shader(const char *file_path, const std::vector<std::string> &defines) {
+	create(file_path, defines, NULL, 0);
+}
+
+/**
+ * @brief Constructor for a Shader object which captures its output with transform feedback
+ * @param file_path Shader file path (without extension)
+ * @param varyings Names of the output variables to capture, interleaved in a single buffer
+ * @param nvaryings Number of output variables
+ * @note The fragment shader is optional, as these shaders usually run with rasterization disabled
+ */
+Shader::Shader(const char *file_path, const char **varyings, int nvaryings) {
+	create(file_path, std::vector<std::string>(), varyings, nvaryings);
+}
+
+/**
+ * @brief Load and start linking a shader program, used internally
+ * @param file_path Shader file path (without extension)
+ * @param defines Names to define in every stage
+ * @param varyings Transform feedback output variables, NULL for normal shaders
+ * @param nvaryings Number of output variables
+ * @note Linked programs are cached in Data/Cache, keyed by the preprocessed code and the driver identity.
+ * The link is not waited for here, complete() does it when the Shader is first used
+ */
+void Shader::create(const char *file_path, const std::vector<std::string> &defines, const char **varyings, int nvaryings){
+	double start = glfwGetTime();
+	this->name = file_path;
+	this->pending = true;
+	this->stages[0] = this->stages[1] = this->stages[2] = 0;
+
+	// Sort the defines, so the same permutation always gets the same code
+	std::vector<std::string> sorted(defines);
+	std::sort(sorted.begin(), sorted.end());
+	sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+	// Preprocess the code of each stage, the fragment shader is optional with varyings
 	char path[512];
-	sprintf(path, "%s.vs", file_path);
-	GLuint VertexShaderID = loadShader(path, GL_VERTEX_SHADER);
-	sprintf(path, "%s.fs", file_path);
-	GLuint FragmentShaderID = loadShader(path, GL_FRAGMENT_SHADER);
-
-	// Check the geometry shader
-	GLuint GeometryShaderID = 0;
-	sprintf(path, "%s.gs", file_path);
-	FILE *f = fopen(path, "rb");
-	if(f){
-		fclose(f);
-		GeometryShaderID = loadShader(path, GL_GEOMETRY_SHADER);
+	std::string code[3];
+	bool used[3];
+	for(int i=0;i<3;i++){
+		sprintf(path, "%s.%s", file_path, stageExtensions[i]);
+		used[i] = (i == 0) || (i == 1 && varyings == NULL) || shaderExists(path);
+		if(used[i]){
+			std::vector<std::string> included;
+			code[i] = loadShaderCode(path, AMG_SHADER, &sorted, included);
+		}
 	}
 
-	// Create a shader program and attach the loaded shaders
+	// Cache key, stages are hashed with their terminator so they can't run into each other
+	key = getDriverHash();
+	for(int i=0;i<3;i++)
+		key = Entity::hash(code[i].c_str(), code[i].size() + 1, key);
+	for(int i=0;i<nvaryings;i++)
+		key = Entity::hash(varyings[i], strlen(varyings[i]) + 1, key);
+
+	// An identical program already exists
+	std::tr1::unordered_map<unsigned long long, AMG_ShaderProgram>::iterator it = programs.find(key);
+	if(it != programs.end()){
+		programID = it->second.id;
+		it->second.references++;
+		nshared++;
+		loadTime += glfwGetTime() - start;
+		return;
+	}
+
+	// Create a shader program, and try to load it from the cache
 	programID = glCreateProgram();
 	if(programID == 0)
 		Debug::showError(7, NULL);
-	glAttachShader(programID, VertexShaderID);
-	glAttachShader(programID, FragmentShaderID);
-	if(GeometryShaderID) glAttachShader(programID, GeometryShaderID);
+	AMG_ShaderProgram program = {(GLuint)programID, 1};
+	programs[key] = program;
+	nprograms++;
+	char cacheName[32];
+	sprintf(cacheName, "%08x%08x.prog", (unsigned int)(key >> 32), (unsigned int)key);
+	if(cacheEnabled && loadBinary(cacheName)){
+		ncached++;
+		loadTime += glfwGetTime() - start;
+		return;
+	}
+
+	// Compile the shader objects and attach them
+	for(int i=0;i<3;i++){
+		if(used[i]){
+			stages[i] = loadShader(code[i], stageTypes[i]);
+			glAttachShader(programID, stages[i]);
+		}
+	}
 
-	// Link the shader program
+	// Set the captured outputs and link the shader program
+	if(varyings)
+		glTransformFeedbackVaryings(programID, nvaryings, varyings, GL_INTERLEAVED_ATTRIBS);
+	if(cacheEnabled && GLEW_ARB_get_program_binary)
+		glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(programID);
+	loadTime += glfwGetTime() - start;
+}
 
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
-	glGetProgramiv(programID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-
-	// Delete shader objects
-	glDetachShader(programID, VertexShaderID);
-	glDetachShader(programID, FragmentShaderID);
-	if(GeometryShaderID) glDetachShader(programID, GeometryShaderID);
-
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
-	if(GeometryShaderID) glDeleteShader(GeometryShaderID);
-
-	// Show errors
-	if(InfoLogLength > 0){
-		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
-		glGetProgramInfoLog(programID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-		fprintf(stderr, "[%s]\n", file_path);
-		Debug::showError(8, &ProgramErrorMessage[0]);
-	}
+/**
+ * @brief Wait for the program to be linked and set it up, used internally
+ * @note Shows the compilation errors, saves the program binary, and finds the uniforms
+ */
+void Shader::finishCreate(){
+	pending = false;
+	double start = glfwGetTime();
+
+	// The program was compiled by this Shader
+	if(stages[0]){
+		GLint Result = GL_FALSE;
+		int InfoLogLength;
+
+		// Show compilation errors
+		for(int i=0;i<3;i++){
+			if(stages[i] == 0) continue;
+			glGetShaderiv(stages[i], GL_INFO_LOG_LENGTH, &InfoLogLength);
+			if(InfoLogLength > 0){
+				std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+				glGetShaderInfoLog(stages[i], InfoLogLength, NULL, &ShaderErrorMessage[0]);
+				fprintf(stderr, "[%s.%s]\n", name.c_str(), stageExtensions[i]);
+				Debug::showError(6, &ShaderErrorMessage[0]);
+			}
+		}
 
-	// Everything OK, create a uniform map
-	this->uniformsMap = std::tr1::unordered_map<std::string, int>();
+		// Get the link status
+		glGetProgramiv(programID, GL_LINK_STATUS, &Result);
+		glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 
-	// Define all uniforms
-	unsigned int nuniforms = sizeof(uniformsTable)/sizeof(char*);
-	for(unsigned int i=0;i<nuniforms;i++){
-		internalDefineUniform(uniformsTable[i]);
+		// Delete shader objects
+		for(int i=0;i<3;i++){
+			if(stages[i] == 0) continue;
+			glDetachShader(programID, stages[i]);
+			glDeleteShader(stages[i]);
+			stages[i] = 0;
+		}
+
+		// Show errors, or save the binary for the next run
+		if(InfoLogLength > 0){
+			std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+			glGetProgramInfoLog(programID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+			fprintf(stderr, "[%s]\n", name.c_str());
+			Debug::showError(8, &ProgramErrorMessage[0]);
+		}
+		if(Result == GL_TRUE && cacheEnabled){
+			char cacheName[32];
+			sprintf(cacheName, "%08x%08x.prog", (unsigned int)(key >> 32), (unsigned int)key);
+			saveBinary(cacheName);
+		}
 	}
+
+	// Everything OK, find the uniforms and set the texture units
+	findUniforms();
 	char text[64];
-	for(int i=0;i<AMG_MAX_LIGHTS;i++){
-		sprintf(text, "AMG_Light[%d].position", i);
-		internalDefineUniform(std::string(text));			// Vertex shader
-		sprintf(text, "AMG_Lights[%d].color", i);
-		internalDefineUniform(std::string(text));			// Fragment shader
-		sprintf(text, "AMG_Lights[%d].attenuation", i);
-		internalDefineUniform(std::string(text));
-		sprintf(text, "AMG_Lights[%d].spotDirection", i);
-		internalDefineUniform(std::string(text));
-		sprintf(text, "AMG_Lights[%d].spotCutoff", i);
-		internalDefineUniform(std::string(text));
-	}
-	for(int i=0;i<AMG_MAX_DLIGHTS;i++){
-		sprintf(text, "AMG_LightDR[%d].position", i);
-		internalDefineUniform(std::string(text));
-		sprintf(text, "AMG_LightDR[%d].color", i);
-		internalDefineUniform(std::string(text));
-		sprintf(text, "AMG_LightDR[%d].attenuation", i);
-		internalDefineUniform(std::string(text));
-		sprintf(text, "AMG_LightDR[%d].spotDirection", i);
-		internalDefineUniform(std::string(text));
-		sprintf(text, "AMG_LightDR[%d].spotCutoff", i);
-		internalDefineUniform(std::string(text));
-	}
 	glUseProgram(programID);
 	for(int i=0;i<AMG_MAX_TEXTURES;i++){
 		sprintf(text, "AMG_TextureSampler[%d]", i);
-		std::string name = std::string(text);
-		internalDefineUniform(name);
-		setUniform(name, i);
+		int location = getUniform(text);
+		if(location != -1) glUniform1i(location, i);
 	}
+	int location = getUniform("AMG_TextureArraySampler");
+	if(location != -1) glUniform1i(location, AMG_TEXTURE_ARRAY_SLOT);
+
+	// This may run in the middle of a frame, keep the current program
+	Shader *current = Renderer::getCurrentShader();
+	glUseProgram(current ? current->programID : 0);
+	loadTime += glfwGetTime() - start;
 }
 
 /**
- * @brief Define a uniform variable from the shader
- * @param name Name of the uniform
+ * @brief Fill the uniform tables with the active uniforms of the program, used internally
+ * @note Arrays are reported once, as "name[0]", and their elements are assumed to have consecutive locations
  */
-void Shader::defineUniform(std::string name){
-	int id = glGetUniformLocation(programID, name.c_str());
-	if(id == -1){
-		Debug::showError(9, (void*)name.c_str());
+void Shader::findUniforms(){
+	uniformsMap.clear();
+	blocksMap.clear();
+
+	// Active uniforms, uniforms inside blocks have no location
+	GLint nactive = 0, maxLength = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &nactive);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> text(maxLength + 1);
+	char element[16];
+	for(int i=0;i<nactive;i++){
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(programID, i, maxLength + 1, NULL, &size, &type, &text[0]);
+		int location = glGetUniformLocation(programID, &text[0]);
+		if(location == -1) continue;
+		std::string uniform(&text[0]);
+		bool array = (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0);
+		if(array) uniform.erase(uniform.size() - 3);
+		uniformsMap[uniform] = location;
+		if(array || size > 1){
+			for(int j=0;j<size;j++){
+				sprintf(element, "[%d]", j);
+				uniformsMap[uniform + element] = location + j;
+			}
+		}
 	}
-	uniformsMap[name] = id;
+
+	// Active uniform blocks
+	GLint nblocks = 0;
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCKS, &nblocks);
+	for(int i=0;i<nblocks;i++){
+		GLint length = 0;
+		glGetActiveUniformBlockiv(programID, i, GL_UNIFORM_BLOCK_NAME_LENGTH, &length);
+		std::vector<char> block(length + 1);
+		glGetActiveUniformBlockName(programID, i, length + 1, NULL, &block[0]);
+		blocksMap[&block[0]] = i;
+	}
+
+	// Flat table for the engine uniforms
+	unsigned int nuniforms = sizeof(uniformsTable)/sizeof(char*);
+	locations.resize(nuniforms);
+	for(unsigned int i=0;i<nuniforms;i++){
+		std::tr1::unordered_map<std::string, int>::const_iterator got = uniformsMap.find(uniformsTable[i]);
+		locations[i] = (got == uniformsMap.end()) ? -1 : got->second;
+	}
+}
+
+/**
+ * @brief Check whether the program can be used without waiting for the driver
+ * @return Whether the program has been linked
+ * @note Without KHR_parallel_shader_compile this can't be known, and it always returns true
+ */
+bool Shader::isReady(){
+	if(!pending || !GLEW_KHR_parallel_shader_compile) return true;
+	GLint done = GL_TRUE;
+	glGetProgramiv(programID, GL_COMPLETION_STATUS_KHR, &done);
+	return done == GL_TRUE;
+}
+
+/**
+ * @brief Forget the shader files kept in memory, so edited files are read again
+ */
+void Shader::clearFileCache(){
+	fileCache.clear();
 }
 
 /**
  * @brief Define a uniform variable from the shader
  * @param name Name of the uniform
- * @note This function doesn't pop an error message if not defined
+ * @note Active uniforms are found when the program is linked, this only checks that the uniform exists
  */
-void Shader::internalDefineUniform(std::string name){
+void Shader::defineUniform(std::string name){
+	complete();
+	if(uniformsMap.find(name) != uniformsMap.end()) return;
 	int id = glGetUniformLocation(programID, name.c_str());
-	if(id != -1){
-		uniformsMap[name] = id;
+	if(id == -1){
+		Debug::showError(9, (void*)name.c_str());
 	}
+	uniformsMap[name] = id;
 }
 
 /**
@@ -223,6 +482,7 @@ void Shader::internalDefineUniform(std::string name){
  * @return the uniform ID, or -1 if it does not exist
  */
 int Shader::getUniform(const std::string &name){
+	complete();
 	std::tr1::unordered_map<std::string, int>::const_iterator got = uniformsMap.find(name);
 	if(got == uniformsMap.end()){
 		return -1;
@@ -230,6 +490,20 @@ int Shader::getUniform(const std::string &name){
 	return got->second;
 }
 
+/**
+ * @brief Get a uniform block from this shader
+ * @param name Name of the uniform block
+ * @return The uniform block index, or -1 if it does not exist
+ */
+int Shader::getUniformBlock(const std::string &name){
+	complete();
+	std::tr1::unordered_map<std::string, int>::const_iterator got = blocksMap.find(name);
+	if(got == blocksMap.end()){
+		return -1;
+	}
+	return got->second;
+}
+
 /**
  * @brief Set a uniform value, int version
  * @param name Name of the uniform variable to be set
@@ -308,6 +582,7 @@ void Shader::setUniform3fv(const std::string &name, int n, GLfloat *data){
  */
 void Shader::enable(){
 	if(Renderer::getCurrentShader() != this){
+		complete();
 
 		// Enable the shader program
 		glUseProgram(programID);
@@ -333,7 +608,8 @@ void Shader::enable(){
  */
 void Shader::setClipPlane(int id, vec4 &plane){
 	glEnable(GL_CLIP_DISTANCE0 + id);
-	glUniform4f(getUniform(uniformsTable[AMG_ClippingPlanes]) + id, plane.x, plane.y, plane.z, plane.w);
+	complete();
+	glUniform4f(locations[AMG_ClippingPlanes] + id, plane.x, plane.y, plane.z, plane.w);
 }
 
 /**
@@ -341,7 +617,8 @@ void Shader::setClipPlane(int id, vec4 &plane){
  * @param id Clipping plane ID (0-7)
  */
 void Shader::disableClipPlane(int id){
-	glUniform4f(getUniform(uniformsTable[AMG_ClippingPlanes]) + id, 0, 1, 0, 100000);	// Some gpu's ignore the glDisable call
+	complete();
+	glUniform4f(locations[AMG_ClippingPlanes] + id, 0, 1, 0, 100000);	// Some gpu's ignore the glDisable call
 	glDisable(GL_CLIP_DISTANCE0 + id);
 }
 
@@ -349,6 +626,14 @@ void Shader::disableClipPlane(int id){
  * @brief Destructor for a shader object
  */
 Shader::~Shader() {
+	for(int i=0;i<3;i++){
+		if(stages[i]) glDeleteShader(stages[i]);
+	}
+	std::tr1::unordered_map<unsigned long long, AMG_ShaderProgram>::iterator it = programs.find(key);
+	if(it != programs.end()){
+		if(--it->second.references > 0) return;
+		programs.erase(it);
+	}
 	glDeleteProgram(programID);
 }
 
@@ -25,9 +25,19 @@ using namespace glm;
 #define AMG_MAX_DLIGHTS 8			/**< Maximum number of lights in deferred rendering */
 #define AMG_MAX_TEXTURES 6			/**< Maximum number of textures at once */
 #define AMG_WATER_CLIPPING_PLANE 7	/**< Clipping plane for water rendering */
+#define AMG_TEXTURE_ARRAY_SLOT AMG_MAX_TEXTURES	/**< Texture unit for texture arrays, after the AMG_TextureSampler ones */
 
 namespace AMG {
 
+/**
+ * @struct AMG_ShaderProgram
+ * @brief A linked program, shared by every Shader with the same preprocessed code
+ */
+typedef struct{
+	GLuint id;					/**< OpenGL program ID */
+	int references;				/**< Number of Shader objects using it */
+}AMG_ShaderProgram;
+
 enum AMG_SHADER_UNIFORMS {
 	AMG_MVP, AMG_BoneMatrix,
 	AMG_NLights, AMG_MV, AMG_M,
@@ -38,7 +48,7 @@ enum AMG_SHADER_UNIFORMS {
 	AMG_CharEdge, AMG_CharBorderWidth, AMG_CharBorderEdge, AMG_CharShadowOffset,
 	AMG_CharOutlineColor, AMG_SSAOSamples, AMG_SSAOProjection, AMG_DView, AMG_HDRExposure,
 	AMG_GammaValue, AMG_SpecularReflectivity, AMG_SSAOKernelSize, AMG_SSAOKernelRadius, AMG_WorldAmbient,
-	AMG_RefractionIndex
+	AMG_RefractionIndex, AMG_V, AMG_P, AMG_TexFrames, AMG_TexLayer
 };
 
 /**
@@ -48,18 +58,57 @@ enum AMG_SHADER_UNIFORMS {
 class Shader : private Entity {
 private:
 	int programID;											/**< Internal OpenGL program ID */
+	unsigned long long key;									/**< Hash of the preprocessed code and driver, shared by identical permutations */
+	bool pending;											/**< Does the program still need to be checked and set up? */
+	GLuint stages[3];										/**< Vertex, fragment and geometry shader objects being compiled, 0 if unused */
+	std::string name;										/**< Shader file path (without extension), for error messages */
 	std::tr1::unordered_map<std::string, int> uniformsMap;	/**< Hash map holding uniform variables in the shader */
+	std::tr1::unordered_map<std::string, int> blocksMap;	/**< Hash map holding the uniform block indices */
+	std::vector<int> locations;								/**< Location of each uniformsTable entry, -1 if not active */
 	const static char *uniformsTable[];						/**< Uniforms table */
-	int loadShader(const char *path, int type);
-	std::string loadShaderCode(const char *path);
-	void internalDefineUniform(std::string name);
+	static bool cacheEnabled;								/**< Are linked programs cached as binaries? */
+	static int nprograms;									/**< Number of programs created */
+	static int ncached;										/**< Number of programs loaded from the binary cache */
+	static double loadTime;									/**< Total time spent creating programs, in seconds */
+	static unsigned long long driverHash;					/**< Hash of the driver identity, 0 if not computed yet */
+	static int nshared;										/**< Number of Shader objects which reused an identical program */
+	static std::tr1::unordered_map<std::string, std::string> fileCache;			/**< Text of the shader files read so far */
+	static std::tr1::unordered_map<unsigned long long, AMG_ShaderProgram> programs;	/**< Linked programs, by key */
+	int loadShader(const std::string &code, int type);
+	bool readShaderFile(const char *path, int type, std::string &text);
+	std::string loadShaderCode(const char *path, int type, const std::vector<std::string> *defines, std::vector<std::string> &included);
+	bool shaderExists(const char *path);
+	void create(const char *file_path, const std::vector<std::string> &defines, const char **varyings, int nvaryings);
+	void finishCreate();
+	void findUniforms();
+	inline void complete(){ if(pending) finishCreate(); }
+	static inline void upload(int location, int v){ glUniform1i(location, v); }
+	static inline void upload(int location, float v){ glUniform1f(location, v); }
+	static inline void upload(int location, vec2 &v){ glUniform2f(location, v.x, v.y); }
+	static inline void upload(int location, vec3 &v){ glUniform3f(location, v.x, v.y, v.z); }
+	static inline void upload(int location, vec4 &v){ glUniform4f(location, v.x, v.y, v.z, v.w); }
+	static inline void upload(int location, mat4 &v){ glUniformMatrix4fv(location, 1, GL_FALSE, &v[0][0]); }
+	static inline void upload(int location, mat3 &v){ glUniformMatrix3fv(location, 1, GL_FALSE, &v[0][0]); }
+	bool loadBinary(const char *name);
+	void saveBinary(const char *name);
+	static unsigned long long getDriverHash();
 public:
-	int getProgram(){ return programID; }
+	int getProgram(){ complete(); return programID; }
+	static bool &isCacheEnabled(){ return cacheEnabled; }
+	static int getNPrograms(){ return nprograms; }
+	static int getNCached(){ return ncached; }
+	static int getNShared(){ return nshared; }
+	static double getLoadTime(){ return loadTime * 1000.0; }
 
 	Shader(const char *file_path);
+	Shader(const char *file_path, const std::vector<std::string> &defines);
+	Shader(const char *file_path, const char **varyings, int nvaryings);
+	bool isReady();
+	static void clearFileCache();
 	void defineUniform(std::string name);
 	int getUniform(const std::string &name);
-	template<typename T> inline void setUniform(int id, T &v){ setUniform(uniformsTable[id], v); }
+	int getUniformBlock(const std::string &name);
+	template<typename T> inline void setUniform(int id, T &v){ complete(); upload(locations[id], v); }
 	void setUniform(const std::string &name, int v);
 	void setUniform(const std::string &name, float v);
 	void setUniform(const std::string &name, vec2 &v);
@@ -68,7 +117,7 @@ public:
 	void setUniform(const std::string &name, mat4 &v);
 	void setUniform(const std::string &name, mat3 &v);
 	void setUniform3fv(const std::string &name, int n, GLfloat *data);
-	inline void setUniform3fv(int id, int n, GLfloat *data){ setUniform3fv(uniformsTable[id], n, data); }
+	inline void setUniform3fv(int id, int n, GLfloat *data){ complete(); glUniform3fv(locations[id], n, data); }
 	void setClipPlane(int id, vec4 &plane);
 	inline void setWaterClipPlane(vec4 &plane){ setClipPlane(AMG_WATER_CLIPPING_PLANE, plane); }
 	void disableClipPlane(int id);
@@ -0,0 +1,76 @@
+/**
+ * @file Simd.h
+ * @brief Four-wide float operations, using SSE when the compiler allows it
+ */
+
+#ifndef SIMD_H_
+#define SIMD_H_
+
+// Includes SSE
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AMG_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+namespace AMG {
+
+#ifdef AMG_SIMD_SSE
+
+/**
+ * @typedef AMG_Float4
+ * @brief Four floats processed at once
+ */
+typedef __m128 AMG_Float4;
+
+inline AMG_Float4 simdLoad(const float *p){ return _mm_loadu_ps(p); }
+inline void simdStore(float *p, AMG_Float4 a){ _mm_storeu_ps(p, a); }
+inline AMG_Float4 simdSet(float v){ return _mm_set1_ps(v); }
+inline AMG_Float4 simdSet(float a, float b, float c, float d){ return _mm_setr_ps(a, b, c, d); }
+inline AMG_Float4 simdAdd(AMG_Float4 a, AMG_Float4 b){ return _mm_add_ps(a, b); }
+inline AMG_Float4 simdSub(AMG_Float4 a, AMG_Float4 b){ return _mm_sub_ps(a, b); }
+inline AMG_Float4 simdMul(AMG_Float4 a, AMG_Float4 b){ return _mm_mul_ps(a, b); }
+inline AMG_Float4 simdDiv(AMG_Float4 a, AMG_Float4 b){ return _mm_div_ps(a, b); }
+inline AMG_Float4 simdMin(AMG_Float4 a, AMG_Float4 b){ return _mm_min_ps(a, b); }
+inline AMG_Float4 simdMax(AMG_Float4 a, AMG_Float4 b){ return _mm_max_ps(a, b); }
+inline AMG_Float4 simdCmpGe(AMG_Float4 a, AMG_Float4 b){ return _mm_cmpge_ps(a, b); }
+inline AMG_Float4 simdCmpGt(AMG_Float4 a, AMG_Float4 b){ return _mm_cmpgt_ps(a, b); }
+inline AMG_Float4 simdAnd(AMG_Float4 a, AMG_Float4 b){ return _mm_and_ps(a, b); }
+inline AMG_Float4 simdOr(AMG_Float4 a, AMG_Float4 b){ return _mm_or_ps(a, b); }
+inline AMG_Float4 simdSelect(AMG_Float4 mask, AMG_Float4 a, AMG_Float4 b){ return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline int simdMask(AMG_Float4 mask){ return _mm_movemask_ps(mask); }
+
+#else
+
+/**
+ * @struct AMG_Float4
+ * @brief Four floats processed at once (scalar fallback)
+ * @note Masks hold 1.0f for true lanes and 0.0f for false lanes
+ */
+typedef struct{
+	float v[4];		/**< Lanes */
+}AMG_Float4;
+
+#define AMG_SIMD_OP(expr) AMG_Float4 r; for(int i=0;i<4;i++){ r.v[i] = (expr); } return r;
+inline AMG_Float4 simdLoad(const float *p){ AMG_SIMD_OP(p[i]) }
+inline void simdStore(float *p, AMG_Float4 a){ for(int i=0;i<4;i++) p[i] = a.v[i]; }
+inline AMG_Float4 simdSet(float v){ AMG_SIMD_OP(v) }
+inline AMG_Float4 simdSet(float a, float b, float c, float d){ AMG_Float4 r = {{a, b, c, d}}; return r; }
+inline AMG_Float4 simdAdd(AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP(a.v[i] + b.v[i]) }
+inline AMG_Float4 simdSub(AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP(a.v[i] - b.v[i]) }
+inline AMG_Float4 simdMul(AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP(a.v[i] * b.v[i]) }
+inline AMG_Float4 simdDiv(AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP(a.v[i] / b.v[i]) }
+inline AMG_Float4 simdMin(AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline AMG_Float4 simdMax(AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP(a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+inline AMG_Float4 simdCmpGe(AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP(a.v[i] >= b.v[i] ? 1.0f : 0.0f) }
+inline AMG_Float4 simdCmpGt(AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP(a.v[i] > b.v[i] ? 1.0f : 0.0f) }
+inline AMG_Float4 simdAnd(AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP((a.v[i] != 0.0f && b.v[i] != 0.0f) ? 1.0f : 0.0f) }
+inline AMG_Float4 simdOr(AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP((a.v[i] != 0.0f || b.v[i] != 0.0f) ? 1.0f : 0.0f) }
+inline AMG_Float4 simdSelect(AMG_Float4 mask, AMG_Float4 a, AMG_Float4 b){ AMG_SIMD_OP(mask.v[i] != 0.0f ? a.v[i] : b.v[i]) }
+inline int simdMask(AMG_Float4 mask){ int m = 0; for(int i=0;i<4;i++){ if(mask.v[i] != 0.0f) m |= (1 << i); } return m; }
+#undef AMG_SIMD_OP
+
+#endif
+
+}
+
+#endif
@@ -76,6 +76,7 @@ Skybox::Skybox(const char *dir) {
 	addBuffer(skyboxData, sizeof(skyboxData), 3, GL_FLOAT, true);
 	this->vertices = NULL;
 	this->nvertices = 0;
+	this->transform.setZUp(false);
 
 	// Create the material
 	materials = (Material**) calloc (1, sizeof(Material*));
@@ -101,6 +102,7 @@ Skybox::Skybox(Texture *cubeMap){
 	addBuffer(skyboxData, sizeof(skyboxData), 3, GL_FLOAT, true);
 	this->vertices = NULL;
 	this->nvertices = 0;
+	this->transform.setZUp(false);
 
 	// Create the material
 	materials = (Material**) calloc (1, sizeof(Material*));
@@ -111,7 +113,7 @@ Skybox::Skybox(Texture *cubeMap){
  * @brief Draws a Skybox in the current Renderer
  */
 void Skybox::draw(){
-	Renderer::setTransformation(position, rotation, scale);
+	Renderer::setModel(transform.getModelMatrix());
 	Renderer::updateMVP();
 	materials[0]->apply();
 	glDepthMask(GL_FALSE);
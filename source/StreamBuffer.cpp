@@ -0,0 +1,127 @@
+/**
+ * @file StreamBuffer.cpp
+ * @brief Ring buffer for vertex data which changes every frame
+ */
+
+// Includes C/C++
+#include <stddef.h>
+
+// Own includes
+#include "StreamBuffer.h"
+
+namespace AMG {
+
+// Static variables
+GLuint StreamBuffer::buffer = 0;
+char *StreamBuffer::persistentData = NULL;
+bool StreamBuffer::mapped = false;
+int StreamBuffer::regionSize = 0;
+int StreamBuffer::frame = 0;
+int StreamBuffer::offset = 0;
+GLsync StreamBuffer::fences[AMG_STREAM_FRAMES];
+
+/**
+ * @brief Create the streaming buffer
+ * @param size Size of each frame region, in bytes
+ * @note Called by the Renderer, after creating the OpenGL context
+ */
+void StreamBuffer::initialize(int size){
+
+	// If it was initialised
+	if(buffer) return;
+
+	regionSize = (size + AMG_STREAM_ALIGNMENT - 1) & ~(AMG_STREAM_ALIGNMENT - 1);
+	frame = 0;
+	offset = 0;
+	for(int i=0;i<AMG_STREAM_FRAMES;i++){
+		fences[i] = 0;
+	}
+
+	// Create the buffer, mapped forever if possible
+	GLsizeiptr total = (GLsizeiptr)regionSize * AMG_STREAM_FRAMES;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if(GLEW_ARB_buffer_storage){
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, total, NULL, flags);
+		persistentData = (char*) glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags);
+	}else{
+		glBufferData(GL_ARRAY_BUFFER, total, NULL, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * @brief Allocate space for this frame and map it for writing
+ * @param size Number of bytes to write
+ * @param bufferOffset Where to store the allocation offset inside the buffer, for attribute pointers
+ * @return Pointer where the data must be written, or NULL if this frame's region is full
+ * @note Call unmap() once the data is written, before drawing. Only one allocation can be mapped at once
+ */
+void *StreamBuffer::map(int size, GLintptr *bufferOffset){
+
+	// Check there is space left
+	if(buffer == 0 || mapped || size <= 0 || offset + size > regionSize) return NULL;
+	GLintptr start = (GLintptr)frame * regionSize + offset;
+	offset += (size + AMG_STREAM_ALIGNMENT - 1) & ~(AMG_STREAM_ALIGNMENT - 1);
+	*bufferOffset = start;
+	mapped = true;
+
+	// Persistent mapping: just return the pointer
+	if(persistentData) return persistentData + start;
+
+	// Otherwise map the range without synchronisation, the fences already protect it
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+	void *data = glMapBufferRange(GL_ARRAY_BUFFER, start, size, flags);
+	if(data == NULL) mapped = false;
+	return data;
+}
+
+/**
+ * @brief Finish writing the last mapped allocation
+ * @note Leaves the streaming buffer bound to GL_ARRAY_BUFFER
+ */
+void StreamBuffer::unmap(){
+	if(!mapped) return;
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if(persistentData == NULL) glUnmapBuffer(GL_ARRAY_BUFFER);
+	mapped = false;
+}
+
+/**
+ * @brief Fence the current region and move on to the next one
+ * @note Called by the Renderer after swapping buffers. It only waits if the GPU is
+ * more than AMG_STREAM_FRAMES - 1 frames behind
+ */
+void StreamBuffer::endFrame(){
+	if(buffer == 0) return;
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frame = (frame + 1) % AMG_STREAM_FRAMES;
+	offset = 0;
+	if(fences[frame]){
+		while(glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fences[frame]);
+		fences[frame] = 0;
+	}
+}
+
+/**
+ * @brief Delete the streaming buffer
+ */
+void StreamBuffer::finish(){
+	if(buffer == 0) return;
+	for(int i=0;i<AMG_STREAM_FRAMES;i++){
+		if(fences[i]) glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	if(persistentData){
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		persistentData = NULL;
+	}
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+}
@@ -0,0 +1,49 @@
+/**
+ * @file StreamBuffer.h
+ * @brief Ring buffer for vertex data which changes every frame
+ */
+
+#ifndef STREAMBUFFER_H_
+#define STREAMBUFFER_H_
+
+// Includes OpenGL
+#include <GL/glew.h>
+
+// Defines
+#define AMG_STREAM_FRAMES 3					/**< Number of frames the ring buffer holds */
+#define AMG_STREAM_SIZE (4 * 1024 * 1024)	/**< Default size of each frame region, in bytes */
+#define AMG_STREAM_ALIGNMENT 16				/**< Alignment of each allocation, in bytes */
+
+namespace AMG {
+
+/**
+ * @class StreamBuffer
+ * @brief Per-frame allocator for dynamic vertex data, shared by the whole engine
+ * @note The buffer is split in one region per frame, and each region is fenced so the CPU
+ * never writes data the GPU is still reading. When ARB_buffer_storage is available, the
+ * buffer stays mapped all the time
+ */
+class StreamBuffer {
+private:
+	static GLuint buffer;						/**< OpenGL buffer */
+	static char *persistentData;				/**< Persistent mapping of the whole buffer, NULL if not supported */
+	static bool mapped;							/**< Is there a range mapped for writing? */
+	static int regionSize;						/**< Size of each frame region, in bytes */
+	static int frame;							/**< Region used in the current frame */
+	static int offset;							/**< Bytes already allocated in the current region */
+	static GLsync fences[AMG_STREAM_FRAMES];	/**< Fence for each region, signaled when the GPU is done with it */
+	StreamBuffer(){}
+public:
+	static GLuint getBuffer(){ return buffer; }
+	static bool isPersistent(){ return persistentData != NULL; }
+
+	static void initialize(int size=AMG_STREAM_SIZE);
+	static void *map(int size, GLintptr *bufferOffset);
+	static void unmap();
+	static void endFrame();
+	static void finish();
+};
+
+}
+
+#endif
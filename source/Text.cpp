@@ -3,9 +3,15 @@
  * @brief Text creation and manipulation
  */
 
+// Includes C/C++
+#include <stdlib.h>
+#include <string.h>
+
 // Own includes
 #include "Text.h"
+#include "Font.h"
 #include "Renderer.h"
+#include "StreamBuffer.h"
 
 namespace AMG {
 
@@ -17,6 +23,33 @@ namespace AMG {
  * @param texture Font texture
  */
 Text::Text(float *vertices, float *texcoords, int size, Texture *texture) {
+	init(texture);
+	addBuffer(vertices, size, 2, GL_FLOAT, true);
+	addBuffer(texcoords, size, 2, GL_FLOAT);
+	this->vertices = NULL;
+}
+
+/**
+ * @brief Constructor for a dynamic Text, see Font::createDynamicText
+ * @param font Font used to write the glyphs
+ * @param texture Font texture
+ * @param size Size of the text
+ * @param width Textbox width, in pixels
+ * @param height Textbox height, in pixels
+ */
+Text::Text(Font *font, Texture *texture, float size, float width, float height) {
+	init(texture);
+	this->font = font;
+	this->size = size;
+	this->boxWidth = width;
+	this->boxHeight = height;
+}
+
+/**
+ * @brief Set the default values of a Text, used internally
+ * @param texture Font texture
+ */
+void Text::init(Texture *texture){
 	this->position = vec3(0, 0, 0);
 	this->color = vec4(1, 1, 1, 1);
 	this->texture = texture;
@@ -26,9 +59,23 @@ Text::Text(float *vertices, float *texcoords, int size, Texture *texture) {
 	this->charBorderEdge = 0.1f;
 	this->charShadowOffset = vec2(0.0f, 0.0f);
 	this->charOutlineColor = vec3(0.0f, 0.0f, 0.0f);
-	addBuffer(vertices, size, 2, GL_FLOAT, true);
-	addBuffer(texcoords, size, 2, GL_FLOAT);
-	this->vertices = NULL;
+	this->font = NULL;
+	this->string = NULL;
+	this->size = 0.0f;
+	this->boxWidth = 0.0f;
+	this->boxHeight = 0.0f;
+}
+
+/**
+ * @brief Change the string of a dynamic Text
+ * @param text The new string, in extended ASCII format
+ */
+void Text::setString(const char *text){
+	if(string) free(string);
+	string = NULL;
+	if(text == NULL) return;
+	string = (char*) malloc ((strlen(text) + 1) * sizeof(char));
+	strcpy(string, text);
 }
 
 /**
@@ -46,13 +93,44 @@ void Text::draw(){
 	shader->setUniform(AMG_SprColor, color);
 	Renderer::setTransformation(position);
 	Renderer::updateMVP();
-	MeshData::drawRaw();
+	if(font){
+		drawDynamic();
+	}else{
+		MeshData::drawRaw();
+	}
+}
+
+/**
+ * @brief Write the glyphs of a dynamic Text to the streaming buffer and draw them
+ */
+void Text::drawDynamic(){
+
+	// Map room for the worst case, every character being a glyph
+	if(string == NULL || string[0] == '\0') return;
+	int maxFloats = strlen(string) * 12;
+	GLintptr base = 0;
+	float *data = (float*) StreamBuffer::map(maxFloats * 2 * sizeof(float), &base);
+	if(data == NULL) return;
+	int remaining = 0;
+	int nfloats = font->layoutText(string, size, boxWidth, boxHeight, data, data + maxFloats, &remaining);
+	StreamBuffer::unmap();
+
+	// Draw the glyphs, vertices first and texture coordinates after them
+	glBindVertexArray(this->id);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)base);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(base + maxFloats * sizeof(float)));
+	glDrawArrays(GL_TRIANGLES, 0, nfloats / 2);
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
 }
 
 /**
  * @brief Destructor for a Text
  */
 Text::~Text() {
+	if(string) free(string);
 }
 
 }
@@ -16,6 +16,8 @@ using namespace glm;
 
 namespace AMG {
 
+class Font;
+
 /**
  * @class Text
  * @brief Contains text, usable by the engine to show it in 2D mode
@@ -31,6 +33,13 @@ private:
 	float charBorderEdge;	/**< Character border edge */
 	vec2 charShadowOffset;	/**< Character shadow offset */
 	vec3 charOutlineColor;	/**< Character outline color */
+	Font *font;				/**< Font used to write the glyphs of a dynamic text, NULL for static texts */
+	char *string;			/**< String of a dynamic text */
+	float size;				/**< Size of a dynamic text */
+	float boxWidth;			/**< Textbox width of a dynamic text, in pixels */
+	float boxHeight;		/**< Textbox height of a dynamic text, in pixels */
+	void init(Texture *texture);
+	void drawDynamic();
 public:
 
 	vec3 &getPosition(){ return position; }
@@ -41,8 +50,11 @@ public:
 	float &getCharBorderEdge(){ return charBorderEdge; }
 	vec2 &getCharShadowOffset(){ return charShadowOffset; }
 	vec3 &getCharOutlineColor(){ return charOutlineColor; }
+	bool isDynamic(){ return font != NULL; }
 
 	Text(float *vertices, float *texcoords, int size, Texture *texture);
+	Text(Font *font, Texture *texture, float size, float width, float height);
+	void setString(const char *text);
 	void draw();
 	virtual ~Text();
 };
@@ -13,6 +13,9 @@
 #include "Texture.h"
 #include "Debug.h"
 #include "Renderer.h"
+#include "TextureStreamer.h"
+#include "UploadPool.h"
+#include "FileSystem.h"
 
 // Defines for DDS loading
 #define FOURCC_DXT1 0x31545844
@@ -37,6 +40,10 @@ Texture::Texture(){
 	this->nframes = 1;
 	this->id = 0;
 	this->isCopy = false;
+	this->loading = false;
+	this->lodBias = 0.0f;
+	this->anisotropy = 0.0f;
+	this->stream = NULL;
 }
 
 /**
@@ -93,6 +100,7 @@ void Texture::set(Texture *texture){
 	this->nframes = texture->getNFrames();
 	this->id = texture->id;
 	this->isCopy = true;
+	this->loading = texture->loading;
 }
 
 /**
@@ -164,7 +172,7 @@ Texture::Texture(const char **names, bool srgb) : Texture(){
  * @param frameWidth Width of one frame, in pixels
  * @param frameHeight Height of one frame, in pixels
  */
-Texture::Texture(const char *path, int frameWidth, int frameHeight, bool srgb){
+Texture::Texture(const char *path, int frameWidth, int frameHeight, bool srgb) : Texture(){
 	loadTexture(path, srgb);
 	this->currentFrame = 0.0f;
 	this->texScale.x = (float)frameWidth / (float)width;
@@ -181,24 +189,60 @@ Texture::Texture(const char *path, int frameWidth, int frameHeight, bool srgb){
  * @param srgb Load in sRGB format?
  */
 void Texture::loadTexture(const char *path, bool srgb){
+	AMG_TextureData data;
+	int error = Texture::readTexture(path, srgb, &data);
+	if(error != NO_ERROR) Debug::showError(error, (void*)path);
+	UploadPool::begin(-1);
+	create(&data);
+	UploadPool::end(-1, data.size);
+	free(data.buffer);
+}
+
+/**
+ * @brief Create the OpenGL texture from data already read
+ * @param data Texture data, see Texture::readTexture
+ * @note If the texture was showing a placeholder, it is replaced
+ */
+void Texture::create(AMG_TextureData *data){
 
 	this->target = GL_TEXTURE_2D;
+	this->width = data->width;
+	this->height = data->height;
+	this->isCopy = false;
+	this->loading = false;
 	glGenTextures(1, &this->id);
 	glBindTexture(target, this->id);
 	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, data->firstMip);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, data->nmips - 1);
+
+	Texture::uploadTexture(data, target);
 
-	Texture::loadTexture(path, target, &this->width, &this->height, srgb);
+	// Filtering set up while the placeholder was shown
+	if(lodBias != 0.0f) setLod(lodBias);
+	if(anisotropy != 0.0f) setAniso(anisotropy);
 	glBindTexture(target, 0);
 }
 
+/**
+ * @brief Show another texture until this texture's data is created
+ * @param placeholder Texture to show meanwhile
+ */
+void Texture::setPlaceholder(Texture *placeholder){
+	set(placeholder);
+	this->loading = true;
+}
+
 /**
  * @brief Set texture level of detail
  * @param bias LOD bias
  */
 void Texture::setLod(float bias){
+	this->lodBias = bias;
+	if(loading) return;
 	glBindTexture(target, this->id);
 	if(GLEW_EXT_texture_lod_bias){
 		glTexParameterf(target, GL_TEXTURE_LOD_BIAS, bias);
@@ -210,10 +254,13 @@ void Texture::setLod(float bias){
  * @param aniso Amount of anisotropic filtering
  */
 void Texture::setAniso(float aniso){
+	this->anisotropy = aniso;
+	if(loading) return;
 	if(GLEW_ARB_texture_filter_anisotropic){
 		float maxaniso = 0.0f;
 		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxaniso);
-		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, glm::min(aniso, maxaniso));
+		glBindTexture(target, this->id);
+		glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY, glm::min(aniso, maxaniso));
 	}
 }
 
@@ -225,41 +272,66 @@ void Texture::setAniso(float aniso){
  * @param srgb Load in sRGB format?
  */
 void Texture::loadTexture(const char *path, GLuint target, int *w, int *h, bool srgb){
-	FILE *fp = fopen(getFullPath(path, AMG_TEXTURE), "rb");
-	if (fp == NULL)
-		Debug::showError(5, (void*)path);
-
-	char filecode[4];
-	fread(filecode, 1, 4, fp);
-	if (strncmp(filecode, "DDS ", 4) != 0) {
-	    fclose(fp);
-	    Debug::showError(10, (void*)path);
+	AMG_TextureData data;
+	int error = Texture::readTexture(path, srgb, &data);
+	if(error != NO_ERROR) Debug::showError(error, (void*)path);
+	Texture::uploadTexture(&data, target);
+	*w = data.width;
+	*h = data.height;
+	free(data.buffer);
+}
+
+/**
+ * @brief Read a *.dds file, without touching OpenGL
+ * @param path Location of the texture file (*.dds)
+ * @param srgb Load in sRGB format?
+ * @param data Texture data (output), its buffer must be released with free
+ * @param staging Where to store the UploadPool buffer which holds the data, NULL to use client memory.
+ * It is set to -1 if no buffer was free, and then the data is in client memory too
+ * @return NO_ERROR, or the error found, see ErrorCodes
+ * @note It can be called from any thread
+ */
+int Texture::readTexture(const char *path, bool srgb, AMG_TextureData *data, int *staging){
+	if(staging) *staging = -1;
+	int error = Texture::readTextureHeader(path, srgb, data);
+	if(error == NO_ERROR){
+		if(staging) data->buffer = UploadPool::acquire(data->size, staging);
+		if(data->buffer == NULL) data->buffer = (unsigned char*) malloc (data->size * sizeof(unsigned char));
+		FileSystem::read(path, AMG_TEXTURE, data->buffer, AMG_DDS_HEADER, data->size);
 	}
+	return error;
+}
 
-	unsigned char header[124];
-	fread(&header, 124, 1, fp);
+/**
+ * @brief Read the header of a *.dds file
+ * @param path Location of the texture file (*.dds)
+ * @param srgb Load in sRGB format?
+ * @param data Texture data (output), with no buffer and the size of every mip level
+ * @return NO_ERROR, or the error found, see ErrorCodes
+ * @note The largest mip level starts right after the header, at AMG_DDS_HEADER
+ */
+int Texture::readTextureHeader(const char *path, bool srgb, AMG_TextureData *data){
+	data->buffer = NULL;
+
+	unsigned char file[AMG_DDS_HEADER];
+	int n = FileSystem::read(path, AMG_TEXTURE, file, 0, AMG_DDS_HEADER);
+	if (n < 0)
+		return FILE_NOT_FOUND;
+	if (n < AMG_DDS_HEADER || strncmp((char*)file, "DDS ", 4) != 0) {
+	    return WRONG_SIGNATURE;
+	}
+
+	unsigned char *header = file + 4;
 
-	*h    	  			     = *(unsigned int*)&(header[8 ]);
-	*w						 = *(unsigned int*)&(header[12]);
-	unsigned int linearSize  = *(unsigned int*)&(header[16]);
+	unsigned int height      = *(unsigned int*)&(header[8 ]);
+	unsigned int width       = *(unsigned int*)&(header[12]);
 	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
 	unsigned int fourCC      = *(unsigned int*)&(header[80]);
-	unsigned int width = *w;
-	unsigned int height = *h;
-
-	unsigned char * buffer;
-	unsigned int bufsize;
 
 	if(height % 2 != 0 || width % 2 != 0){
-		fclose(fp);
-		Debug::showError(12, (void*)path);
+		return NOT_POWER_OF_TWO_TEXTURE;
 	}
 
-	bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize;
-	buffer = (unsigned char*) malloc (bufsize * sizeof(unsigned char));
-	fread(buffer, 1, bufsize, fp);
-	fclose(fp);
-
 	//unsigned int components  = (fourCC == FOURCC_DXT1) ? 3 : 4;
 	unsigned int format = 0;
 	switch(fourCC){
@@ -273,22 +345,52 @@ void Texture::loadTexture(const char *path, GLuint target, int *w, int *h, bool
 			format = srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
 			break;
 		default:
-			free(buffer);
-			Debug::showError(11, (void*)path);
+			return UNSUPPORTED_FORMAT;
+	}
+
+	data->width = width;
+	data->height = height;
+	data->format = format;
+	data->blockSize = (fourCC == FOURCC_DXT1) ? 8 : 16;
+	data->nmips = (mipMapCount > 0) ? mipMapCount : 1;
+	data->firstMip = 0;
+	data->size = Texture::getLevelsSize(data, 0, data->nmips - 1);
+	return NO_ERROR;
+}
+
+/**
+ * @brief Get the size of a range of mip levels
+ * @param data Texture data
+ * @param first First mip level
+ * @param last Last mip level
+ * @return Size of the compressed levels, in bytes
+ */
+unsigned int Texture::getLevelsSize(AMG_TextureData *data, int first, int last){
+	unsigned int size = 0;
+	for(int level = first; level <= last; level++){
+		unsigned int width = glm::max(data->width >> level, 1);
+		unsigned int height = glm::max(data->height >> level, 1);
+		size += ((width+3)/4)*((height+3)/4)*data->blockSize;
 	}
+	return size;
+}
 
-	unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
+/**
+ * @brief Upload the mip levels of a texture read with Texture::readTexture
+ * @param data Texture data, its buffer starts at the level data->firstMip
+ * @param target Where to upload the data (the texture must be bound)
+ */
+void Texture::uploadTexture(AMG_TextureData *data, GLuint target){
 	unsigned int offset = 0;
 
-	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level){
-		unsigned int size = ((width+3)/4)*((height+3)/4)*blockSize;
-		glCompressedTexImage2D(target, level, format, width, height, 0, size, buffer + offset);
+	for (int level = data->firstMip; level < data->nmips; ++level){
+		unsigned int width = glm::max(data->width >> level, 1);
+		unsigned int height = glm::max(data->height >> level, 1);
+		unsigned int size = Texture::getLevelsSize(data, level, level);
+		if(offset + size > data->size) break;
+		glCompressedTexImage2D(target, level, data->format, width, height, 0, size, data->buffer + offset);
 		offset += size;
-		width  /= 2;
-		height /= 2;
 	}
-
-	free(buffer);
 }
 
 /**
@@ -296,6 +398,7 @@ void Texture::loadTexture(const char *path, GLuint target, int *w, int *h, bool
  * @param slot Texture slot to upload the texture
  */
 void Texture::bind(int slot){
+	if(stream) stream->lastUsed = TextureStreamer::getFrame();
 
 	// Bind the texture
 	glActiveTexture(GL_TEXTURE0 + slot);
@@ -359,10 +462,31 @@ void Texture::storeFrameData(float *data, int offset){
 	data[offset + 4] = progress;
 }
 
+/**
+ * @brief Tell a streamed texture how big it is on screen, to load the mip levels needed
+ * @param pixels Size on screen, in pixels
+ */
+void Texture::request(float pixels){
+	if(stream == NULL) return;
+	int level = 0;
+	float size = (float)glm::max(width, height);
+	while(level < stream->tailMip && size * 0.5f >= pixels){
+		size *= 0.5f;
+		level ++;
+	}
+	unsigned int frame = TextureStreamer::getFrame();
+	if(stream->lastUsed != frame || level < stream->wantedMip) stream->wantedMip = level;
+	stream->lastUsed = frame;
+}
+
 /**
  * @brief Destructor for a Texture
  */
 Texture::~Texture() {
+	if(stream){
+		TextureStreamer::remove(this);
+		delete stream;
+	}
 	if(this->id && !isCopy) glDeleteTextures(1, &this->id);
 }
 
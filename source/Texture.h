@@ -12,12 +12,46 @@
 #include <glm/glm.hpp>
 using namespace glm;
 
+// Includes C/C++
+#include <string>
+
 // Own includes
 #include "Entity.h"
 
 namespace AMG {
 
 #define AMG_CUBE_SIDES 6		/**< Number of faces a cube has */
+#define AMG_DDS_HEADER 128		/**< Size of a *.dds header, where the largest mip level starts */
+
+/**
+ * @struct AMG_TextureData
+ * @brief Compressed texture read from a *.dds file, ready to be uploaded
+ */
+typedef struct{
+	int width;					/**< Width of the largest mip level, in pixels */
+	int height;					/**< Height of the largest mip level, in pixels */
+	GLuint format;				/**< OpenGL compressed format */
+	int blockSize;				/**< Size of each 4x4 block, in bytes */
+	int nmips;					/**< Number of mip levels */
+	int firstMip;				/**< First mip level in the buffer */
+	unsigned char *buffer;		/**< Mip levels from firstMip to the smallest one */
+	unsigned int size;			/**< Size of the buffer, in bytes */
+}AMG_TextureData;
+
+/**
+ * @struct AMG_TextureStream
+ * @brief Streaming state of a texture, see TextureStreamer
+ */
+typedef struct{
+	std::string path;			/**< Location of the texture file (*.dds) */
+	AMG_TextureData info;		/**< Texture format, without data */
+	int tailMip;				/**< First level of the mip tail, which is always resident */
+	int residentMip;			/**< Largest mip level in video memory */
+	int wantedMip;				/**< Largest mip level needed on screen */
+	int loadingMip;				/**< Largest mip level being loaded, -1 if none */
+	unsigned int lastUsed;		/**< Last frame the texture was used */
+	unsigned int serial;		/**< Unique number of the streamed texture, as its address can be reused */
+}AMG_TextureStream;
 
 /**
  * @class Texture
@@ -33,6 +67,12 @@ private:
 	float progress;			/**< Blending between frames */
 	float currentFrame;		/**< Current frame to show, it will be truncated */
 	bool isCopy;			/**< Is this texture a reference to another texture */
+	bool loading;			/**< Is this texture showing a placeholder, while its data is loaded? */
+	float lodBias;			/**< Level of detail bias, applied when the data is uploaded */
+	float anisotropy;		/**< Anisotropic filtering, applied when the data is uploaded */
+	AMG_TextureStream *stream;	/**< Streaming state, NULL if all the mip levels are resident */
+	friend class TextureStreamer;
+	friend class TextureAtlas;
 	void loadTexture(const char *path, bool srgb=false);
 	static void loadTexture(const char *path, GLuint target, int *w, int *h, bool srgb);
 protected:
@@ -43,9 +83,16 @@ protected:
 public:
 	int getWidth(){ return width; }
 	int getHeight(){ return height; }
+	int getFrameWidth(){ return (int)(width * texScale.x); }
+	int getFrameHeight(){ return (int)(height * texScale.y); }
 	int getNFrames(){ return nframes; }
+	int getHorizontalFrames(){ return horizontalFrames; }
+	int getVerticalFrames(){ return verticalFrames; }
 	float &getCurrentFrame(){ return currentFrame; }
 	GLuint getID(){ return id; }
+	bool isLoading(){ return loading; }
+	bool isStreamed(){ return stream != NULL; }
+	AMG_TextureStream *getStream(){ return stream; }
 
 	Texture();
 	Texture(Texture *texture);
@@ -54,6 +101,13 @@ public:
 	Texture(const char *path, int frameWidth, int frameHeight, bool srgb=false);
 	Texture(int w, int h, GLuint mode, GLuint mode2, GLuint attachment, GLuint type=GL_UNSIGNED_BYTE);
 	void loadFloatData(int w, int h, float *data);
+	void create(AMG_TextureData *data);
+	void setPlaceholder(Texture *placeholder);
+	void request(float pixels);
+	static int readTexture(const char *path, bool srgb, AMG_TextureData *data, int *staging=NULL);
+	static int readTextureHeader(const char *path, bool srgb, AMG_TextureData *data);
+	static unsigned int getLevelsSize(AMG_TextureData *data, int first, int last);
+	static void uploadTexture(AMG_TextureData *data, GLuint target);
 	void createCubeMap(int dimensions);
 	void setLod(float bias);
 	void setAniso(float aniso);
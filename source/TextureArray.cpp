@@ -0,0 +1,92 @@
+/**
+ * @file TextureArray.cpp
+ * @brief Texture arrays, made of same-sized textures
+ */
+
+// Includes C/C++
+#include <stdlib.h>
+
+// Own includes
+#include "TextureArray.h"
+#include "Debug.h"
+
+namespace AMG {
+
+/**
+ * @brief Constructor for a Texture Array
+ * @param paths Location of each layer (*.dds)
+ * @param nlayers Number of layers
+ * @param srgb Is the color data in sRGB space?
+ * @note Every layer must have the size, format and mip levels of the first one
+ */
+TextureArray::TextureArray(const char **paths, int nlayers, bool srgb){
+	this->width = 0;
+	this->height = 0;
+	this->nlayers = nlayers;
+	glGenTextures(1, &this->id);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	GLuint format = 0;
+	int nmips = 0;
+	for(int i=0;i<nlayers;i++){
+		AMG_TextureData data;
+		int error = Texture::readTexture(paths[i], srgb, &data);
+		if(error != NO_ERROR) Debug::showError(error, (void*)paths[i]);
+
+		// The first layer defines the storage of the whole array
+		if(i == 0){
+			width = data.width;
+			height = data.height;
+			format = data.format;
+			nmips = data.nmips;
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, nmips - 1);
+			for(int level=0;level<nmips;level++){
+				unsigned int size = Texture::getLevelsSize(&data, level, level) * nlayers;
+				glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, glm::max(width >> level, 1), glm::max(height >> level, 1), nlayers, 0, size, NULL);
+			}
+		}else if(data.width != width || data.height != height || data.format != format || data.nmips != nmips){
+			Debug::showError(TEXTURE_ARRAY_MISMATCH, (void*)paths[i]);
+		}
+
+		// Upload every mip level of this layer
+		unsigned int offset = 0;
+		for(int level=0;level<nmips;level++){
+			unsigned int size = Texture::getLevelsSize(&data, level, level);
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, i, glm::max(width >> level, 1), glm::max(height >> level, 1), 1, format, size, data.buffer + offset);
+			offset += size;
+		}
+		free(data.buffer);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+/**
+ * @brief Bind this texture array
+ * @param slot Texture unit, usually AMG_TEXTURE_ARRAY_SLOT
+ */
+void TextureArray::bind(int slot){
+	glActiveTexture(GL_TEXTURE0 + slot);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+}
+
+/**
+ * @brief Unbind this texture array
+ * @param slot Texture unit
+ */
+void TextureArray::unbind(int slot){
+	glActiveTexture(GL_TEXTURE0 + slot);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+/**
+ * @brief Destructor for a Texture Array
+ */
+TextureArray::~TextureArray() {
+	glDeleteTextures(1, &this->id);
+}
+
+}
@@ -0,0 +1,43 @@
+/**
+ * @file TextureArray.h
+ * @brief Texture arrays, made of same-sized textures
+ */
+
+#ifndef TEXTUREARRAY_H_
+#define TEXTUREARRAY_H_
+
+// Includes OpenGL
+#include <GL/glew.h>
+
+// Own includes
+#include "Entity.h"
+#include "Texture.h"
+
+namespace AMG {
+
+/**
+ * @class TextureArray
+ * @brief A GL_TEXTURE_2D_ARRAY, where each layer is a *.dds file
+ * @note Materials reference a layer, so objects with different textures share a single bind
+ */
+class TextureArray : public Entity {
+private:
+	GLuint id;					/**< Texture OpenGL internal ID */
+	int width;					/**< Width of every layer, in pixels */
+	int height;					/**< Height of every layer, in pixels */
+	int nlayers;				/**< Number of layers */
+public:
+	GLuint getID(){ return id; }
+	int getWidth(){ return width; }
+	int getHeight(){ return height; }
+	int getNLayers(){ return nlayers; }
+
+	TextureArray(const char **paths, int nlayers, bool srgb=false);
+	void bind(int slot);
+	void unbind(int slot);
+	virtual ~TextureArray();
+};
+
+}
+
+#endif
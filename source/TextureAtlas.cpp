@@ -0,0 +1,130 @@
+/**
+ * @file TextureAtlas.cpp
+ * @brief Packs small textures in a single one, at runtime
+ */
+
+// Includes C/C++
+#include <stdlib.h>
+
+// Own includes
+#include "TextureAtlas.h"
+#include "Debug.h"
+
+namespace AMG {
+
+/**
+ * @brief Constructor for a Texture Atlas
+ * @param width Atlas width, in pixels (multiple of 4)
+ * @param height Atlas height, in pixels (multiple of 4)
+ * @note Video memory is allocated when the first texture is added, as it defines the format
+ */
+TextureAtlas::TextureAtlas(int width, int height){
+	this->id = 0;
+	this->width = width;
+	this->height = height;
+	this->format = 0;
+	this->nregions = 0;
+}
+
+/**
+ * @brief Allocate the atlas, with the format of a texture, used internally
+ * @param data First texture added
+ */
+void TextureAtlas::create(AMG_TextureData *data){
+	this->format = data->format;
+	glGenTextures(1, &this->id);
+	glBindTexture(GL_TEXTURE_2D, this->id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// Start with empty blocks, so the padding between regions is transparent
+	unsigned int size = (width / 4) * (height / 4) * data->blockSize;
+	unsigned char *blocks = (unsigned char*) calloc (size, sizeof(unsigned char));
+	glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, size, blocks);
+	free(blocks);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/**
+ * @brief Find room for a region, used internally
+ * @param w Region width, in pixels
+ * @param h Region height, in pixels
+ * @param x Output, left side of the region
+ * @param y Output, top side of the region
+ * @return Whether the region fits in the atlas
+ * @note The region goes in the lowest row it fits in, or in a new row below the last one
+ */
+bool TextureAtlas::allocate(int w, int h, int *x, int *y){
+	w += AMG_ATLAS_PADDING;
+	h += AMG_ATLAS_PADDING;
+	int best = -1;
+	for(unsigned int i=0;i<shelves.size();i++){
+		AMG_AtlasShelf &shelf = shelves[i];
+		if(h <= shelf.height && shelf.x + w <= width && (best == -1 || shelf.height < shelves[best].height))
+			best = i;
+	}
+	if(best == -1){
+		int top = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+		if(w > width || top + h > height) return false;
+		AMG_AtlasShelf shelf = {top, h, 0};
+		shelves.push_back(shelf);
+		best = shelves.size() - 1;
+	}
+	*x = shelves[best].x;
+	*y = shelves[best].y;
+	shelves[best].x += w;
+	return true;
+}
+
+/**
+ * @brief Add a texture to the atlas
+ * @param path Location of the texture (*.dds)
+ * @param srgb Is the color data in sRGB space?
+ * @return A texture referencing the region, or NULL if it doesn't fit or has another format
+ * @note The returned texture must be deleted before the atlas, and it can't be animated.
+ * Sizes which are not a multiple of 4 take whole compressed blocks, as they are stored in the file
+ */
+Texture *TextureAtlas::add(const char *path, bool srgb){
+	AMG_TextureData data;
+	int error = Texture::readTexture(path, srgb, &data);
+	if(error != NO_ERROR) Debug::showError(error, (void*)path);
+	if(id == 0) create(&data);
+
+	// Compressed regions are padded to whole blocks, so they stay aligned
+	int x, y;
+	int w = (data.width + 3) & ~3;
+	int h = (data.height + 3) & ~3;
+	if(data.format != format || !allocate(w, h, &x, &y)){
+		free(data.buffer);
+		return NULL;
+	}
+
+	// Upload the largest mip level
+	glBindTexture(GL_TEXTURE_2D, this->id);
+	glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, format, Texture::getLevelsSize(&data, 0, 0), data.buffer);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	free(data.buffer);
+
+	// Texture showing only the region, like a frame of a sprite sheet
+	Texture *texture = new Texture();
+	texture->id = this->id;
+	texture->isCopy = true;
+	texture->width = width;
+	texture->height = height;
+	texture->texScale = vec2(data.width / (float)width, data.height / (float)height);
+	texture->texPosition = vec4(x / (float)width, y / (float)height, x / (float)width, y / (float)height);
+	nregions++;
+	return texture;
+}
+
+/**
+ * @brief Destructor for a Texture Atlas
+ */
+TextureAtlas::~TextureAtlas() {
+	if(this->id) glDeleteTextures(1, &this->id);
+}
+
+}
@@ -0,0 +1,64 @@
+/**
+ * @file TextureAtlas.h
+ * @brief Packs small textures in a single one, at runtime
+ */
+
+#ifndef TEXTUREATLAS_H_
+#define TEXTUREATLAS_H_
+
+// Includes C/C++
+#include <vector>
+
+// Includes OpenGL
+#include <GL/glew.h>
+
+// Own includes
+#include "Entity.h"
+#include "Texture.h"
+
+// Defines
+#define AMG_ATLAS_SIZE 1024			/**< Default width and height of an atlas, in pixels */
+#define AMG_ATLAS_PADDING 4			/**< Empty space after each region, in pixels (one compressed block) */
+
+namespace AMG {
+
+/**
+ * @struct AMG_AtlasShelf
+ * @brief A row of regions in an atlas
+ */
+typedef struct{
+	int y;						/**< Top of the row, in pixels */
+	int height;					/**< Height of the row, in pixels */
+	int x;						/**< Where the next region goes, in pixels */
+}AMG_AtlasShelf;
+
+/**
+ * @class TextureAtlas
+ * @brief Compressed texture where small textures are packed in rows
+ * @note Only the largest mip level is kept, and every texture must have the format of the first one.
+ * Textures returned by add() reference a region of the atlas, so sprites using them share a single bind
+ */
+class TextureAtlas : public Entity {
+private:
+	GLuint id;									/**< Texture OpenGL internal ID, 0 until the first texture is added */
+	int width;									/**< Atlas width, in pixels */
+	int height;									/**< Atlas height, in pixels */
+	GLuint format;								/**< OpenGL compressed format */
+	int nregions;								/**< Number of textures added */
+	std::vector<AMG_AtlasShelf> shelves;		/**< Rows of regions, from top to bottom */
+	void create(AMG_TextureData *data);
+	bool allocate(int w, int h, int *x, int *y);
+public:
+	GLuint getID(){ return id; }
+	int getWidth(){ return width; }
+	int getHeight(){ return height; }
+	int getNRegions(){ return nregions; }
+
+	TextureAtlas(int width=AMG_ATLAS_SIZE, int height=AMG_ATLAS_SIZE);
+	Texture *add(const char *path, bool srgb=false);
+	virtual ~TextureAtlas();
+};
+
+}
+
+#endif
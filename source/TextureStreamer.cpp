@@ -0,0 +1,239 @@
+/**
+ * @file TextureStreamer.cpp
+ * @brief Streams the mip levels of textures, inside a video memory budget
+ */
+
+// Includes C/C++
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+// Own includes
+#include "TextureStreamer.h"
+#include "Debug.h"
+#include "UploadPool.h"
+#include "FileSystem.h"
+
+namespace AMG {
+
+// Static variables
+std::vector<Texture*> TextureStreamer::textures;
+long long TextureStreamer::budget = AMG_TEXTURE_BUDGET;
+long long TextureStreamer::used = 0;
+unsigned int TextureStreamer::frame = 0;
+unsigned int TextureStreamer::lastSerial = 0;
+bool TextureStreamer::enabled = false;
+
+/**
+ * @brief Constructor for a range of mip levels being loaded
+ * @param texture Streamed texture
+ * @param first First mip level to load
+ * @param last Last mip level to load
+ */
+MipLevelsAsset::MipLevelsAsset(Texture *texture, int first, int last) : Asset(texture->getStream()->path.c_str()) {
+	this->texture = texture;
+	this->serial = texture->getStream()->serial;
+	this->first = first;
+	this->last = last;
+	this->info = texture->getStream()->info;
+	this->buffer = NULL;
+	this->staging = -1;
+}
+
+/**
+ * @brief Read the mip levels from the file, on a loader thread
+ * @note The texture format was read when it was created, so only the levels are read here.
+ * They go straight into a staging buffer, if there is one free
+ */
+void MipLevelsAsset::read(){
+	unsigned int offset = AMG_DDS_HEADER + Texture::getLevelsSize(&info, 0, first - 1);
+	unsigned int size = Texture::getLevelsSize(&info, first, last);
+	buffer = UploadPool::acquire(size, &staging);
+	if(buffer == NULL) buffer = (unsigned char*) malloc (size);
+	if(FileSystem::read(path.c_str(), AMG_TEXTURE, buffer, offset, size) < 0) error = FILE_NOT_FOUND;
+}
+
+/**
+ * @brief Upload the mip levels, on the main thread
+ */
+void MipLevelsAsset::upload(){
+	UploadPool::begin(staging);
+	TextureStreamer::uploadLevels(texture, serial, first, last, (staging >= 0) ? NULL : buffer);
+	UploadPool::end(staging, Texture::getLevelsSize(&info, first, last));
+	if(staging < 0) free(buffer);
+	buffer = NULL;
+	staging = -1;
+}
+
+/**
+ * @brief Destructor for a range of mip levels
+ */
+MipLevelsAsset::~MipLevelsAsset(){
+	if(staging >= 0){
+		UploadPool::release(staging);
+	}else if(buffer){
+		free(buffer);
+	}
+}
+
+/**
+ * @brief Create a streamed texture, uploading only its mip tail
+ * @param path Location of the texture file (*.dds)
+ * @param srgb Load in sRGB format?
+ * @return The texture, its larger mip levels are loaded when needed
+ */
+Texture *TextureStreamer::load(const char *path, bool srgb){
+
+	// Read the header
+	AMG_TextureData data;
+	int error = Texture::readTextureHeader(path, srgb, &data);
+	if(error != NO_ERROR) Debug::showError(error, (void*)path);
+
+	// Find the mip tail, and read it
+	int tail = 0;
+	while(tail < data.nmips - 1 && glm::max(data.width >> tail, data.height >> tail) > AMG_TEXTURE_TAIL) tail ++;
+	data.firstMip = tail;
+	data.size = Texture::getLevelsSize(&data, tail, data.nmips - 1);
+	data.buffer = (unsigned char*) malloc (data.size);
+	FileSystem::read(path, AMG_TEXTURE, data.buffer, AMG_DDS_HEADER + Texture::getLevelsSize(&data, 0, tail - 1), data.size);
+
+	// Create the texture
+	Texture *texture = new Texture();
+	texture->create(&data);
+	free(data.buffer);
+	data.buffer = NULL;
+
+	// Start streaming it
+	AMG_TextureStream *stream = new AMG_TextureStream();
+	stream->path = path;
+	stream->info = data;
+	stream->tailMip = tail;
+	stream->residentMip = tail;
+	stream->wantedMip = tail;
+	stream->loadingMip = -1;
+	stream->lastUsed = frame;
+	stream->serial = ++lastSerial;
+	texture->stream = stream;
+	textures.push_back(texture);
+	used += data.size;
+	return texture;
+}
+
+/**
+ * @brief Start loading the mip levels needed on screen, called once per frame
+ * @note Textures request their levels with Texture::request when they are drawn
+ */
+void TextureStreamer::update(){
+	int started = 0;
+	for(unsigned int i=0;i<textures.size() && started < AMG_TEXTURE_REQUESTS;i++){
+		Texture *texture = textures[i];
+		AMG_TextureStream *stream = texture->stream;
+
+		// Only textures used in the last frame, which need larger levels
+		if(stream->lastUsed != frame || stream->loadingMip >= 0 || stream->wantedMip >= stream->residentMip) continue;
+
+		// Reserve the memory, evicting other levels if needed
+		long long size = Texture::getLevelsSize(&stream->info, stream->wantedMip, stream->residentMip - 1);
+		if(!makeRoom(size, texture)) continue;
+		used += size;
+
+		// Load the levels in the background
+		stream->loadingMip = stream->wantedMip;
+		AssetLoader::submit(std::shared_ptr<Asset>(new MipLevelsAsset(texture, stream->wantedMip, stream->residentMip - 1)));
+		started ++;
+	}
+	frame ++;
+}
+
+/**
+ * @brief Evict mip levels until there is enough room in the budget
+ * @param size Memory needed, in bytes
+ * @param except Texture which needs the memory, never evicted
+ * @return Whether there is enough room now
+ * @note Textures not used in the last frame can lose every level but the tail, the rest only
+ * lose the levels they don't need
+ */
+bool TextureStreamer::makeRoom(long long size, Texture *except){
+	if(used + size <= budget) return true;
+
+	// Sort the candidates, least recently used first
+	std::vector<Texture*> candidates;
+	for(unsigned int i=0;i<textures.size();i++){
+		AMG_TextureStream *stream = textures[i]->stream;
+		if(textures[i] != except && stream->loadingMip < 0 && stream->residentMip < stream->tailMip){
+			candidates.push_back(textures[i]);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](Texture *a, Texture *b){
+		return a->stream->lastUsed < b->stream->lastUsed;
+	});
+
+	// Evict their largest levels
+	for(unsigned int i=0;i<candidates.size() && used + size > budget;i++){
+		AMG_TextureStream *stream = candidates[i]->stream;
+		int limit = (stream->lastUsed == frame) ? stream->wantedMip : stream->tailMip;
+		while(used + size > budget && stream->residentMip < limit){
+			evict(candidates[i]);
+		}
+	}
+	return used + size <= budget;
+}
+
+/**
+ * @brief Evict the largest resident mip level of a texture
+ * @param texture The streamed texture
+ */
+void TextureStreamer::evict(Texture *texture){
+	AMG_TextureStream *stream = texture->stream;
+	int level = stream->residentMip;
+	glBindTexture(GL_TEXTURE_2D, texture->id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+	glCompressedTexImage2D(GL_TEXTURE_2D, level, stream->info.format, 0, 0, 0, 0, NULL);		// Release its memory
+	glBindTexture(GL_TEXTURE_2D, 0);
+	used -= Texture::getLevelsSize(&stream->info, level, level);
+	stream->residentMip = level + 1;
+}
+
+/**
+ * @brief Upload mip levels loaded in the background
+ * @param texture The streamed texture
+ * @param serial Serial number of the texture when the levels were requested
+ * @param first First mip level in the buffer
+ * @param last Last mip level in the buffer
+ * @param buffer Data of the mip levels, NULL if they are in the bound staging buffer
+ * @note The levels are discarded if the texture was deleted meanwhile. The serial number tells
+ * apart a new texture allocated at the same address
+ */
+void TextureStreamer::uploadLevels(Texture *texture, unsigned int serial, int first, int last, unsigned char *buffer){
+	if(std::find(textures.begin(), textures.end(), texture) == textures.end()) return;
+	AMG_TextureStream *stream = texture->stream;
+	if(stream->serial != serial || stream->loadingMip != first) return;
+
+	// Upload the levels, and let the texture sample them
+	AMG_TextureData data = stream->info;
+	data.firstMip = first;
+	data.nmips = last + 1;
+	data.buffer = buffer;
+	data.size = Texture::getLevelsSize(&data, first, last);
+	glBindTexture(GL_TEXTURE_2D, texture->id);
+	Texture::uploadTexture(&data, GL_TEXTURE_2D);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	stream->residentMip = first;
+	stream->loadingMip = -1;
+}
+
+/**
+ * @brief Stop streaming a texture, called when it is deleted
+ * @param texture The streamed texture
+ */
+void TextureStreamer::remove(Texture *texture){
+	std::vector<Texture*>::iterator it = std::find(textures.begin(), textures.end(), texture);
+	if(it == textures.end()) return;
+	AMG_TextureStream *stream = texture->stream;
+	int first = (stream->loadingMip >= 0) ? stream->loadingMip : stream->residentMip;
+	used -= Texture::getLevelsSize(&stream->info, first, stream->info.nmips - 1);
+	textures.erase(it);
+}
+
+}
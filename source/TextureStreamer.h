@@ -0,0 +1,76 @@
+/**
+ * @file TextureStreamer.h
+ * @brief Streams the mip levels of textures, inside a video memory budget
+ */
+
+#ifndef TEXTURESTREAMER_H_
+#define TEXTURESTREAMER_H_
+
+// Includes C/C++
+#include <vector>
+
+// Own includes
+#include "Texture.h"
+#include "AssetLoader.h"
+
+// Defines
+#define AMG_TEXTURE_BUDGET (256 * 1024 * 1024)		/**< Default video memory for streamed textures, in bytes */
+#define AMG_TEXTURE_TAIL 64							/**< Mip levels up to this size are always resident, in pixels */
+#define AMG_TEXTURE_REQUESTS 4						/**< Maximum number of loads started each frame */
+
+namespace AMG {
+
+/**
+ * @class MipLevelsAsset
+ * @brief Range of mip levels of a streamed texture, being loaded
+ */
+class MipLevelsAsset : public Asset {
+private:
+	Texture *texture;				/**< Streamed texture */
+	unsigned int serial;			/**< Serial number of the streamed texture, checked before uploading */
+	int first;						/**< First mip level to load */
+	int last;						/**< Last mip level to load */
+	AMG_TextureData info;			/**< Texture format, copied so the loader thread doesn't touch the texture */
+	unsigned char *buffer;			/**< Data read from the file */
+	int staging;					/**< UploadPool buffer which holds the data, -1 for client memory */
+	void read();
+	void upload();
+public:
+	MipLevelsAsset(Texture *texture, int first, int last);
+	virtual ~MipLevelsAsset();
+};
+
+/**
+ * @class TextureStreamer
+ * @brief Keeps the streamed textures inside a fixed video memory budget
+ * @note The mip tail is uploaded when the texture is created, and the larger levels are loaded
+ * in the background when the texture needs them on screen. When the budget is full, the largest
+ * levels of the least recently used textures are evicted
+ */
+class TextureStreamer {
+private:
+	static std::vector<Texture*> textures;		/**< Streamed textures */
+	static long long budget;					/**< Video memory budget, in bytes */
+	static long long used;						/**< Memory of the resident and loading mip levels, in bytes */
+	static unsigned int frame;					/**< Current frame number */
+	static unsigned int lastSerial;				/**< Serial number of the last streamed texture */
+	static bool enabled;						/**< Are the material textures streamed? */
+	TextureStreamer(){}
+	static bool makeRoom(long long size, Texture *except);
+	static void evict(Texture *texture);
+public:
+	static unsigned int getFrame(){ return frame; }
+	static long long getUsed(){ return used; }
+	static long long &getBudget(){ return budget; }
+	static bool &isEnabled(){ return enabled; }
+	static int getNTextures(){ return textures.size(); }
+
+	static Texture *load(const char *path, bool srgb=false);
+	static void update();
+	static void uploadLevels(Texture *texture, unsigned int serial, int first, int last, unsigned char *buffer);
+	static void remove(Texture *texture);
+};
+
+}
+
+#endif
@@ -0,0 +1,214 @@
+/**
+ * @file Transform.cpp
+ * @brief Position, rotation and scale of an element, with cached world matrices
+ */
+
+// Includes C/C++
+#include <algorithm>
+
+// Own includes
+#include "Transform.h"
+#include "Renderer.h"
+#include "Simd.h"
+
+namespace AMG {
+
+// Static variables
+std::vector<Transform*> Transform::transforms;
+bool Transform::sorted = true;
+std::mutex Transform::mutex;
+
+/**
+ * @brief Compare two transforms by hierarchy depth, parents go first
+ */
+static bool compareDepth(Transform *a, Transform *b){
+	return a->getDepth() < b->getDepth();
+}
+
+/**
+ * @brief Constructor for a Transform, identity by default
+ */
+Transform::Transform() {
+	this->position = vec3(0.0f, 0.0f, 0.0f);
+	this->rotation = quat(1, 0, 0, 0);
+	this->scale = vec3(1.0f, 1.0f, 1.0f);
+	this->worldMatrix = mat4(1.0f);
+	this->modelMatrix = mat4(1.0f);
+	this->parent = NULL;
+	this->depth = 0;
+	this->version = 0;
+	this->parentVersion = 0;
+	this->dirty = true;
+	this->zup = false;
+	std::lock_guard<std::mutex> lock(mutex);
+	this->index = transforms.size();
+	transforms.push_back(this);
+}
+
+/**
+ * @brief Attach this transform to a parent, so it moves along with it
+ * @param parent The new parent, NULL to detach it
+ * @note Trying to attach a transform to one of its own children does nothing
+ */
+void Transform::setParent(Transform *parent){
+	if(parent == this->parent) return;
+	for(Transform *t = parent; t; t = t->parent){
+		if(t == this) return;
+	}
+	if(this->parent){
+		std::vector<Transform*> &c = this->parent->children;
+		c.erase(std::remove(c.begin(), c.end(), this), c.end());
+	}
+	this->parent = parent;
+	if(parent) parent->children.push_back(this);
+	setDepth(parent ? parent->depth + 1 : 0);
+	this->dirty = true;
+	std::lock_guard<std::mutex> lock(mutex);
+	sorted = false;
+}
+
+/**
+ * @brief Update the depth of this transform and its children
+ * @param depth The new depth
+ */
+void Transform::setDepth(int depth){
+	this->depth = depth;
+	for(unsigned int i=0;i<children.size();i++){
+		children[i]->setDepth(depth + 1);
+	}
+}
+
+/**
+ * @brief Check whether the cached matrices are out of date
+ * @return Whether they need to be calculated again
+ * @note The parent must be up to date before calling this
+ */
+bool Transform::needsUpdate(){
+	return dirty || (parent && parent->version != parentVersion);
+}
+
+/**
+ * @brief Calculate the cached matrices, from the local transformation and the parent's world matrix
+ */
+void Transform::calculate(){
+
+	// Build translation * rotation * scale directly
+	mat3 r = glm::mat3_cast(rotation);
+	mat4 local;
+	local[0] = vec4(r[0] * scale.x, 0.0f);
+	local[1] = vec4(r[1] * scale.y, 0.0f);
+	local[2] = vec4(r[2] * scale.z, 0.0f);
+	local[3] = vec4(position, 1.0f);
+
+	// Concatenate with the parent
+	if(parent){
+		multiply(parent->worldMatrix, local, worldMatrix);
+		parentVersion = parent->version;
+	}else{
+		worldMatrix = local;
+	}
+	if(zup){
+		multiply(worldMatrix, Renderer::getZUpConversion(), modelMatrix);
+	}else{
+		modelMatrix = worldMatrix;
+	}
+
+	dirty = false;
+	version ++;
+}
+
+/**
+ * @brief Get the local to world matrix, calculating it if needed
+ * @return The world matrix
+ */
+mat4 &Transform::getWorldMatrix(){
+	if(parent) parent->getWorldMatrix();
+	if(needsUpdate()) calculate();
+	return worldMatrix;
+}
+
+/**
+ * @brief Get the matrix used to render, with the Z up conversion if it's enabled
+ * @return The model matrix
+ */
+mat4 &Transform::getModelMatrix(){
+	getWorldMatrix();
+	return modelMatrix;
+}
+
+/**
+ * @brief Get the position in world coordinates
+ * @return The world position
+ */
+vec3 Transform::getWorldPosition(){
+	return vec3(getWorldMatrix()[3]);
+}
+
+/**
+ * @brief Update the matrices of every changed transform at once
+ * @note Called once per frame by the Renderer, before drawing anything
+ */
+void Transform::updateAll(){
+	std::lock_guard<std::mutex> lock(mutex);
+	if(!sorted){
+		std::stable_sort(transforms.begin(), transforms.end(), compareDepth);
+		for(unsigned int i=0;i<transforms.size();i++){
+			transforms[i]->index = i;
+		}
+		sorted = true;
+	}
+	for(unsigned int i=0;i<transforms.size();i++){
+		Transform *t = transforms[i];
+		if(t->needsUpdate()) t->calculate();
+	}
+}
+
+/**
+ * @brief Multiply two 4x4 matrices
+ * @param a Left matrix
+ * @param b Right matrix
+ * @param result Where to store a * b, must not be a or b
+ */
+void Transform::multiply(const mat4 &a, const mat4 &b, mat4 &result){
+	const float *pa = &a[0][0];
+	const float *pb = &b[0][0];
+	float *pr = &result[0][0];
+	AMG_Float4 c0 = simdLoad(pa);
+	AMG_Float4 c1 = simdLoad(pa + 4);
+	AMG_Float4 c2 = simdLoad(pa + 8);
+	AMG_Float4 c3 = simdLoad(pa + 12);
+	for(int i=0;i<4;i++){
+		const float *col = pb + i*4;
+		AMG_Float4 r = simdMul(c0, simdSet(col[0]));
+		r = simdAdd(r, simdMul(c1, simdSet(col[1])));
+		r = simdAdd(r, simdMul(c2, simdSet(col[2])));
+		r = simdAdd(r, simdMul(c3, simdSet(col[3])));
+		simdStore(pr + i*4, r);
+	}
+}
+
+/**
+ * @brief Destructor for a Transform, its children become root transforms
+ */
+Transform::~Transform() {
+
+	// Swap-remove it, the list is sorted again on the next update
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		transforms[index] = transforms.back();
+		transforms[index]->index = index;
+		transforms.pop_back();
+		sorted = false;
+	}
+	if(parent){
+		std::vector<Transform*> &c = parent->children;
+		c.erase(std::remove(c.begin(), c.end(), this), c.end());
+	}
+	for(unsigned int i=0;i<children.size();i++){
+		children[i]->parent = NULL;
+		children[i]->setDepth(0);
+		children[i]->dirty = true;
+	}
+}
+
+}
@@ -0,0 +1,80 @@
+/**
+ * @file Transform.h
+ * @brief Position, rotation and scale of an element, with cached world matrices
+ */
+
+#ifndef TRANSFORM_H_
+#define TRANSFORM_H_
+
+// Includes C/C++
+#include <vector>
+#include <mutex>
+
+// Includes OpenGL
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+using namespace glm;
+
+namespace AMG {
+
+/**
+ * @class Transform
+ * @brief Holds a local transformation and caches its world matrix
+ * @note The world matrix is only recalculated when the transform or one of its parents changes.
+ * Transforms can be created and destroyed from JobSystem jobs, the list of transforms is locked.
+ * Parenting and the matrices must only be used from the main thread
+ */
+class Transform {
+private:
+	static std::vector<Transform*> transforms;	/**< Every transform, sorted by hierarchy depth */
+	static bool sorted;							/**< Is the transform list sorted? */
+	static std::mutex mutex;					/**< Protects the transform list */
+	vec3 position;								/**< Local position */
+	quat rotation;								/**< Local rotation */
+	vec3 scale;									/**< Local scale */
+	mat4 worldMatrix;							/**< Cached local to world matrix */
+	mat4 modelMatrix;							/**< Cached world matrix, including the Z up conversion */
+	Transform *parent;							/**< Parent transform, NULL for root transforms */
+	std::vector<Transform*> children;			/**< Child transforms */
+	int depth;									/**< Number of parents above this transform */
+	int index;									/**< Position in the transforms list */
+	unsigned int version;						/**< Incremented every time the world matrix changes */
+	unsigned int parentVersion;					/**< Parent version used for the cached world matrix */
+	bool dirty;									/**< Has the local transformation changed? */
+	bool zup;									/**< Append the Z up conversion to the model matrix? */
+	Transform(const Transform &t);
+	Transform &operator=(const Transform &t);
+	void setDepth(int depth);
+	bool needsUpdate();
+	void calculate();
+public:
+	/** @note get*() give write access and mark the transform as changed, use read*() to only read it */
+	vec3 &getPosition(){ dirty = true; return position; }
+	quat &getRotation(){ dirty = true; return rotation; }
+	vec3 &getScale(){ dirty = true; return scale; }
+	const vec3 &readPosition() const { return position; }
+	const quat &readRotation() const { return rotation; }
+	const vec3 &readScale() const { return scale; }
+	void setPosition(const vec3 &p){ position = p; dirty = true; }
+	void setRotation(const quat &r){ rotation = r; dirty = true; }
+	void setScale(const vec3 &s){ scale = s; dirty = true; }
+	void setZUp(bool zup){ this->zup = zup; dirty = true; }
+	void setDirty(){ dirty = true; }
+	Transform *getParent(){ return parent; }
+	int getDepth(){ return depth; }
+	unsigned int getVersion(){ return version; }
+
+	Transform();
+	void setParent(Transform *parent);
+	mat4 &getWorldMatrix();
+	mat4 &getModelMatrix();
+	vec3 getWorldPosition();
+	static void updateAll();
+	static void multiply(const mat4 &a, const mat4 &b, mat4 &result);
+	~Transform();
+};
+
+}
+
+#endif
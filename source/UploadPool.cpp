@@ -0,0 +1,194 @@
+/**
+ * @file UploadPool.cpp
+ * @brief Pool of pixel unpack buffers, filled by the loader threads
+ */
+
+// Includes C/C++
+#include <stddef.h>
+
+// Includes OpenGL
+#include <GLFW/glfw3.h>
+
+// Own includes
+#include "UploadPool.h"
+
+namespace AMG {
+
+// Static variables
+std::vector<AMG_StagingBuffer> UploadPool::buffers;
+std::vector<int> UploadPool::freeBuffers;
+std::vector<int> UploadPool::busyBuffers;
+std::mutex UploadPool::mutex;
+int UploadPool::bufferSize = 0;
+bool UploadPool::persistent = false;
+double UploadPool::startTime = 0.0;
+double UploadPool::uploadTime = 0.0;
+long long UploadPool::uploadedBytes = 0;
+long long UploadPool::clientBytes = 0;
+
+/**
+ * @brief Create the staging buffers
+ * @param count Number of buffers
+ * @param size Size of each buffer, in bytes
+ * @note Called by the Renderer, after creating the OpenGL context
+ */
+void UploadPool::initialize(int count, int size){
+
+	// If it was initialised
+	if(!buffers.empty()) return;
+
+	bufferSize = size;
+	persistent = GLEW_ARB_buffer_storage;
+	for(int i=0;i<count;i++){
+		AMG_StagingBuffer staging;
+		staging.data = NULL;
+		staging.fence = 0;
+		glGenBuffers(1, &staging.buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+		if(persistent){
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+			staging.data = (unsigned char*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+		}else{
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		}
+		buffers.push_back(staging);
+		map(i);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/**
+ * @brief Map a buffer for writing, and make it available to the loader threads
+ * @param index Buffer index
+ */
+void UploadPool::map(int index){
+	AMG_StagingBuffer &staging = buffers[index];
+	if(!persistent){
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+		staging.data = (unsigned char*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize, flags);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if(staging.data == NULL) return;
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	freeBuffers.push_back(index);
+}
+
+/**
+ * @brief Take a free buffer, to write texture data on it
+ * @param size Bytes to write
+ * @param index Buffer index (output), -1 if there was no buffer
+ * @return Where to write the data, NULL if no buffer is free or it is too small
+ * @note It can be called from any thread. If it fails, use client memory instead
+ */
+unsigned char *UploadPool::acquire(int size, int *index){
+	*index = -1;
+	std::lock_guard<std::mutex> lock(mutex);
+	if(freeBuffers.empty() || size > bufferSize) return NULL;
+	*index = freeBuffers.back();
+	freeBuffers.pop_back();
+	return buffers[*index].data;
+}
+
+/**
+ * @brief Give back a buffer which was not used
+ * @param index Buffer index
+ */
+void UploadPool::release(int index){
+	if(index < 0) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	freeBuffers.push_back(index);
+}
+
+/**
+ * @brief Start uploading from a buffer, binding it as the pixel unpack buffer
+ * @param index Buffer index, -1 if the data is in client memory
+ * @note Texture data pointers become offsets inside the buffer until end() is called
+ */
+void UploadPool::begin(int index){
+	startTime = glfwGetTime();
+	if(index < 0) return;
+	AMG_StagingBuffer &staging = buffers[index];
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+	if(!persistent){
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		staging.data = NULL;
+	}
+}
+
+/**
+ * @brief Finish uploading from a buffer, and fence it
+ * @param index Buffer index, -1 if the data was in client memory
+ * @param size Bytes uploaded
+ */
+void UploadPool::end(int index, int size){
+	if(index >= 0){
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		buffers[index].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		busyBuffers.push_back(index);
+		uploadedBytes += size;
+	}else{
+		clientBytes += size;
+	}
+	uploadTime += glfwGetTime() - startTime;
+}
+
+/**
+ * @brief Give the buffers which the GPU is done with back to the loader threads
+ * @note Called by the Renderer once per frame, it never waits
+ */
+void UploadPool::update(){
+	for(unsigned int i=0;i<busyBuffers.size();){
+		AMG_StagingBuffer &staging = buffers[busyBuffers[i]];
+		GLenum status = glClientWaitSync(staging.fence, 0, 0);
+		if(status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED){
+			glDeleteSync(staging.fence);
+			staging.fence = 0;
+			map(busyBuffers[i]);
+			busyBuffers[i] = busyBuffers.back();
+			busyBuffers.pop_back();
+		}else{
+			i ++;
+		}
+	}
+}
+
+/**
+ * @brief Get the upload throughput of the main thread
+ * @return Megabytes uploaded per second spent uploading
+ */
+double UploadPool::getThroughput(){
+	if(uploadTime <= 0.0) return 0.0;
+	return (uploadedBytes + clientBytes) / (1024.0 * 1024.0) / uploadTime;
+}
+
+/**
+ * @brief Reset the upload statistics
+ */
+void UploadPool::resetStats(){
+	uploadTime = 0.0;
+	uploadedBytes = 0;
+	clientBytes = 0;
+}
+
+/**
+ * @brief Delete the staging buffers
+ */
+void UploadPool::finish(){
+	for(unsigned int i=0;i<buffers.size();i++){
+		AMG_StagingBuffer &staging = buffers[i];
+		if(staging.fence) glDeleteSync(staging.fence);
+		if(staging.data){
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		glDeleteBuffers(1, &staging.buffer);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	buffers.clear();
+	freeBuffers.clear();
+	busyBuffers.clear();
+}
+
+}
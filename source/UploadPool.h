@@ -0,0 +1,72 @@
+/**
+ * @file UploadPool.h
+ * @brief Pool of pixel unpack buffers, filled by the loader threads
+ */
+
+#ifndef UPLOADPOOL_H_
+#define UPLOADPOOL_H_
+
+// Includes C/C++
+#include <mutex>
+#include <vector>
+
+// Includes OpenGL
+#include <GL/glew.h>
+
+// Defines
+#define AMG_UPLOAD_BUFFERS 4					/**< Default number of staging buffers */
+#define AMG_UPLOAD_SIZE (8 * 1024 * 1024)		/**< Default size of each staging buffer, in bytes */
+
+namespace AMG {
+
+/**
+ * @struct AMG_StagingBuffer
+ * @brief Pixel unpack buffer used to upload textures
+ */
+typedef struct{
+	GLuint buffer;				/**< OpenGL buffer */
+	unsigned char *data;		/**< Mapped memory, NULL while the GPU owns the buffer */
+	GLsync fence;				/**< Signaled when the GPU is done with the buffer */
+}AMG_StagingBuffer;
+
+/**
+ * @class UploadPool
+ * @brief Staging buffers which the loader threads write directly, so the main thread only
+ * issues the copies
+ * @note The free buffers are always mapped, persistently when ARB_buffer_storage is available.
+ * Once used, a buffer is fenced, and it is mapped again when the fence is signaled
+ */
+class UploadPool {
+private:
+	static std::vector<AMG_StagingBuffer> buffers;	/**< Staging buffers */
+	static std::vector<int> freeBuffers;			/**< Buffers ready to be written */
+	static std::vector<int> busyBuffers;			/**< Buffers waiting for their fence */
+	static std::mutex mutex;						/**< Protects the free buffers */
+	static int bufferSize;							/**< Size of each buffer, in bytes */
+	static bool persistent;							/**< Are the buffers mapped forever? */
+	static double startTime;						/**< Start of the upload being measured */
+	static double uploadTime;						/**< Time spent by the main thread on uploads, in seconds */
+	static long long uploadedBytes;					/**< Bytes uploaded through staging buffers */
+	static long long clientBytes;					/**< Bytes uploaded from client memory, when no buffer was free */
+	UploadPool(){}
+	static void map(int index);
+public:
+	static int getBufferSize(){ return bufferSize; }
+	static double getStallTime(){ return uploadTime * 1000.0; }
+	static long long getUploadedBytes(){ return uploadedBytes; }
+	static long long getClientBytes(){ return clientBytes; }
+	static double getThroughput();
+
+	static void initialize(int count=AMG_UPLOAD_BUFFERS, int size=AMG_UPLOAD_SIZE);
+	static unsigned char *acquire(int size, int *index);
+	static void release(int index);
+	static void begin(int index);
+	static void end(int index, int size);
+	static void update();
+	static void resetStats();
+	static void finish();
+};
+
+}
+
+#endif
@@ -3,11 +3,27 @@
  * @brief Physics worlds with Bullet Physics
  */
 
+// Includes C/C++
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
 // Includes Bullet
 #include <BulletCollision/CollisionShapes/btShapeHull.h>
+#include <BulletCollision/CollisionShapes/btUniformScalingShape.h>
+#include <BulletCollision/CollisionShapes/btScaledBvhTriangleMeshShape.h>
+#include <BulletCollision/CollisionShapes/btCompoundShape.h>
+#ifdef BT_THREADSAFE
+#include <LinearMath/btThreads.h>
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#endif
 
 // Own includes
 #include "Renderer.h"
+#include "JobSystem.h"
 #include "Debug.h"
 #include "World.h"
 
@@ -15,132 +31,700 @@ namespace AMG {
 
 /**
  * @brief Constructor for a World
+ * @param threaded Run the simulation on its own thread, while the next frame is rendered?
+ * @param multithreaded Use Bullet's multithreaded world and solver? Only if Bullet was built with BT_THREADSAFE
  */
-World::World() {
+World::World(bool threaded, bool multithreaded) {
 	collisionConfiguration = new btDefaultCollisionConfiguration();
-	dispatcher = new btCollisionDispatcher(collisionConfiguration);
-	broadphase = new btDbvtBroadphase();
-	solver = new btSequentialImpulseConstraintSolver;
-	dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration);
+	broadphase = new BulkBroadphase();
+	solverPool = NULL;
+#ifdef BT_THREADSAFE
+	if(multithreaded){
+		if(btGetTaskScheduler() == NULL) btSetTaskScheduler(btCreateDefaultTaskScheduler());
+		dispatcher = new btCollisionDispatcherMt(collisionConfiguration);
+		solver = new btSequentialImpulseConstraintSolverMt();
+		btConstraintSolverPoolMt *pool = new btConstraintSolverPoolMt(btGetTaskScheduler()->getNumThreads());
+		dynamicsWorld = new btDiscreteDynamicsWorldMt(dispatcher, broadphase, pool, solver, collisionConfiguration);
+		solverPool = pool;
+	}else
+#endif
+	{
+		dispatcher = new btCollisionDispatcher(collisionConfiguration);
+		solver = new btSequentialImpulseConstraintSolver;
+		dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration);
+	}
 	dynamicsWorld->setGravity(btVector3(0, -9.81f, 0));
-	objects = std::tr1::unordered_map<Object*, btCollisionObject*>();
+	dynamicsWorld->setForceUpdateAllAabbs(false);
+	bodies = std::vector<btRigidBody*>();
+	bulkStart = -1;
 	shapes = std::vector<btCollisionShape*>();
+	shapeCache = std::tr1::unordered_map<std::string, btCollisionShape*>();
+	moved = std::vector<MotionState*>();
+
+	// Start the physics thread
+	this->threaded = threaded;
+	this->running = threaded;
+	this->stepping = false;
+	this->stepDelta = 0.0f;
+	this->fixedStep = 1.0f / AMG_PHYSICS_RATE;
+	if(threaded) thread = std::thread(threadLoop, this);
+}
+
+/**
+ * @brief Main loop of the physics thread
+ * @param world World to simulate
+ */
+void World::threadLoop(World *world){
+	std::unique_lock<std::mutex> lock(world->mutex);
+	while(true){
+		world->condition.wait(lock, [world]{ return !world->running || world->stepping; });
+		if(!world->running) return;
+		lock.unlock();
+		world->simulate(world->stepDelta);
+		lock.lock();
+		world->stepping = false;
+		world->condition.notify_all();
+	}
+}
+
+/**
+ * @brief Run the fixed steps needed to advance some time
+ * @param delta Time to advance
+ * @note Bullet keeps the remaining time, and interpolates the poses written to the motion states
+ */
+void World::simulate(float delta){
+	dynamicsWorld->stepSimulation(delta, AMG_PHYSICS_MAX_STEPS, fixedStep);
+}
+
+/**
+ * @brief Wait until the physics thread finishes the current step
+ */
+void World::wait(){
+	if(!threaded) return;
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this]{ return !stepping; });
+}
+
+/**
+ * @brief Write the poses of the moved bodies into their Object transforms
+ * @note The physics thread must be idle
+ */
+void World::sync(){
+	for(unsigned int i=0;i<moved.size();i++){
+		moved[i]->apply();
+	}
+	moved.clear();
+}
+
+/**
+ * @brief Store the Object poses of the kinematic bodies, to be read by the next step
+ * @note The physics thread must be idle
+ */
+void World::snapshot(){
+	for(unsigned int i=0;i<kinematics.size();i++){
+		((MotionState*)kinematics[i]->getMotionState())->snapshot();
+	}
+}
+
+/**
+ * @brief Set the number of fixed simulation steps per second
+ * @param rate Steps per second
+ */
+void World::setRate(float rate){
+	wait();
+	if(rate > 0.0f) fixedStep = 1.0f / rate;
+}
+
+/**
+ * @brief Find a shared collision shape
+ * @param key Shape parameters
+ * @return The shape, NULL if it was not created yet
+ */
+btCollisionShape *World::findShape(const char *key){
+	std::tr1::unordered_map<std::string, btCollisionShape*>::const_iterator got = shapeCache.find(key);
+	if(got != shapeCache.end()){
+		return got->second;
+	}
+	return NULL;
+}
+
+/**
+ * @brief Share a collision shape, owned by this World
+ * @param key Shape parameters
+ * @param shape The collision shape
+ * @return The same shape
+ */
+btCollisionShape *World::storeShape(const char *key, btCollisionShape *shape){
+	shapeCache[key] = shape;
+	shapes.push_back(shape);
+	return shape;
+}
+
+/**
+ * @brief Get the scaled bounding box extents of an Object
+ * @param obj The Object
+ * @return The extents, converted to Y up like the rest of the physics world
+ * @note The conversion is applied before the scale, as in the model matrix
+ */
+vec3 World::getExtents(Object *obj){
+	vec3 extents = glm::abs(mat3(Renderer::getZUpConversion()) * obj->getBBox());
+	return extents * obj->getTransform().readScale();
 }
 
 /**
  * @brief Add an Object to this world, in a Box shape
  * @param obj Object to be added
  * @param mass Mass for this object
+ * @note Objects with the same scaled extents share the shape
  */
 void World::addObjectBox(Object *obj, float mass){
-	vec3 &bbox = obj->getBBox();
-	btCollisionShape* shape = new btBoxShape(btVector3(bbox.x, bbox.y, bbox.z));
-	addObject(obj, mass, shape);
+	char key[128];
+	vec3 extents = getExtents(obj);
+	sprintf(key, "box %g %g %g", extents.x, extents.y, extents.z);
+	btCollisionShape *shape = findShape(key);
+	if(shape == NULL) shape = storeShape(key, new btBoxShape(btVector3(extents.x, extents.y, extents.z)));
+	addBody(obj, mass, shape);
 }
 
 /**
  * @brief Add an Object to this world, in a Sphere shape
  * @param obj Object to be added
  * @param mass Mass for this object
+ * @note Objects with the same scaled radius share the shape
  */
 void World::addObjectSphere(Object *obj, float mass){
-	vec3 &bbox = obj->getBBox();
-	btCollisionShape* shape = new btSphereShape(bbox.x);
-	addObject(obj, mass, shape);
+	char key[128];
+	float radius = getExtents(obj).x;
+	sprintf(key, "sphere %g", radius);
+	btCollisionShape *shape = findShape(key);
+	if(shape == NULL) shape = storeShape(key, new btSphereShape(radius));
+	addBody(obj, mass, shape);
+}
+
+/**
+ * @brief Get the unscaled convex hull of an Object's mesh
+ * @param obj Object to get the mesh from
+ * @return The hull, shared by every Object with the same vertices
+ * @note Hulls are cached on disk by mesh hash and Z up conversion, so they are only built once
+ */
+btConvexHullShape *World::getHull(Object *obj){
+	float *data = obj->getVertices();
+	if(data == NULL){
+		Debug::showError(NO_VERTEX_DATA, NULL);
+	}
+
+	// Already built for this World?
+	char name[64];
+	int nvertices = obj->getNVertices();
+	mat4 &zup = Renderer::getZUpConversion();
+	unsigned long long h = Entity::hash(data, nvertices * 3 * sizeof(float));
+	h = Entity::hash(&zup[0][0], sizeof(mat4), h);
+	sprintf(name, "%08x%08x.hull", (unsigned int)(h >> 32), (unsigned int)h);
+	btConvexHullShape *shape = (btConvexHullShape*) findShape(name);
+	if(shape) return shape;
+
+	// Load it from the disk cache
+	FILE *f = Entity::openCacheFile(name, false);
+	if(f){
+		int n = 0;
+		if(fread(&n, sizeof(int), 1, f) == 1 && n > 0){
+			float *points = (float*) malloc (n * 3 * sizeof(float));
+			if(fread(points, sizeof(float), n * 3, f) == (size_t)(n * 3)){
+				shape = new btConvexHullShape(points, n, 3 * sizeof(float));
+			}
+			free(points);
+		}
+		fclose(f);
+	}
+
+	// Or build it from the vertices converted to Y up, and save it
+	if(shape == NULL){
+		std::vector<float> vertices(nvertices * 3);
+		for(int i=0;i<nvertices;i++){
+			vec4 v = zup * vec4(data[i*3], data[i*3+1], data[i*3+2], 1.0f);
+			vertices[i*3] = v.x;
+			vertices[i*3+1] = v.y;
+			vertices[i*3+2] = v.z;
+		}
+		btConvexHullShape *convexHullShape = new btConvexHullShape(&vertices[0], nvertices, 3 * sizeof(float));
+		convexHullShape->setMargin(0);
+		btShapeHull* hull = new btShapeHull(convexHullShape);
+		hull->buildHull(0);
+		shape = new btConvexHullShape((const btScalar*)hull->getVertexPointer(), hull->numVertices(), sizeof(btVector3));
+		f = Entity::openCacheFile(name, true);
+		if(f){
+			int n = hull->numVertices();
+			fwrite(&n, sizeof(int), 1, f);
+			for(int i=0;i<n;i++){
+				const btVector3 &p = hull->getVertexPointer()[i];
+				float point[3] = {p.x(), p.y(), p.z()};
+				fwrite(point, sizeof(float), 3, f);
+			}
+			fclose(f);
+		}
+		delete hull;
+		delete convexHullShape;
+	}
+
+	storeShape(name, shape);
+	return shape;
+}
+
+/**
+ * @brief Get a shared hull with a scale applied
+ * @param hull Unscaled hull
+ * @param scale Scale to apply
+ * @return The scaled shape, shared by every Object with the same hull and scale
+ * @note Uniform scales wrap the hull in a btUniformScalingShape, other scales get
+ * a scaled copy of its points
+ */
+btCollisionShape *World::getScaledHull(btConvexHullShape *hull, const vec3 &scale){
+	if(scale.x == 1.0f && scale.y == 1.0f && scale.z == 1.0f) return hull;
+
+	// Find or create the scaled shape
+	char key[128];
+	bool uniform = (scale.x == scale.y && scale.y == scale.z);
+	if(uniform){
+		sprintf(key, "%p %g", (void*)hull, scale.x);
+	}else{
+		sprintf(key, "%p %g %g %g", (void*)hull, scale.x, scale.y, scale.z);
+	}
+	btCollisionShape *shape = findShape(key);
+	if(shape == NULL){
+		if(uniform){
+			shape = new btUniformScalingShape(hull, scale.x);
+		}else{
+			shape = new btConvexHullShape((const btScalar*)hull->getUnscaledPoints(), hull->getNumPoints(), sizeof(btVector3));
+			shape->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
+		}
+		storeShape(key, shape);
+	}
+	return shape;
 }
 
 /**
  * @brief Add an Object to this world, in a Convex Hull shape
  * @param obj Object to be added
  * @param mass Mass for this object
+ * @note The hull is shared by every Object with the same mesh and scale
  */
 void World::addObjectConvexHull(Object *obj, float mass){
+	wait();
+	btConvexHullShape *hull = getHull(obj);
+	addBody(obj, mass, getScaledHull(hull, obj->getTransform().readScale()));
+}
+
+/**
+ * @brief Get the approximate convex decomposition of an Object's mesh
+ * @param obj Object to get the mesh from
+ * @param maxHulls Maximum number of hulls
+ * @return A compound of hulls, shared by every Object with the same mesh
+ * @note Decompositions are cached on disk by mesh hash and Z up conversion, so they are only computed once
+ */
+btCompoundShape *World::getDecomposition(Object *obj, int maxHulls){
 	float *data = obj->getVertices();
-	if(data == NULL){
+	unsigned short *indices = obj->getIndices();
+	if(data == NULL || indices == NULL){
 		Debug::showError(NO_VERTEX_DATA, NULL);
 	}
 
-	btConvexHullShape *convexHullShape = new btConvexHullShape(data, obj->getNVertices(), 3 * sizeof(float));
-	convexHullShape->setMargin(0);
-	btShapeHull* hull = new btShapeHull(convexHullShape);
-	hull->buildHull(0);
-	btConvexHullShape* pConvexHullShape = new btConvexHullShape((const btScalar*)hull->getVertexPointer(), hull->numVertices(), sizeof(btVector3));
-	addObject(obj, mass, pConvexHullShape);
-	delete hull;
-	delete convexHullShape;
+	// Already computed for this World?
+	char name[64];
+	int nvertices = obj->getNVertices();
+	int nindices = obj->getNIndices();
+	unsigned long long h = Entity::hash(data, nvertices * 3 * sizeof(float));
+	h = Entity::hash(indices, nindices * sizeof(unsigned short), h);
+	h = Entity::hash(&maxHulls, sizeof(int), h);
+	mat4 &zup = Renderer::getZUpConversion();
+	h = Entity::hash(&zup[0][0], sizeof(mat4), h);
+	sprintf(name, "%08x%08x.hacd", (unsigned int)(h >> 32), (unsigned int)h);
+	btCompoundShape *compound = (btCompoundShape*) findShape(name);
+	if(compound) return compound;
+
+	// Load the hulls from the disk cache
+	std::vector<std::vector<float> > hulls;
+	FILE *f = Entity::openCacheFile(name, false);
+	if(f){
+		int nhulls = 0;
+		if(fread(&nhulls, sizeof(int), 1, f) == 1){
+			for(int i=0;i<nhulls;i++){
+				int n = 0;
+				if(fread(&n, sizeof(int), 1, f) != 1 || n <= 0) break;
+				std::vector<float> points(n * 3);
+				if(fread(&points[0], sizeof(float), n * 3, f) != (size_t)(n * 3)) break;
+				hulls.push_back(points);
+			}
+			if((int)hulls.size() != nhulls) hulls.clear();
+		}
+		fclose(f);
+	}
+
+	// Or compute them, with the vertices converted to Y up like the rest of the physics world
+	if(hulls.empty()){
+		std::vector<float> vertices(nvertices * 3);
+		for(int i=0;i<nvertices;i++){
+			vec4 v = zup * vec4(data[i*3], data[i*3+1], data[i*3+2], 1.0f);
+			vertices[i*3] = v.x;
+			vertices[i*3+1] = v.y;
+			vertices[i*3+2] = v.z;
+		}
+		ConvexDecomposition decomposition(&vertices[0], nvertices, indices, nindices);
+		decomposition.compute(maxHulls);
+		for(int i=0;i<decomposition.getNHulls();i++){
+			if(decomposition.getHull(i).size() >= 3) hulls.push_back(decomposition.getHull(i));
+		}
+		f = Entity::openCacheFile(name, true);
+		if(f){
+			int nhulls = hulls.size();
+			fwrite(&nhulls, sizeof(int), 1, f);
+			for(int i=0;i<nhulls;i++){
+				int n = hulls[i].size() / 3;
+				fwrite(&n, sizeof(int), 1, f);
+				fwrite(&hulls[i][0], sizeof(float), n * 3, f);
+			}
+			fclose(f);
+		}
+	}
+
+	// Build the compound, its hulls are owned by the World
+	compound = new btCompoundShape();
+	btTransform identity;
+	identity.setIdentity();
+	for(unsigned int i=0;i<hulls.size();i++){
+		btConvexHullShape *hull = new btConvexHullShape(&hulls[i][0], hulls[i].size() / 3, 3 * sizeof(float));
+		shapes.push_back(hull);
+		compound->addChildShape(identity, hull);
+	}
+	storeShape(name, compound);
+	return compound;
 }
 
 /**
- * @brief Add an Object to this world
+ * @brief Add an Object to this world, as a compound of convex hulls which approximates its mesh
  * @param obj Object to be added
  * @param mass Mass for this object
- * @param shape Collision shape for this new object
+ * @param maxHulls Maximum number of hulls
+ * @note Meant for concave dynamic bodies, it's much cheaper than a triangle mesh. The
+ * decomposition is computed on the JobSystem the first time, and then loaded from the disk cache
  */
-void World::addObject(Object *obj, float mass, btCollisionShape *shape){
+void World::addObjectDecomposition(Object *obj, float mass, int maxHulls){
+	wait();
+	btCompoundShape *compound = getDecomposition(obj, maxHulls);
+	const vec3 &scale = obj->getTransform().readScale();
+	if(scale.x == 1.0f && scale.y == 1.0f && scale.z == 1.0f){
+		addBody(obj, mass, compound);
+		return;
+	}
+
+	// Find or create the scaled compound, made of scaled hulls
+	char key[128];
+	sprintf(key, "%p %g %g %g", (void*)compound, scale.x, scale.y, scale.z);
+	btCollisionShape *shape = findShape(key);
+	if(shape == NULL){
+		btCompoundShape *scaled = new btCompoundShape();
+		btTransform identity;
+		identity.setIdentity();
+		for(int i=0;i<compound->getNumChildShapes();i++){
+			btConvexHullShape *hull = (btConvexHullShape*) compound->getChildShape(i);
+			scaled->addChildShape(identity, getScaledHull(hull, scale));
+		}
+		shape = storeShape(key, scaled);
+	}
+	addBody(obj, mass, shape);
+}
 
-	vec3 &position = obj->getPosition();
-	vec3 &scale = obj->getScale();
-	quat &rot = obj->getRotation();
+/**
+ * @brief Open the BVH file of a triangle mesh
+ * @param obj Object the mesh belongs to
+ * @param key Name of the mesh in the cache
+ * @param write Open it for writing? Otherwise it's opened for reading
+ * @return The opened file, NULL if it could not be opened
+ * @note It's a loose file next to the model ("model.amd.N.bvh") both for reading and writing, so
+ * it's found even when a pack is mounted. Objects not loaded from a model use the cache folder
+ */
+static FILE *openBvhFile(Object *obj, const char *key, bool write){
+	if(obj->getSource().empty()) return Entity::openCacheFile(key, write);
+	char name[256];
+	snprintf(name, sizeof(name), "%s.bvh", obj->getSource().c_str());
+	return fopen(Entity::getFullPath(name, AMG_MODEL), write ? "wb" : "rb");
+}
 
+/**
+ * @brief Get the unscaled triangle mesh shape of an Object, with its BVH
+ * @param obj Object to get the mesh from
+ * @return The mesh shape, shared by every Object with the same mesh
+ * @note The quantized BVH is saved next to the model file ("model.amd.N.bvh"),
+ * or in the cache folder for objects not loaded from a model
+ */
+btBvhTriangleMeshShape *World::getTriangleMesh(Object *obj){
+	float *data = obj->getVertices();
+	unsigned short *indices = obj->getIndices();
+	if(data == NULL || indices == NULL){
+		Debug::showError(NO_VERTEX_DATA, NULL);
+	}
+
+	// Already built for this World?
+	char key[64];
+	int nvertices = obj->getNVertices();
+	int nindices = obj->getNIndices();
+	unsigned long long h = Entity::hash(data, nvertices * 3 * sizeof(float));
+	h = Entity::hash(indices, nindices * sizeof(unsigned short), h);
+	sprintf(key, "%08x%08x.bvh", (unsigned int)(h >> 32), (unsigned int)h);
+	btBvhTriangleMeshShape *shape = (btBvhTriangleMeshShape*) findShape(key);
+	if(shape) return shape;
+
+	// Copy the vertices, converted to Y up like the rest of the physics world
+	btScalar *vertices = (btScalar*) btAlignedAlloc(nvertices * 3 * sizeof(btScalar), 16);
+	mat4 &zup = Renderer::getZUpConversion();
+	for(int i=0;i<nvertices;i++){
+		vec4 v = zup * vec4(data[i*3], data[i*3+1], data[i*3+2], 1.0f);
+		vertices[i*3] = v.x;
+		vertices[i*3+1] = v.y;
+		vertices[i*3+2] = v.z;
+	}
+	meshBuffers.push_back(vertices);
+
+	// Copy the indices too, the shape can outlive the Object
+	unsigned short *triangles = (unsigned short*) btAlignedAlloc(nindices * sizeof(unsigned short), 16);
+	memcpy(triangles, indices, nindices * sizeof(unsigned short));
+	meshBuffers.push_back(triangles);
+
+	// Describe the mesh
+	btIndexedMesh part;
+	part.m_numTriangles = nindices / 3;
+	part.m_triangleIndexBase = (const unsigned char*) triangles;
+	part.m_triangleIndexStride = 3 * sizeof(unsigned short);
+	part.m_numVertices = nvertices;
+	part.m_vertexBase = (const unsigned char*) vertices;
+	part.m_vertexStride = 3 * sizeof(btScalar);
+	part.m_indexType = PHY_SHORT;
+	part.m_vertexType = (sizeof(btScalar) == sizeof(float)) ? PHY_FLOAT : PHY_DOUBLE;
+	btTriangleIndexVertexArray *mesh = new btTriangleIndexVertexArray();
+	mesh->addIndexedMesh(part, PHY_SHORT);
+	meshes.push_back(mesh);
+
+	// Load the BVH, if it was saved for this same mesh
+	FILE *f = openBvhFile(obj, key, false);
+	if(f){
+		fseek(f, 0, SEEK_END);
+		int fileSize = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		char *file = (char*) malloc (fileSize > 0 ? fileSize : 1);
+		if(fileSize <= 0 || fread(file, 1, fileSize, f) != (size_t)fileSize) fileSize = 0;
+		fclose(f);
+		const int headerSize = 4 + sizeof(unsigned long long) + sizeof(unsigned int);
+		unsigned long long fileHash = 0;
+		unsigned int size = 0;
+		if(fileSize >= headerSize){
+			memcpy(&fileHash, file + 4, sizeof(unsigned long long));
+			memcpy(&size, file + 4 + sizeof(unsigned long long), sizeof(unsigned int));
+		}
+		if(fileSize >= headerSize && memcmp(file, "ABVH", 4) == 0 && fileHash == h
+				&& size > 0 && size <= (unsigned int)(fileSize - headerSize)){
+			void *buffer = btAlignedAlloc(size, 16);
+			memcpy(buffer, file + headerSize, size);
+			btOptimizedBvh *bvh = btOptimizedBvh::deSerializeInPlace(buffer, size, false);
+			if(bvh){
+				shape = new btBvhTriangleMeshShape(mesh, true, false);
+				shape->setOptimizedBvh(bvh);
+				meshBuffers.push_back(buffer);
+			}else{
+				btAlignedFree(buffer);
+			}
+		}
+		free(file);
+	}
+
+	// Or build it and save it
+	if(shape == NULL){
+		shape = new btBvhTriangleMeshShape(mesh, true, true);
+		btOptimizedBvh *bvh = shape->getOptimizedBvh();
+		unsigned int size = bvh->calculateSerializeBufferSize();
+		void *buffer = btAlignedAlloc(size, 16);
+		if(bvh->serializeInPlace(buffer, size, false)){
+			f = openBvhFile(obj, key, true);
+			if(f){
+				fwrite("ABVH", sizeof(char), 4, f);
+				fwrite(&h, sizeof(unsigned long long), 1, f);
+				fwrite(&size, sizeof(unsigned int), 1, f);
+				fwrite(buffer, 1, size, f);
+				fclose(f);
+			}
+		}
+		btAlignedFree(buffer);
+	}
+
+	storeShape(key, shape);
+	return shape;
+}
+
+/**
+ * @brief Add a static Object to this world, colliding with its exact triangle mesh
+ * @param obj Object to be added
+ * @note Meant for level geometry, triangle meshes can't be dynamic. Non-unit scales use
+ * a btScaledBvhTriangleMeshShape, so the BVH is shared and never rebuilt
+ */
+void World::addObjectTriangleMesh(Object *obj){
+	wait();
+	btBvhTriangleMeshShape *mesh = getTriangleMesh(obj);
+	const vec3 &scale = obj->getTransform().readScale();
+	if(scale.x == 1.0f && scale.y == 1.0f && scale.z == 1.0f){
+		addBody(obj, 0.0f, mesh);
+		return;
+	}
+
+	// Find or create the scaled shape
+	char key[128];
+	sprintf(key, "%p %g %g %g", (void*)mesh, scale.x, scale.y, scale.z);
+	btCollisionShape *shape = findShape(key);
+	if(shape == NULL) shape = storeShape(key, new btScaledBvhTriangleMeshShape(mesh, btVector3(scale.x, scale.y, scale.z)));
+	addBody(obj, 0.0f, shape);
+}
+
+/**
+ * @brief Add an Object to this world
+ * @param obj Object to be added
+ * @param mass Mass for this object
+ * @param shape Collision shape for this new object, owned by the World
+ * @note The shape is scaled with the Object, so it can't be shared
+ */
+void World::addObject(Object *obj, float mass, btCollisionShape *shape){
+	wait();
+	const vec3 &scale = obj->getTransform().readScale();
 	shape->setLocalScaling(btVector3(scale.x, scale.y, scale.z));
 	shapes.push_back(shape);
+	addBody(obj, mass, shape);
+}
 
-	btTransform transform;
-	transform.setIdentity();
-	transform.setOrigin(btVector3(position.x, position.y, position.z));
-	transform.setRotation(btQuaternion(rot.x, rot.y, rot.z, rot.w));
+/**
+ * @brief Create the rigid body for an Object
+ * @param obj Object to be added
+ * @param mass Mass for this object
+ * @param shape Collision shape, already scaled
+ */
+void World::addBody(Object *obj, float mass, btCollisionShape *shape){
 
+	wait();
 	btVector3 localInertia(0, 0, 0);
 	if(mass != 0.0f)
 		shape->calculateLocalInertia(mass, localInertia);
 
-	btDefaultMotionState* motionState = new btDefaultMotionState(transform);
+	MotionState* motionState = new MotionState(&obj->getTransform(), &moved);
 	btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, motionState, shape, localInertia);
 	btRigidBody* body = new btRigidBody(rbInfo);
 	body->setUserPointer(obj);
 
-	dynamicsWorld->addRigidBody(body);
-	objects[obj] = body;
+	// Bodies added in bulk enter the simulation in endBulk()
+	obj->getBodyIndex() = bodies.size();
+	bodies.push_back(body);
+	if(body->isKinematicObject()) kinematics.push_back(body);
+	if(bulkStart < 0) dynamicsWorld->addRigidBody(body);
+}
+
+/**
+ * @brief Start adding many Objects at once
+ * @note The added bodies are not simulated until endBulk() is called
+ */
+void World::beginBulk(){
+	wait();
+	if(bulkStart < 0) bulkStart = bodies.size();
+}
+
+/**
+ * @brief Add the Objects since beginBulk() to the simulation, and rebuild the broadphase tree in one pass
+ */
+void World::endBulk(){
+	wait();
+	if(bulkStart < 0) return;
+	broadphase->begin();
+	for(unsigned int i=bulkStart;i<bodies.size();i++){
+		dynamicsWorld->addRigidBody(bodies[i]);
+	}
+	broadphase->end(dispatcher);
+	bulkStart = -1;
 }
 
 /**
  * @brief Retrieves the rigid body associated to an Object
  * @param obj Object to get the rigid body from
  * @return The linked rigid body, NULL if it does not exist
+ * @note The body can be modified until the next update()
  */
 btRigidBody *World::getRigidBody(Object *obj){
-	std::tr1::unordered_map<Object*, btCollisionObject*>::const_iterator got = objects.find(obj);
-	if(got != objects.end()){
-		return btRigidBody::upcast(got->second);
+	wait();
+	int i = obj->getBodyIndex();
+	if(i >= 0 && i < (int)bodies.size() && bodies[i]->getUserPointer() == obj){
+		return bodies[i];
 	}
 	return NULL;
 }
 
+/**
+ * @brief Make the body of an Object follow its transform, or be simulated again
+ * @param obj The Object, already in this World
+ * @param kinematic Is the body moved by its Object transform?
+ * @note Kinematic flags must be changed here, not on the rigid body, so the World
+ * only reads back the transforms of the kinematic bodies on each update()
+ */
+void World::setKinematic(Object *obj, bool kinematic){
+	btRigidBody *body = getRigidBody(obj);
+	if(body == NULL || body->isKinematicObject() == kinematic) return;
+	if(kinematic){
+		body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_KINEMATIC_OBJECT);
+		body->setActivationState(DISABLE_DEACTIVATION);
+		((MotionState*)body->getMotionState())->snapshot();
+		kinematics.push_back(body);
+	}else{
+		body->setCollisionFlags(body->getCollisionFlags() & ~btCollisionObject::CF_KINEMATIC_OBJECT);
+		body->forceActivationState(ACTIVE_TAG);
+		kinematics.erase(std::find(kinematics.begin(), kinematics.end(), body));
+	}
+}
+
 /**
  * @brief Removes an Object from the World
  * @param obj Which object do we want to remove
  */
 void World::removeObject(Object *obj){
-	std::tr1::unordered_map<Object*, btCollisionObject*>::const_iterator got = objects.find(obj);
-	if(got != objects.end()){
-		btRigidBody* body = btRigidBody::upcast(got->second);
-		if (body && body->getMotionState()){
-			delete body->getMotionState();
-		}
-		dynamicsWorld->removeCollisionObject(got->second);
-		objects.erase(got);
-		delete got->second;
+	btRigidBody *body = getRigidBody(obj);
+	if(body == NULL) return;
+
+	// Delete the body and its motion state (bodies waiting for endBulk() are not simulated yet)
+	int i = obj->getBodyIndex();
+	MotionState *motionState = (MotionState*) body->getMotionState();
+	if(motionState->isPending()){
+		moved.erase(std::find(moved.begin(), moved.end(), motionState));
+	}
+	if(bulkStart < 0 || i < bulkStart) dynamicsWorld->removeRigidBody(body);
+	if(body->isKinematicObject()){
+		kinematics.erase(std::find(kinematics.begin(), kinematics.end(), body));
 	}
+	delete motionState;
+	delete body;
+	obj->getBodyIndex() = -1;
+
+	// Move the last body to the free slot
+	int last = bodies.size() - 1;
+	bool lastPending = (bulkStart >= 0 && last >= bulkStart);
+	bodies[i] = bodies[last];
+	bodies.pop_back();
+	if(i < last){
+		((Object*)bodies[i]->getUserPointer())->getBodyIndex() = i;
+		if(lastPending && i < bulkStart) dynamicsWorld->addRigidBody(bodies[i]);
+	}
+	if(bulkStart > (int)bodies.size()) bulkStart = bodies.size();
 }
 
 /**
  * @brief Performs a Ray test to check if the user touches any Object
  * @param rayLength Length of the ray
  * @return Whether the ray test succeeded or not
- * @note The object must exist in this World, ensure that a Camera is set
+ * @note The object must exist in this World, ensure that a Camera is set.
+ * This blocks until the current step finishes, unless it is called from the update() callback
  */
 Object *World::getClickingObject(float rayLength){
 
+	wait();
 	Camera *cam = Renderer::getCamera();
 	vec3 &camPos = cam->getPosition();
 	vec3 rayEnd = camPos + cam->getRay() * rayLength;
@@ -160,44 +744,222 @@ Object *World::getClickingObject(float rayLength){
 }
 
 /**
- * @brief Does a simulation step
- * @param delta Delta time between steps, the lower the more precise
+ * @struct QueryBatch
+ * @brief Queries shared by the jobs of a batch
+ */
+typedef struct{
+	World *world;						/**< World to query */
+	const AMG_Query *queries;			/**< Queries to run */
+	AMG_QueryResult *results;			/**< Where to store the results */
+	int count;							/**< Number of queries */
+}QueryBatch;
+
+/**
+ * @class QueryCollector
+ * @brief Visits the broadphase leaves touched by a query and runs the narrowphase on them
+ * @note Only uses local state, so many of them can run at once on a read-only world
+ */
+class QueryCollector : public btDbvt::ICollide {
+public:
+	const AMG_Query &q;												/**< Query being run */
+	btTransform from;												/**< Start transform */
+	btTransform to;													/**< End transform */
+	btSphereShape sphere;											/**< Swept sphere */
+	btCollisionWorld::ClosestRayResultCallback rayCallback;			/**< Closest ray hit */
+	btCollisionWorld::ClosestConvexResultCallback sweepCallback;	/**< Closest sweep hit */
+	btCollisionObject *first;										/**< First object overlapped */
+	int hits;														/**< Number of objects overlapped */
+
+	QueryCollector(const AMG_Query &q) : q(q), sphere(q.radius),
+			rayCallback(btVector3(q.from.x, q.from.y, q.from.z), btVector3(q.to.x, q.to.y, q.to.z)),
+			sweepCallback(btVector3(q.from.x, q.from.y, q.from.z), btVector3(q.to.x, q.to.y, q.to.z)) {
+		from.setIdentity();
+		to.setIdentity();
+		from.setOrigin(btVector3(q.from.x, q.from.y, q.from.z));
+		to.setOrigin(btVector3(q.to.x, q.to.y, q.to.z));
+		first = NULL;
+		hits = 0;
+	}
+
+	void Process(const btDbvtNode *leaf){
+		btBroadphaseProxy *proxy = (btBroadphaseProxy*) leaf->data;
+		btCollisionObject *obj = (btCollisionObject*) proxy->m_clientObject;
+		if(q.type == AMG_QUERY_RAY){
+			if(rayCallback.needsCollision(proxy)){
+				btCollisionWorld::rayTestSingle(from, to, obj, obj->getCollisionShape(), obj->getWorldTransform(), rayCallback);
+			}
+		}else if(q.type == AMG_QUERY_SWEEP){
+			if(sweepCallback.needsCollision(proxy)){
+				btCollisionWorld::objectQuerySingle(&sphere, from, to, obj, obj->getCollisionShape(), obj->getWorldTransform(), sweepCallback, 0.0f);
+			}
+		}else{
+			if(first == NULL) first = obj;
+			hits ++;
+		}
+	}
+};
+
+/**
+ * @brief Run a single query against the broadphase trees
+ * @param q The query
+ * @param result Where to store the result
  */
-void World::update(float delta){
-	dynamicsWorld->stepSimulation(delta);
+void World::runQuery(const AMG_Query &q, AMG_QueryResult &result){
+	result.object = NULL;
+	result.point = q.to;
+	result.normal = vec3(0.0f, 0.0f, 0.0f);
+	result.fraction = 1.0f;
+	result.hits = 0;
+
+	// Bounds of the query
+	QueryCollector collector(q);
+	btVector3 from(q.from.x, q.from.y, q.from.z);
+	btVector3 to(q.to.x, q.to.y, q.to.z);
+	btDbvtVolume volume;
+	if(q.type == AMG_QUERY_SWEEP){
+		btVector3 r(q.radius, q.radius, q.radius);
+		btVector3 low = from, high = from;
+		low.setMin(to);
+		high.setMax(to);
+		volume = btDbvtVolume::FromMM(low - r, high + r);
+	}else{
+		volume = btDbvtVolume::FromMM(from, to);
+	}
+
+	// Walk the static and the dynamic trees, both traversals keep their stack locally so jobs can share the trees
+	btDbvtBroadphase *dbvt = broadphase;
+	for(int i=0;i<2;i++){
+		if(q.type == AMG_QUERY_RAY){
+			btDbvt::rayTest(dbvt->m_sets[i].m_root, from, to, collector);
+		}else{
+			dbvt->m_sets[i].collideTV(dbvt->m_sets[i].m_root, volume, collector);
+		}
+	}
 
-	for(int i=0;i<dynamicsWorld->getNumCollisionObjects();i++){
-		btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[i];
-		btRigidBody* body = btRigidBody::upcast(obj);
-		Object *o = (Object*) body->getUserPointer();
-		btTransform &t = body->getWorldTransform();
-		btVector3 &pos = t.getOrigin();
-		btQuaternion rot = t.getRotation();
-		o->getPosition() = vec3(pos.x(), pos.y(), pos.z());
-		o->getRotation() = quat(rot.x(), rot.y(), rot.z(), rot.w());
+	// Store the closest hit
+	const btCollisionObject *hit = NULL;
+	if(q.type == AMG_QUERY_RAY && collector.rayCallback.hasHit()){
+		hit = collector.rayCallback.m_collisionObject;
+		btVector3 &p = collector.rayCallback.m_hitPointWorld;
+		btVector3 &n = collector.rayCallback.m_hitNormalWorld;
+		result.point = vec3(p.x(), p.y(), p.z());
+		result.normal = vec3(n.x(), n.y(), n.z());
+		result.fraction = collector.rayCallback.m_closestHitFraction;
+	}else if(q.type == AMG_QUERY_SWEEP && collector.sweepCallback.hasHit()){
+		hit = collector.sweepCallback.m_hitCollisionObject;
+		btVector3 &p = collector.sweepCallback.m_hitPointWorld;
+		btVector3 &n = collector.sweepCallback.m_hitNormalWorld;
+		result.point = vec3(p.x(), p.y(), p.z());
+		result.normal = vec3(n.x(), n.y(), n.z());
+		result.fraction = collector.sweepCallback.m_closestHitFraction;
+	}else if(q.type == AMG_QUERY_AABB){
+		hit = collector.first;
+		result.hits = collector.hits;
+	}
+	if(hit){
+		result.object = (Object*) hit->getUserPointer();
+		if(q.type != AMG_QUERY_AABB) result.hits = 1;
+	}
+}
+
+/**
+ * @brief Run a group of queries, as a job
+ * @param data The QueryBatch
+ * @param index Group index
+ */
+void World::queryJob(void *data, int index){
+	QueryBatch *batch = (QueryBatch*) data;
+	int start = index * AMG_QUERY_BATCH;
+	int end = glm::min(start + AMG_QUERY_BATCH, batch->count);
+	for(int i=start;i<end;i++){
+		batch->world->runQuery(batch->queries[i], batch->results[i]);
 	}
 }
 
+/**
+ * @brief Run many ray, sphere sweep and AABB overlap queries in parallel
+ * @param queries Queries to run
+ * @param results Where to store the results, one per query in the same order
+ * @param count Number of queries
+ * @note The simulation is paused while the queries run, so they see the world as read-only.
+ * Queries are run by the JobSystem in groups of AMG_QUERY_BATCH, and this waits for all of them
+ */
+void World::query(const AMG_Query *queries, AMG_QueryResult *results, int count){
+	if(count <= 0) return;
+	wait();
+	QueryBatch batch = {this, queries, results, count};
+	AMG_JobCounter counter(0);
+	JobSystem::parallelFor(queryJob, &batch, (count + AMG_QUERY_BATCH - 1) / AMG_QUERY_BATCH, &counter);
+	JobSystem::wait(&counter);
+}
+
+/**
+ * @brief Advances the simulation, in fixed steps
+ * @param delta Time since the last update
+ * @param idle Function called after the previous step is applied and before the next one
+ * starts, to query and modify the world without waiting for the simulation (can be NULL)
+ * @note When threaded, this waits for the previous step, applies its results and starts the next
+ * one on the physics thread, so the Objects lag one frame behind the simulation.
+ * Moved bodies write their Object transform through their MotionState, and only
+ * active bodies get their bounding boxes refitted
+ */
+void World::update(float delta, void (*idle)(void)){
+	if(!threaded){
+		snapshot();
+		simulate(delta);
+		sync();
+		if(idle) idle();
+		return;
+	}
+
+	// Collect the previous step and start the next one
+	wait();
+	sync();
+	if(idle) idle();
+	snapshot();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stepDelta = delta;
+		stepping = true;
+	}
+	condition.notify_all();
+}
+
 /**
  * @brief Destructor for a World
  */
 World::~World() {
 
-	for(int i=0;i<dynamicsWorld->getNumCollisionObjects();i++){
-		btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[i];
-		btRigidBody* body = btRigidBody::upcast(obj);
-		if (body && body->getMotionState()){
-			delete body->getMotionState();
+	// Stop the physics thread
+	if(threaded){
+		wait();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
 		}
-		dynamicsWorld->removeCollisionObject(obj);
-		delete obj;
+		condition.notify_all();
+		thread.join();
+	}
+
+	// The dynamics world releases the broadphase data of its bodies
+	delete dynamicsWorld;
+	for(unsigned int i=0;i<bodies.size();i++){
+		((Object*)bodies[i]->getUserPointer())->getBodyIndex() = -1;
+		delete bodies[i]->getMotionState();
+		delete bodies[i];
 	}
 
 	for(unsigned int i=0;i<shapes.size();i++){
 		delete shapes[i];
 	}
+	for(unsigned int i=0;i<meshes.size();i++){
+		delete meshes[i];
+	}
+	for(unsigned int i=0;i<meshBuffers.size();i++){
+		btAlignedFree(meshBuffers[i]);
+	}
 
-	delete dynamicsWorld;
+	if(solverPool) delete solverPool;
 	delete solver;
 	delete broadphase;
 	delete dispatcher;
@@ -8,6 +8,11 @@
 
 // Includes C/C++
 #include <tr1/unordered_map>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 // Includes Bullet
 #include <btBulletCollisionCommon.h>
@@ -16,32 +21,119 @@
 // Own includes
 #include "Entity.h"
 #include "Object.h"
+#include "MotionState.h"
+#include "BulkBroadphase.h"
+#include "ConvexDecomposition.h"
+
+// Defines
+#define AMG_PHYSICS_RATE 120.0f		/**< Default number of fixed simulation steps per second */
+#define AMG_PHYSICS_MAX_STEPS 8		/**< Maximum number of fixed steps per update, slower simulations lose time */
+#define AMG_QUERY_BATCH 64			/**< Queries run by each job of a batch */
 
 namespace AMG {
 
+/**
+ * @enum AMG_QueryType
+ * @brief Types of batched physics queries
+ */
+enum AMG_QueryType {
+	AMG_QUERY_RAY = 0,			/**< Closest hit along a ray, from "from" to "to" */
+	AMG_QUERY_SWEEP,			/**< Closest hit of a sphere moving from "from" to "to" */
+	AMG_QUERY_AABB,				/**< Objects whose bounding boxes overlap the box from "from" (min) to "to" (max) */
+};
+
+/**
+ * @struct AMG_Query
+ * @brief A physics query, see World::query()
+ */
+typedef struct{
+	int type;					/**< Query type, see AMG_QueryType */
+	vec3 from;					/**< Start point, or minimum corner of the box */
+	vec3 to;					/**< End point, or maximum corner of the box */
+	float radius;				/**< Sphere radius, only for sweeps */
+}AMG_Query;
+
+/**
+ * @struct AMG_QueryResult
+ * @brief Result of a physics query
+ */
+typedef struct{
+	Object *object;				/**< Closest Object hit (or first one overlapped), NULL if none */
+	vec3 point;					/**< Hit point, in world space */
+	vec3 normal;				/**< Hit normal, in world space */
+	float fraction;				/**< Hit position along the query, from 0 to 1 (1 if nothing was hit) */
+	int hits;					/**< Number of objects overlapped (AABB queries), 0 or 1 otherwise */
+}AMG_QueryResult;
+
 /**
  * @class World
  * @brief World utilities to be used with Bullet Physics library
+ * @note By default, the simulation runs on its own thread while the next frame is rendered.
+ * Every method except the inline getters blocks until the current step finishes, so the
+ * world can be used as usual. The callback given to update() runs while the simulation is
+ * idle, so the queries and body changes made there (getClickingObject(), query(),
+ * getRigidBody()...) never block
  */
 class World: public Entity {
 private:
 	btDefaultCollisionConfiguration* collisionConfiguration;		/**< Collision configuration */
 	btCollisionDispatcher* dispatcher;								/**< Collision dispatcher */
-	btBroadphaseInterface* broadphase;								/**< Broadphase (checks if AABBs collide, for each object) */
+	BulkBroadphase* broadphase;										/**< Broadphase (checks if AABBs collide, for each object) */
 	btSequentialImpulseConstraintSolver* solver;					/**< Impulse solver */
+	btConstraintSolver* solverPool;									/**< Pool of solvers for the multithreaded world, NULL if not used */
 	btDiscreteDynamicsWorld* dynamicsWorld;							/**< The actual dynamics world */
-	std::tr1::unordered_map<Object*, btCollisionObject*> objects;	/**< Object <-> CollisionObject dictionary */
+	std::vector<btRigidBody*> bodies;								/**< Rigid bodies, indexed by Object::getBodyIndex() */
+	std::vector<btRigidBody*> kinematics;							/**< Kinematic bodies, moved by their Object transform */
+	int bulkStart;													/**< First body of the current bulk insertion, -1 if there is none */
 	std::vector<btCollisionShape*> shapes;							/**< Collision shapes */
+	std::tr1::unordered_map<std::string, btCollisionShape*> shapeCache;	/**< Shared collision shapes, by parameters */
+	std::vector<btStridingMeshInterface*> meshes;					/**< Triangle meshes used by the mesh shapes */
+	std::vector<void*> meshBuffers;									/**< Vertex, index and BVH data of the triangle meshes (aligned allocations) */
+	std::vector<MotionState*> moved;								/**< Motion states moved by the last simulation step */
+	std::thread thread;												/**< Physics thread */
+	std::mutex mutex;												/**< Protects the step state */
+	std::condition_variable condition;								/**< Signals the start and the end of each step */
+	bool threaded;													/**< Is the simulation run on the physics thread? */
+	bool running;													/**< Must the physics thread keep running? */
+	bool stepping;													/**< Is a step being simulated? */
+	float stepDelta;												/**< Time to simulate on the current step */
+	float fixedStep;												/**< Duration of each fixed step */
+	static void threadLoop(World *world);
+	void simulate(float delta);
+	btCollisionShape *findShape(const char *key);
+	btCollisionShape *storeShape(const char *key, btCollisionShape *shape);
+	vec3 getExtents(Object *obj);
+	btConvexHullShape *getHull(Object *obj);
+	btCollisionShape *getScaledHull(btConvexHullShape *hull, const vec3 &scale);
+	btCompoundShape *getDecomposition(Object *obj, int maxHulls);
+	btBvhTriangleMeshShape *getTriangleMesh(Object *obj);
+	void addBody(Object *obj, float mass, btCollisionShape *shape);
+	void runQuery(const AMG_Query &q, AMG_QueryResult &result);
+	static void queryJob(void *data, int index);
+	void wait();
+	void sync();
+	void snapshot();
 public:
-	World();
+	float getFixedStep(){ return fixedStep; }
+	bool isThreaded(){ return threaded; }
+
+	World(bool threaded=true, bool multithreaded=false);
+	void setRate(float rate);
 	void addObject(Object *obj, float mass, btCollisionShape *shape);
 	void addObjectBox(Object *obj, float mass);
 	void addObjectSphere(Object *obj, float mass);
 	void addObjectConvexHull(Object *obj, float mass);
+	void addObjectTriangleMesh(Object *obj);
+	void addObjectDecomposition(Object *obj, float mass, int maxHulls=AMG_DECOMPOSITION_HULLS);
+	void beginBulk();
+	void endBulk();
 	Object *getClickingObject(float rayLength);
+	void query(const AMG_Query *queries, AMG_QueryResult *results, int count);
 	btRigidBody *getRigidBody(Object *obj);
+	void setKinematic(Object *obj, bool kinematic);
+	int getNBodies(){ return bodies.size(); }
 	void removeObject(Object *obj);
-	void update(float delta);
+	void update(float delta, void (*idle)(void)=NULL);
 	virtual ~World();
 };
 
@@ -1,6 +1,7 @@
 // Includes C/C++
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 // Own includes
 #include "Renderer.h"
@@ -12,6 +13,7 @@
 #include "Skybox.h"
 #include "Font.h"
 #include "ParticleSource.h"
+#include "GPUParticleSource.h"
 #include "World.h"
 #include "LensFlare.h"
 #include "ShadowRenderer.h"
@@ -20,6 +22,11 @@
 #include "BloomEffect.h"
 #include "GaussianBlur.h"
 #include "MotionBlur.h"
+#include "OcclusionCulling.h"
+#include "AssetLoader.h"
+#include "TextureStreamer.h"
+#include "FileSystem.h"
+#include "Debug.h"
 using namespace AMG;
 
 // Definition of objects
@@ -30,6 +37,7 @@ Shader *s0 = NULL, *s1 = NULL, *s2 = NULL, *s3 = NULL, *s4 = NULL, *s5 = NULL, *
 Text *hello = NULL;
 Sprite *sprite = NULL;
 ParticleSource *source = NULL;
+GPUParticleSource *gpuSource = NULL;
 Texture *cubeMap = NULL;
 LensFlare *lens = NULL;
 Light *light = NULL, *spot = NULL;
@@ -83,7 +91,9 @@ void render(){
 
 	Renderer::updateCamera(cam);
 
+	OcclusionCulling::start();
 	ShadowRenderer::updateShadowMap(renderShadows, light);
+	OcclusionCulling::wait();
 
 	DeferredRendering::start();
 
@@ -100,6 +110,7 @@ void render(){
 	bullet->draw();
 
 	DeferredRendering::end();
+	OcclusionCulling::end();
 
 	s2->enable();
 	skybox->draw();
@@ -110,17 +121,21 @@ void render(){
 	s5->enable();
 	source->update();
 	source->draw(GL_ONE);
+	gpuSource->update();
+	gpuSource->draw(GL_ONE);
 
+	if(Renderer::getKey(GLFW_KEY_Q)){
+		source->addParticle(Particle(vec3(0, 0, 0), vec3(0, 5, 2), 1, 5, 0, 1));
+	}
+}
+
+void physics(){
 	Object *clicked = Renderer::getWorld()->getClickingObject(20.0f);
 	if(clicked == bullet->getObject(2)){
 		btRigidBody *b = Renderer::getWorld()->getRigidBody(clicked);
 		b->setActivationState(1);
 		b->setLinearVelocity(btVector3(0, 3, 0));
 	}
-
-	if(Renderer::getKey(GLFW_KEY_Q)){
-		source->getParticles().push_back(Particle(vec3(0, 0, 0), vec3(0, 5, 2), 1, 5, 0, 1));
-	}
 }
 
 void render2d(){
@@ -137,6 +152,7 @@ void post(){
 
 void unload(){
 	MotionBlur::finish();
+	OcclusionCulling::finish();
 	ShadowRenderer::finish();
 	WaterTile::finish();
 	DeferredRendering::finish();
@@ -162,6 +178,7 @@ void unload(){
 	AMG_DELETE(sprite);
 	AMG_DELETE(cubeMap);
 	AMG_DELETE(source);
+	AMG_DELETE(gpuSource);
 	AMG_DELETE(lens);
 	AMG_DELETE(light);
 	AMG_DELETE(font);
@@ -170,12 +187,14 @@ void unload(){
 
 int main(int argc, char **argv){
 
+	Debug::isVerbose() = (argc > 1 && strcmp(argv[1], "-v") == 0);
 	Renderer::initialize(1440, 900, "Window1", false, 4);
 	Renderer::createWorld();
 	Renderer::setRenderCallback(render);
 	Renderer::setRender2dCallback(render2d);
 	Renderer::setUnloadCallback(unload);
 	Renderer::setPostCallback(post);
+	Renderer::setPhysicsCallback(physics);
 	Renderer::getFogDensity() = 0.1f;
 	Renderer::getFogGradient() = 5.0f;
 
@@ -185,6 +204,8 @@ int main(int argc, char **argv){
 
 	DeferredRendering::initialize(true, 32);
 
+	OcclusionCulling::initialize(256, 128);
+
 	WaterTile::initialize();
 	water = new WaterTile("waterNormalMap.dds", "waterDUDV.dds", vec3(0, 2.5f, -10), 5.0f);
 
@@ -198,10 +219,16 @@ int main(int argc, char **argv){
 	s5 = new Shader("particles");
 	s6 = new Shader("bullet");
 	s7 = new Shader("barrel");
-	s00 = new Shader("_default");
-	s70 = new Shader("_barrel");
-	s60 = new Shader("_bullet");
-	s10 = new Shader("_terrain");
+	s00 = new Shader("default", {"FORWARD"});
+	s70 = new Shader("barrel", {"FORWARD"});
+	s60 = new Shader("bullet", {"FORWARD"});
+	s10 = new Shader("terrain", {"FORWARD"});
+
+	// Read the models in the background, while the rest of the scene is set up
+	TextureStreamer::isEnabled() = true;
+	std::shared_ptr<ModelAsset> linkAsset = AssetLoader::loadModel("model2.amd");
+	std::shared_ptr<ModelAsset> bulletAsset = AssetLoader::loadModel("bullet.amd");
+	std::shared_ptr<ModelAsset> barrelAsset = AssetLoader::loadModel("barrel.amd", true);
 
 	light = new Light(vec3(100000, 100000, 100000), vec3(1, 1, 0), vec3(0.0f, 0, 1));
 	spot = new Light(vec3(0, 3, 0), vec3(0, 0, 1), vec3(0, 0, 1));
@@ -211,21 +238,31 @@ int main(int argc, char **argv){
 	DeferredRendering::lights.push_back(spot);
 	DeferredRendering::lights.push_back(new Light(vec3(0, 10, 0), vec3(0, 1, 0), vec3(0.1f, 0, 1)));
 
-	link = new Model("model2.amd");
+	linkAsset->wait();
+	link = linkAsset->get();
 	link->getObject(0)->getScale() = vec3(0.1f, 0.1f, 0.1f);
 	link->getObject(0)->getPosition() = vec3(0.0f, 3.0f, -10.0f);
 
-	bullet = new Model("bullet.amd");
+	bulletAsset->wait();
+	bullet = bulletAsset->get();
 	bullet->getObject(0)->getPosition().y += 2.0f;
 	bullet->getObject(1)->getScale() = vec3(0.2f, 0.2f, 0.2f);
 	bullet->getObject(2)->getScale() = vec3(0.5f, 0.5f, 0.5f);
+	bullet->getObject(0)->setOccluder(true);
 
-	barrel = new Model("barrel.amd", true);
+	barrelAsset->wait();
+	barrel = barrelAsset->get();
 	barrel->getObject(0)->getScale() = vec3(0.1f, 0.1f, 0.1f);
 	barrel->getObject(0)->getPosition() = vec3(0.0f, 3.0f, -3.0f);
 
 	font = new Font("candara.dds", "candara.fnt");
 
+	// Startup file statistics, to compare the pack with loose files, printed with -v
+	Debug::log("Startup: %s, %d reads, %.2f MB in %.2f ms\n", FileSystem::isMounted() ? "pack" : "loose files",
+			FileSystem::getNReads(), FileSystem::getReadBytes() / (1024.0 * 1024.0), FileSystem::getReadTime());
+	Debug::log("Shaders: %d programs, %d from the binary cache, %d shared, in %.2f ms\n", Shader::getNPrograms(),
+			Shader::getNCached(), Shader::getNShared(), Shader::getLoadTime());
+
 	float tbx = 300;
 	float tby = 300;
 
@@ -244,13 +281,16 @@ int main(int argc, char **argv){
 	sprite->getScaleY() = tby / 256;
 
 	source = new ParticleSource("cosmic.dds", 32, 32, 1000);
+	gpuSource = new GPUParticleSource("cosmic.dds", 32, 32, 100000);
+	gpuSource->setEmission(Particle(vec3(4, 0, -4), vec3(0, 6, 0), 1, 4, 0, 1), 5000.0f, 2.0f);
+	gpuSource->setCollision(true);
 
 	Renderer::getWorld()->addObjectBox(bullet->getObject(0), 0.0f);
 	Renderer::getWorld()->addObjectBox(bullet->getObject(1), 5.0f);
 	Renderer::getWorld()->addObjectConvexHull(bullet->getObject(2), 7.0f);
 
 	skybox = new Skybox("sky");
-	vec3 cmapPos = vec3(bullet->getObject(2)->getPosition());
+	vec3 cmapPos = vec3(bullet->getObject(2)->readPosition());
 	cmapPos.y = 0.0f;
 	cubeMap = Renderer::createCubeMap(renderSimple, s6, 256, cmapPos);
 
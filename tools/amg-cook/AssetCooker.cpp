@@ -0,0 +1,267 @@
+/**
+ * @file AssetCooker.cpp
+ * @brief Converts source assets to the formats the engine loads
+ */
+
+// Includes C/C++
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <chrono>
+#include <set>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+// Own includes
+#include "AssetCooker.h"
+#include "MeshCooker.h"
+#include "TextureCooker.h"
+#include "FileSystem.h"
+#include "JobSystem.h"
+#include "Entity.h"
+
+namespace AMG {
+
+// Static variables
+std::vector<AMG_CookJob> AssetCooker::jobs;
+std::map<std::string, unsigned long long> AssetCooker::manifest;
+
+/**
+ * @brief Read the manifest of the last run
+ * @param path Manifest path
+ */
+void AssetCooker::readManifest(const char *path){
+	manifest.clear();
+	FILE *f = fopen(path, "r");
+	if(f == NULL) return;
+	char name[AMG_PATH_SIZE];
+	unsigned long long hash;
+	while(fscanf(f, "%16llx %255[^\n]\n", &hash, name) == 2){
+		manifest[name] = hash;
+	}
+	fclose(f);
+}
+
+/**
+ * @brief Write the manifest, with the assets cooked correctly
+ * @param path Manifest path
+ * @return Whether it could be written
+ */
+bool AssetCooker::writeManifest(const char *path){
+	std::string text;
+	char line[AMG_PATH_SIZE + 32];
+	for(unsigned int i=0;i<jobs.size();i++){
+		if(jobs[i].error != AMG_COOK_OK) continue;
+		sprintf(line, "%016llx %s\n", jobs[i].hash, jobs[i].name.c_str());
+		text += line;
+	}
+	return writeFile(path, text.c_str(), text.size(), NULL, 0) == AMG_COOK_OK;
+}
+
+/**
+ * @brief Hash the contents of a file
+ * @param path File path
+ * @param seed Previous hash, to chain several files
+ * @return The new hash, or the seed if the file does not exist
+ */
+unsigned long long AssetCooker::hashFile(const char *path, unsigned long long seed){
+	FILE *f = fopen(path, "rb");
+	if(f == NULL) return seed;
+	char buffer[64 * 1024];
+	int n;
+	while((n = fread(buffer, 1, sizeof(buffer), f)) > 0){
+		seed = Entity::hash(buffer, n, seed);
+	}
+	fclose(f);
+	return seed;
+}
+
+/**
+ * @brief Write a file, creating its folders if needed
+ * @param path File path
+ * @param data First part of the data
+ * @param size Size of the first part, in bytes
+ * @param data2 Second part of the data, can be NULL
+ * @param size2 Size of the second part, in bytes
+ * @return AMG_COOK_OK or AMG_COOK_UNWRITABLE
+ */
+int AssetCooker::writeFile(const char *path, const void *data, int size, const void *data2, int size2){
+	std::string folder(path);
+	for(size_t i = folder.find('/', 1); i != std::string::npos; i = folder.find('/', i + 1)){
+#ifdef _WIN32
+		_mkdir(folder.substr(0, i).c_str());
+#else
+		mkdir(folder.substr(0, i).c_str(), 0755);
+#endif
+	}
+	FILE *f = fopen(path, "wb");
+	if(f == NULL) return AMG_COOK_UNWRITABLE;
+	bool ok = (int)fwrite(data, 1, size, f) == size;
+	if(data2) ok = ok && (int)fwrite(data2, 1, size2, f) == size2;
+	fclose(f);
+	return ok ? AMG_COOK_OK : AMG_COOK_UNWRITABLE;
+}
+
+/**
+ * @brief Get a description of a cooking error
+ * @param error Error code, see AMG_CookError
+ * @return The description
+ */
+const char *AssetCooker::getErrorString(int error){
+	switch(error){
+		case AMG_COOK_OK: return "ok";
+		case AMG_COOK_UNREADABLE: return "can't read the input";
+		case AMG_COOK_UNWRITABLE: return "can't write the output";
+		case AMG_COOK_WRONG_DATA: return "wrong input data";
+		case AMG_COOK_WRONG_SIZE: return "image size must be even";
+		case AMG_COOK_TOO_BIG: return "too big for the AMD format";
+		default: return "unknown error";
+	}
+}
+
+/**
+ * @brief Choose how to cook a source file, from its extension
+ * @param data Data folder
+ * @param name File path, relative to the source folder
+ * @param output Where to store the output path
+ * @return How it is cooked, see AMG_CookKind, or -1 if it is cooked with other files
+ */
+int AssetCooker::getOutput(const char *data, const std::string &name, std::string &output){
+	std::string ext, lower;
+	size_t dot = name.find_last_of('.');
+	for(unsigned int i=0;i<name.size();i++) lower += tolower(name[i]);
+	if(dot != std::string::npos) ext = lower.substr(dot);
+
+	output = std::string(data) + "/" + name;
+	if(ext == ".mtl"){
+		return -1;		// Cooked with its OBJ files
+	}else if(ext == ".obj"){
+		output = output.substr(0, output.size() - ext.size()) + ".amd";
+		return AMG_COOK_MESH;
+	}else if(ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp" || ext == ".psd" || ext == ".gif"){
+		bool isData = lower.find("normal") != std::string::npos || lower.find("dudv") != std::string::npos;
+		output = output.substr(0, output.size() - ext.size()) + ".dds";
+		return isData ? AMG_COOK_DATA_TEXTURE : AMG_COOK_TEXTURE;
+	}
+	return AMG_COOK_COPY;
+}
+
+/**
+ * @brief Add the job of a source file
+ * @param source Source folder
+ * @param data Data folder
+ * @param name File path, relative to the source folder
+ */
+void AssetCooker::addJob(const char *source, const char *data, const std::string &name){
+	AMG_CookJob job;
+	job.name = name;
+	job.input = std::string(source) + "/" + name;
+	job.kind = getOutput(data, name, job.output);
+	job.error = AMG_COOK_OK;
+	if(job.kind < 0) return;
+
+	// Hash the cooker settings and every input
+	int settings[2] = {AMG_COOK_VERSION, job.kind};
+	job.hash = hashFile(job.input.c_str(), Entity::hash(settings, sizeof(settings)));
+	if(job.kind == AMG_COOK_MESH){
+		std::vector<std::string> deps;
+		MeshCooker::getDependencies(job.input.c_str(), deps);
+		for(unsigned int i=0;i<deps.size();i++) job.hash = hashFile(deps[i].c_str(), job.hash);
+	}
+	jobs.push_back(job);
+}
+
+/**
+ * @brief Cook an asset, run on the JobSystem
+ * @param data List of job indices
+ * @param index Which index of the list
+ */
+void AssetCooker::cookJob(void *data, int index){
+	AMG_CookJob &job = jobs[(*(std::vector<int>*)data)[index]];
+	if(job.kind == AMG_COOK_MESH){
+		job.error = MeshCooker::cook(job.input.c_str(), job.output.c_str());
+	}else if(job.kind == AMG_COOK_TEXTURE || job.kind == AMG_COOK_DATA_TEXTURE){
+		job.error = TextureCooker::cook(job.input.c_str(), job.output.c_str(), job.kind == AMG_COOK_DATA_TEXTURE);
+	}else{
+		FILE *f = fopen(job.input.c_str(), "rb");
+		if(f == NULL){
+			job.error = AMG_COOK_UNREADABLE;
+			return;
+		}
+		std::vector<char> buffer;
+		char chunk[64 * 1024];
+		int n;
+		while((n = fread(chunk, 1, sizeof(chunk), f)) > 0) buffer.insert(buffer.end(), chunk, chunk + n);
+		fclose(f);
+		job.error = writeFile(job.output.c_str(), buffer.data(), buffer.size(), NULL, 0);
+	}
+}
+
+/**
+ * @brief Cook the assets of a source folder into the data folder
+ * @param source Source folder, with the same layout as the data folder (Model/, Texture/...)
+ * @param data Data folder
+ * @param force Cook everything, even the assets which did not change?
+ * @return Number of assets which could not be cooked
+ * @note The JobSystem must be initialized
+ */
+int AssetCooker::cook(const char *source, const char *data, bool force){
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	TextureCooker::initialize();
+
+	// Find the assets and the ones which changed
+	std::vector<std::string> files;
+	FileSystem::listFiles(source, "", files);
+	jobs.clear();
+	for(unsigned int i=0;i<files.size();i++) addJob(source, data, files[i]);
+	std::string manifestPath = std::string(data) + "/" + AMG_COOK_MANIFEST;
+	readManifest(manifestPath.c_str());
+	std::vector<int> pending;
+	for(unsigned int i=0;i<jobs.size();i++){
+		struct stat info;
+		std::map<std::string, unsigned long long>::iterator it = manifest.find(jobs[i].name);
+		bool upToDate = it != manifest.end() && it->second == jobs[i].hash && stat(jobs[i].output.c_str(), &info) == 0;
+		if(force || !upToDate) pending.push_back(i);
+	}
+
+	// Remove the outputs of the assets deleted since the last run, unless another asset writes them
+	std::set<std::string> names(files.begin(), files.end()), outputs;
+	for(unsigned int i=0;i<jobs.size();i++) outputs.insert(jobs[i].output);
+	int removed = 0;
+	for(std::map<std::string, unsigned long long>::iterator it = manifest.begin();it != manifest.end();it++){
+		std::string output;
+		if(names.count(it->first) || getOutput(data, it->first, output) < 0 || outputs.count(output)) continue;
+		if(::remove(output.c_str()) == 0){
+			printf("Removed %s\n", output.c_str());
+			removed++;
+		}
+	}
+
+	// Cook them in parallel
+	AMG_JobCounter counter(0);
+	JobSystem::parallelFor(cookJob, &pending, pending.size(), &counter);
+	JobSystem::wait(&counter);
+
+	// Report the results
+	int errors = 0;
+	for(unsigned int i=0;i<pending.size();i++){
+		AMG_CookJob &job = jobs[pending[i]];
+		if(job.error == AMG_COOK_OK){
+			printf("Cooked %s\n", job.name.c_str());
+		}else{
+			fprintf(stderr, "Error cooking %s: %s\n", job.name.c_str(), getErrorString(job.error));
+			errors++;
+		}
+	}
+	if(!writeManifest(manifestPath.c_str())){
+		fprintf(stderr, "Error writing %s\n", manifestPath.c_str());
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%d cooked, %d up to date, %d removed, %d failed, in %.2f s\n", (int)pending.size() - errors, (int)(jobs.size() - pending.size()), removed, errors, seconds);
+	return errors;
+}
+
+}
@@ -0,0 +1,83 @@
+/**
+ * @file AssetCooker.h
+ * @brief Converts source assets to the formats the engine loads
+ */
+
+#ifndef ASSETCOOKER_H_
+#define ASSETCOOKER_H_
+
+// Includes C/C++
+#include <map>
+#include <string>
+#include <vector>
+
+// Defines
+#define AMG_COOK_VERSION 1							/**< Version of the cooker, changing it cooks everything again */
+#define AMG_COOK_MANIFEST "Cache/amg-cook.manifest"	/**< Manifest path, inside the data folder */
+
+namespace AMG {
+
+/**
+ * @enum AMG_CookError
+ * @brief Result of cooking an asset
+ */
+enum AMG_CookError {
+	AMG_COOK_OK = 0,			/**< The asset was cooked */
+	AMG_COOK_UNREADABLE,		/**< The input could not be read */
+	AMG_COOK_UNWRITABLE,		/**< The output could not be written */
+	AMG_COOK_WRONG_DATA,		/**< The input is not valid */
+	AMG_COOK_WRONG_SIZE,		/**< The image size is not even */
+	AMG_COOK_TOO_BIG,			/**< The model does not fit in the AMD limits */
+};
+
+/**
+ * @enum AMG_CookKind
+ * @brief How an asset is cooked
+ */
+enum AMG_CookKind {
+	AMG_COOK_COPY = 0,			/**< Copied as it is */
+	AMG_COOK_MESH,				/**< OBJ mesh to AMD model */
+	AMG_COOK_TEXTURE,			/**< Color image to DDS */
+	AMG_COOK_DATA_TEXTURE,		/**< Data image (normal map...) to DDS, filtered without gamma */
+};
+
+/**
+ * @struct AMG_CookJob
+ * @brief An asset to cook
+ */
+typedef struct{
+	std::string name;					/**< Input path, relative to the source folder */
+	std::string input;					/**< Input path */
+	std::string output;					/**< Output path */
+	int kind;							/**< How it is cooked, see AMG_CookKind */
+	unsigned long long hash;			/**< Hash of the inputs and the cooker settings */
+	int error;							/**< Result, see AMG_CookError */
+}AMG_CookJob;
+
+/**
+ * @class AssetCooker
+ * @brief Mirrors a source folder into the data folder, cooking each asset on the JobSystem
+ * @note OBJ files become AMD models and images become DDS textures; anything else is copied.
+ * A manifest keeps the hash of the inputs of each asset, so unchanged assets are skipped, and the
+ * outputs of the assets removed from the source folder are deleted
+ */
+class AssetCooker {
+private:
+	static std::vector<AMG_CookJob> jobs;					/**< Assets of the source folder */
+	static std::map<std::string, unsigned long long> manifest;	/**< Hash of each asset in the last run */
+	AssetCooker(){}
+	static void readManifest(const char *path);
+	static bool writeManifest(const char *path);
+	static unsigned long long hashFile(const char *path, unsigned long long seed);
+	static int getOutput(const char *data, const std::string &name, std::string &output);
+	static void addJob(const char *source, const char *data, const std::string &name);
+	static void cookJob(void *data, int index);
+public:
+	static int cook(const char *source, const char *data, bool force);
+	static int writeFile(const char *path, const void *data, int size, const void *data2, int size2);
+	static const char *getErrorString(int error);
+};
+
+}
+
+#endif
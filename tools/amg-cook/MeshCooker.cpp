@@ -0,0 +1,379 @@
+/**
+ * @file MeshCooker.cpp
+ * @brief Converts Wavefront OBJ meshes to AMD models
+ */
+
+// Includes C/C++
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Own includes
+#include "MeshCooker.h"
+#include "AssetCooker.h"
+#include "Entity.h"
+
+namespace AMG {
+
+/**
+ * @brief Hash a vertex, bit by bit
+ * @param v Vertex
+ * @return Hash of its data
+ */
+size_t AMG_CookVertexHash::operator()(const AMG_CookVertex &v) const {
+	return (size_t)Entity::hash(v.data, sizeof(v.data));
+}
+
+/**
+ * @brief Compare two vertices, bit by bit, like the Blender exporter does
+ * @param a First vertex
+ * @param b Second vertex
+ * @return Whether they are the same vertex
+ */
+bool AMG_CookVertexHash::operator()(const AMG_CookVertex &a, const AMG_CookVertex &b) const {
+	return memcmp(a.data, b.data, sizeof(a.data)) == 0;
+}
+
+/**
+ * @brief Get the folder of a path
+ * @param path File path
+ * @return The folder, with its trailing slash, or an empty string
+ */
+static std::string folderOf(const char *path){
+	std::string p(path);
+	size_t slash = p.find_last_of("/\\");
+	return (slash == std::string::npos) ? std::string() : p.substr(0, slash + 1);
+}
+
+/**
+ * @brief Get the runtime name of a texture referenced by a material
+ * @param path Texture path, as written in the MTL file
+ * @return Its file name, with the .dds extension
+ */
+static std::string textureName(const char *path){
+	std::string p(path);
+	size_t slash = p.find_last_of("/\\");
+	if(slash != std::string::npos) p = p.substr(slash + 1);
+	size_t dot = p.find_last_of('.');
+	if(dot != std::string::npos) p = p.substr(0, dot);
+	return p + ".dds";
+}
+
+/**
+ * @brief Remove the line break and trailing spaces of a line
+ * @param line Line read with fgets
+ */
+static void trim(char *line){
+	int len = strlen(line);
+	while(len > 0 && (line[len-1] == '\n' || line[len-1] == '\r' || line[len-1] == ' ' || line[len-1] == '\t')){
+		line[--len] = 0;
+	}
+}
+
+/**
+ * @brief Get the MTL files an OBJ file uses, so changes to them cook it again
+ * @param input OBJ path
+ * @param files The paths are appended here
+ */
+void MeshCooker::getDependencies(const char *input, std::vector<std::string> &files){
+	FILE *f = fopen(input, "r");
+	if(f == NULL) return;
+	std::string dir = folderOf(input);
+	char line[1024];
+	while(fgets(line, sizeof(line), f)){
+		trim(line);
+		if(strncmp(line, "mtllib ", 7) == 0) files.push_back(dir + (line + 7));
+	}
+	fclose(f);
+}
+
+/**
+ * @brief Read the materials of a MTL file
+ * @param path MTL path
+ * @param materials The materials are appended here
+ */
+void MeshCooker::readMaterials(const std::string &path, std::vector<AMG_CookMaterial> &materials){
+	FILE *f = fopen(path.c_str(), "r");
+	if(f == NULL) return;
+	char line[1024];
+	AMG_CookMaterial *mat = NULL;
+	while(fgets(line, sizeof(line), f)){
+		trim(line);
+		char *l = line;
+		while(*l == ' ' || *l == '\t') l++;
+		if(strncmp(l, "newmtl ", 7) == 0){
+			AMG_CookMaterial m;
+			m.name = l + 7;
+			float defaults[11] = {0.8f, 0.8f, 0.8f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.5f, 1.0f, 1.0f};
+			memcpy(m.data, defaults, sizeof(defaults));
+			materials.push_back(m);
+			mat = &materials.back();
+		}else if(mat == NULL){
+			continue;
+		}else if(strncmp(l, "Kd ", 3) == 0){
+			sscanf(l + 3, "%f %f %f", &mat->data[0], &mat->data[1], &mat->data[2]);
+		}else if(strncmp(l, "d ", 2) == 0){
+			sscanf(l + 2, "%f", &mat->data[4]);
+		}else if(strncmp(l, "Tr ", 3) == 0){
+			float tr = 0.0f;
+			sscanf(l + 3, "%f", &tr);
+			mat->data[4] = 1.0f - tr;
+		}else if(strncmp(l, "Ks ", 3) == 0){
+			sscanf(l + 3, "%f %f %f", &mat->data[5], &mat->data[6], &mat->data[7]);
+		}else if(strncmp(l, "Ka ", 3) == 0){
+			float a[3] = {1.0f, 1.0f, 1.0f};
+			sscanf(l + 3, "%f %f %f", &a[0], &a[1], &a[2]);
+			mat->data[10] = (a[0] + a[1] + a[2]) / 3.0f;
+		}else if(strncmp(l, "map_Kd ", 7) == 0){
+			mat->textures.insert(mat->textures.begin(), textureName(strrchr(l, ' ') + 1));
+		}else if(strncmp(l, "map_Bump ", 9) == 0 || strncmp(l, "bump ", 5) == 0 || strncmp(l, "norm ", 5) == 0){
+			mat->textures.push_back(textureName(strrchr(l, ' ') + 1));
+		}
+	}
+	fclose(f);
+}
+
+/**
+ * @brief Calculate the tangent space of each vertex, from its texture coordinates
+ * @param obj Object with all its vertices and indices
+ */
+void MeshCooker::computeTangents(AMG_CookObject &obj){
+	int n = obj.vertices.size();
+	std::vector<float> tan(n * 3, 0.0f), bitan(n * 3, 0.0f);
+	for(unsigned int i=0;i+2<obj.indices.size();i+=3){
+		const float *v0 = obj.vertices[obj.indices[i+0]].data;
+		const float *v1 = obj.vertices[obj.indices[i+1]].data;
+		const float *v2 = obj.vertices[obj.indices[i+2]].data;
+		float e1[3] = {v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
+		float e2[3] = {v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]};
+		float du1 = v1[3] - v0[3], dv1 = v1[4] - v0[4];
+		float du2 = v2[3] - v0[3], dv2 = v2[4] - v0[4];
+		float det = du1 * dv2 - du2 * dv1;
+		if(fabsf(det) < 1e-12f) continue;
+		float r = 1.0f / det;
+		for(int k=0;k<3;k++){
+			for(int c=0;c<3;c++){
+				tan[obj.indices[i+k]*3 + c] += (e1[c] * dv2 - e2[c] * dv1) * r;
+				bitan[obj.indices[i+k]*3 + c] += (e2[c] * du1 - e1[c] * du2) * r;
+			}
+		}
+	}
+
+	// Orthogonalize against the normal, keeping the handedness
+	obj.tangents.resize(n * 3);
+	obj.bitangents.resize(n * 3);
+	for(int i=0;i<n;i++){
+		const float *nrm = obj.vertices[i].data + 5;
+		float *t = &tan[i*3];
+		float d = nrm[0]*t[0] + nrm[1]*t[1] + nrm[2]*t[2];
+		float o[3] = {t[0] - nrm[0]*d, t[1] - nrm[1]*d, t[2] - nrm[2]*d};
+		float len = sqrtf(o[0]*o[0] + o[1]*o[1] + o[2]*o[2]);
+		if(len < 1e-12f){		// No texture coordinates, any perpendicular vector is fine
+			o[0] = nrm[2]; o[1] = 0.0f; o[2] = -nrm[0];
+			if(fabsf(nrm[1]) > 0.99f){ o[0] = 1.0f; o[1] = 0.0f; o[2] = 0.0f; }
+			len = sqrtf(o[0]*o[0] + o[1]*o[1] + o[2]*o[2]);
+		}
+		float c[3];
+		for(int k=0;k<3;k++) obj.tangents[i*3 + k] = o[k] / len;
+		t = &obj.tangents[i*3];
+		c[0] = nrm[1]*t[2] - nrm[2]*t[1];
+		c[1] = nrm[2]*t[0] - nrm[0]*t[2];
+		c[2] = nrm[0]*t[1] - nrm[1]*t[0];
+		float *b = &bitan[i*3];
+		float sign = (c[0]*b[0] + c[1]*b[1] + c[2]*b[2] < 0.0f) ? -1.0f : 1.0f;
+		for(int k=0;k<3;k++) obj.bitangents[i*3 + k] = c[k] * sign;
+	}
+}
+
+/**
+ * @brief Append data to the output buffer
+ * @param out Output buffer
+ * @param data Data to append
+ * @param size Size of the data, in bytes
+ */
+void MeshCooker::write(std::vector<char> &out, const void *data, int size){
+	out.insert(out.end(), (const char*)data, (const char*)data + size);
+}
+
+/**
+ * @brief Convert an OBJ file to an AMD model
+ * @param input OBJ path
+ * @param output AMD path
+ * @return AMG_COOK_OK on success, or an AMG_CookError
+ * @note Polygons are triangulated as fans. Faces without normals get the face normal
+ */
+int MeshCooker::cook(const char *input, const char *output){
+	FILE *f = fopen(input, "r");
+	if(f == NULL) return AMG_COOK_UNREADABLE;
+	std::string dir = folderOf(input);
+	std::vector<float> positions, texcoords, normals;
+	std::vector<AMG_CookMaterial> materials;
+	std::vector<AMG_CookObject> objects(1);
+	int material = 0xFFFF;
+	int error = AMG_COOK_OK;
+
+	// Read the file line by line
+	char line[4096];
+	while(error == AMG_COOK_OK && fgets(line, sizeof(line), f)){
+		trim(line);
+		if(strncmp(line, "v ", 2) == 0){
+			float v[3] = {0, 0, 0};
+			sscanf(line + 2, "%f %f %f", &v[0], &v[1], &v[2]);
+			positions.insert(positions.end(), v, v + 3);
+		}else if(strncmp(line, "vt ", 3) == 0){
+			float v[2] = {0, 0};
+			sscanf(line + 3, "%f %f", &v[0], &v[1]);
+			texcoords.push_back(v[0]);
+			texcoords.push_back(1.0f - v[1]);
+		}else if(strncmp(line, "vn ", 3) == 0){
+			float v[3] = {0, 1, 0};
+			sscanf(line + 3, "%f %f %f", &v[0], &v[1], &v[2]);
+			normals.insert(normals.end(), v, v + 3);
+		}else if(strncmp(line, "mtllib ", 7) == 0){
+			readMaterials(dir + (line + 7), materials);
+		}else if(strncmp(line, "usemtl ", 7) == 0){
+			material = 0xFFFF;
+			for(unsigned int i=0;i<materials.size();i++){
+				if(materials[i].name == line + 7) material = i;
+			}
+		}else if(strncmp(line, "o ", 2) == 0){
+			if(!objects.back().indices.empty()) objects.resize(objects.size() + 1);
+		}else if(strncmp(line, "f ", 2) == 0){
+
+			// Read the corners (position/texcoord/normal, 1-based or negative)
+			int corners[64][3];
+			int ncorners = 0;
+			char *p = line + 2;
+			while(ncorners < 64){
+				while(*p == ' ' || *p == '\t') p++;
+				if(*p == 0) break;
+				int idx[3] = {0, 0, 0};
+				for(int k=0;k<3 && *p && *p != ' ' && *p != '\t';k++){
+					if(*p != '/') idx[k] = strtol(p, &p, 10);
+					if(*p == '/') p++;
+				}
+				int counts[3] = {(int)positions.size() / 3, (int)texcoords.size() / 2, (int)normals.size() / 3};
+				for(int k=0;k<3;k++){
+					corners[ncorners][k] = (idx[k] < 0) ? counts[k] + idx[k] : idx[k] - 1;
+					if(corners[ncorners][k] >= counts[k]) corners[ncorners][k] = -1;
+				}
+				if(corners[ncorners][0] < 0){
+					error = AMG_COOK_WRONG_DATA;
+					break;
+				}
+				ncorners++;
+				while(*p && *p != ' ' && *p != '\t') p++;
+			}
+
+			// Add each triangle of the fan
+			for(int t=1;t+1<ncorners && error == AMG_COOK_OK;t++){
+				AMG_CookObject *obj = &objects.back();
+				if(obj->vertices.size() + 3 > AMG_COOK_MAX_VERTICES || obj->indices.size() + 3 > AMG_COOK_MAX_INDICES){
+					objects.resize(objects.size() + 1);
+					obj = &objects.back();
+				}
+				int tri[3] = {0, t, t+1};
+				AMG_CookVertex v[3];
+				for(int k=0;k<3;k++){
+					const int *c = corners[tri[k]];
+					memcpy(v[k].data, &positions[c[0]*3], 3*sizeof(float));
+					v[k].data[3] = (c[1] >= 0) ? texcoords[c[1]*2 + 0] : 0.0f;
+					v[k].data[4] = (c[1] >= 0) ? texcoords[c[1]*2 + 1] : 0.0f;
+					if(c[2] >= 0) memcpy(v[k].data + 5, &normals[c[2]*3], 3*sizeof(float));
+				}
+				for(int k=0;k<3;k++){
+					if(corners[tri[k]][2] >= 0) continue;
+					float e1[3], e2[3], n[3];
+					for(int c=0;c<3;c++){
+						e1[c] = v[1].data[c] - v[0].data[c];
+						e2[c] = v[2].data[c] - v[0].data[c];
+					}
+					n[0] = e1[1]*e2[2] - e1[2]*e2[1];
+					n[1] = e1[2]*e2[0] - e1[0]*e2[2];
+					n[2] = e1[0]*e2[1] - e1[1]*e2[0];
+					float len = sqrtf(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+					for(int c=0;c<3;c++) v[k].data[5 + c] = (len > 0.0f) ? n[c] / len : (c == 1);
+				}
+
+				// Weld the vertices
+				for(int k=0;k<3;k++){
+					auto it = obj->map.find(v[k]);
+					if(it == obj->map.end()){
+						it = obj->map.insert(std::make_pair(v[k], (int)obj->vertices.size())).first;
+						obj->vertices.push_back(v[k]);
+					}
+					obj->indices.push_back(it->second);
+				}
+
+				// Material groups, in triangles
+				unsigned short ntris = obj->indices.size() / 3;
+				if(obj->groups.empty() || obj->groups[obj->groups.size() - 1] != material){
+					unsigned short group[3] = {(unsigned short)(ntris - 1), ntris, (unsigned short)material};
+					obj->groups.insert(obj->groups.end(), group, group + 3);
+				}
+				obj->groups[obj->groups.size() - 2] = ntris;
+			}
+		}
+	}
+	fclose(f);
+	if(objects.back().indices.empty()) objects.pop_back();
+	if(error != AMG_COOK_OK) return error;
+	if(objects.empty()) return AMG_COOK_WRONG_DATA;
+	if(objects.size() > AMG_COOK_MAX_OBJECTS || materials.size() > 255) return AMG_COOK_TOO_BIG;
+
+	// Materials
+	std::vector<char> out;
+	write(out, "AMD", 3);
+	unsigned char n = materials.size();
+	write(out, &n, 1);
+	for(unsigned int i=0;i<materials.size();i++){
+		write(out, materials[i].data, sizeof(materials[i].data));
+		n = materials[i].textures.size();
+		write(out, &n, 1);
+		for(unsigned int j=0;j<materials[i].textures.size();j++){
+			n = materials[i].textures[j].size();
+			write(out, &n, 1);
+			write(out, materials[i].textures[j].c_str(), n);
+		}
+	}
+
+	// Objects
+	n = objects.size();
+	write(out, &n, 1);
+	for(unsigned int i=0;i<objects.size();i++){
+		AMG_CookObject &obj = objects[i];
+		if(obj.groups.size() / 3 > 255) return AMG_COOK_TOO_BIG;
+		computeTangents(obj);
+		unsigned short nvertices = obj.vertices.size();
+		write(out, &nvertices, sizeof(unsigned short));
+		float bmax[3] = {-1e30f, -1e30f, -1e30f};
+		for(int k=0;k<nvertices;k++){
+			write(out, obj.vertices[k].data, 3*sizeof(float));
+			for(int c=0;c<3;c++) bmax[c] = fmaxf(bmax[c], obj.vertices[k].data[c]);
+		}
+		for(int k=0;k<nvertices;k++) write(out, obj.vertices[k].data + 3, 2*sizeof(float));
+		for(int k=0;k<nvertices;k++) write(out, obj.vertices[k].data + 5, 3*sizeof(float));
+		write(out, obj.tangents.data(), obj.tangents.size()*sizeof(float));
+		write(out, obj.bitangents.data(), obj.bitangents.size()*sizeof(float));
+		unsigned short nindices = obj.indices.size();
+		write(out, &nindices, sizeof(unsigned short));
+		write(out, obj.indices.data(), nindices*sizeof(unsigned short));
+		n = obj.groups.size() / 3;
+		write(out, &n, 1);
+		write(out, obj.groups.data(), obj.groups.size()*sizeof(unsigned short));
+
+		// Bounding box (Blender axes, as the Model expects them), identity transform and no bones
+		float posdata[13] = {bmax[0], bmax[2], bmax[1], 0, 0, 0, 0, 0, 0, 1, 1, 1, 1};
+		write(out, posdata, sizeof(posdata));
+		n = 0;
+		write(out, &n, 1);
+	}
+
+	// No animations
+	n = 0;
+	write(out, &n, 1);
+	return AssetCooker::writeFile(output, out.data(), out.size(), NULL, 0);
+}
+
+}
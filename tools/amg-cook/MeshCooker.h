@@ -0,0 +1,80 @@
+/**
+ * @file MeshCooker.h
+ * @brief Converts Wavefront OBJ meshes to AMD models
+ */
+
+#ifndef MESHCOOKER_H_
+#define MESHCOOKER_H_
+
+// Includes C/C++
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Defines
+#define AMG_COOK_MAX_VERTICES 65535		/**< Vertices per AMD object, indexed by 16 bits */
+#define AMG_COOK_MAX_INDICES 65535		/**< Indices per AMD object, counted by 16 bits */
+#define AMG_COOK_MAX_OBJECTS 255		/**< Objects per AMD model */
+
+namespace AMG {
+
+/**
+ * @struct AMG_CookVertex
+ * @brief A vertex as it is welded: position, texture coordinates and normal
+ */
+typedef struct{
+	float data[8];						/**< Position (3), texture coordinates (2) and normal (3) */
+}AMG_CookVertex;
+
+/**
+ * @struct AMG_CookVertexHash
+ * @brief Hash of a vertex, for the welding map
+ */
+struct AMG_CookVertexHash {
+	size_t operator()(const AMG_CookVertex &v) const;
+	bool operator()(const AMG_CookVertex &a, const AMG_CookVertex &b) const;
+};
+
+/**
+ * @struct AMG_CookMaterial
+ * @brief Material read from a MTL file
+ */
+typedef struct{
+	std::string name;					/**< Material name */
+	float data[11];						/**< Diffuse, specular and ambient values, as Material expects them */
+	std::vector<std::string> textures;	/**< Texture names, with the .dds extension */
+}AMG_CookMaterial;
+
+/**
+ * @struct AMG_CookObject
+ * @brief An AMD object being built
+ */
+typedef struct{
+	std::vector<AMG_CookVertex> vertices;		/**< Welded vertices */
+	std::vector<float> tangents;				/**< Tangent of each vertex */
+	std::vector<float> bitangents;				/**< Bitangent of each vertex */
+	std::vector<unsigned short> indices;		/**< Triangle indices */
+	std::vector<unsigned short> groups;			/**< Material groups (first triangle, end triangle, material) */
+	std::unordered_map<AMG_CookVertex, int, AMG_CookVertexHash, AMG_CookVertexHash> map;	/**< Welding map */
+}AMG_CookObject;
+
+/**
+ * @class MeshCooker
+ * @brief Reads an OBJ file with its materials and writes the AMD model the engine loads
+ * @note Equal vertices are welded with a hash map, instead of the linear search of the Blender
+ * exporter. Objects bigger than 16 bit indices allow are split in several AMD objects
+ */
+class MeshCooker {
+private:
+	MeshCooker(){}
+	static void readMaterials(const std::string &path, std::vector<AMG_CookMaterial> &materials);
+	static void computeTangents(AMG_CookObject &obj);
+	static void write(std::vector<char> &out, const void *data, int size);
+public:
+	static void getDependencies(const char *input, std::vector<std::string> &files);
+	static int cook(const char *input, const char *output);
+};
+
+}
+
+#endif
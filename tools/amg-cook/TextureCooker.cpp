@@ -0,0 +1,297 @@
+/**
+ * @file TextureCooker.cpp
+ * @brief Converts images to block compressed DDS textures
+ */
+
+// Includes C/C++
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+// Own includes
+#include "TextureCooker.h"
+#include "AssetCooker.h"
+
+namespace AMG {
+
+// DDS constants
+#define DDS_FLAGS 0xA1007			/**< Caps, height, width, pixel format, mip count and linear size */
+#define DDS_FOURCC 0x4				/**< The pixel format is given by its FourCC */
+#define DDS_CAPS 0x401008			/**< Texture, complex and mipmap */
+#define FOURCC_DXT1 0x31545844		/**< "DXT1" */
+#define FOURCC_DXT5 0x35545844		/**< "DXT5" */
+
+// sRGB to linear conversion table
+static float linearTable[256];
+
+/**
+ * @brief Fill the conversion tables, before cooking any texture
+ */
+void TextureCooker::initialize(){
+	for(int i=0;i<256;i++){
+		float v = i / 255.0f;
+		linearTable[i] = (v <= 0.04045f) ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+	}
+}
+
+/**
+ * @brief Convert a linear value to sRGB
+ * @param v Linear value, from 0 to 1
+ * @return sRGB value, from 0 to 255
+ */
+static unsigned char toSRGB(float v){
+	v = (v <= 0.0031308f) ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+	int c = (int)(v * 255.0f + 0.5f);
+	return (c < 0) ? 0 : ((c > 255) ? 255 : c);
+}
+
+/**
+ * @brief Halve an image with a box filter
+ * @param src Source image
+ * @param dst Destination image, half the size (at least 1x1)
+ * @param linear Is the image data, instead of sRGB color? Alpha is always linear
+ */
+void TextureCooker::downsample(const AMG_CookImage &src, AMG_CookImage &dst, bool linear){
+	dst.width = (src.width > 1) ? src.width / 2 : 1;
+	dst.height = (src.height > 1) ? src.height / 2 : 1;
+	dst.pixels.resize(dst.width * dst.height * 4);
+	for(int y=0;y<dst.height;y++){
+		for(int x=0;x<dst.width;x++){
+			int x0 = x * 2, y0 = y * 2;
+			int x1 = (x0 + 1 < src.width) ? x0 + 1 : x0;
+			int y1 = (y0 + 1 < src.height) ? y0 + 1 : y0;
+			const unsigned char *p[4] = {
+				&src.pixels[(y0 * src.width + x0) * 4], &src.pixels[(y0 * src.width + x1) * 4],
+				&src.pixels[(y1 * src.width + x0) * 4], &src.pixels[(y1 * src.width + x1) * 4],
+			};
+			unsigned char *out = &dst.pixels[(y * dst.width + x) * 4];
+			for(int c=0;c<4;c++){
+				if(linear || c == 3){
+					out[c] = (p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4;
+				}else{
+					out[c] = toSRGB((linearTable[p[0][c]] + linearTable[p[1][c]] + linearTable[p[2][c]] + linearTable[p[3][c]]) * 0.25f);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief Pack a color to 5:6:5
+ * @param c Color components, from 0 to 255
+ * @return The packed color
+ */
+static unsigned short pack565(const float *c){
+	int r = (int)(c[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(c[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+	r = (r < 0) ? 0 : ((r > 31) ? 31 : r);
+	g = (g < 0) ? 0 : ((g > 63) ? 63 : g);
+	b = (b < 0) ? 0 : ((b > 31) ? 31 : b);
+	return (r << 11) | (g << 5) | b;
+}
+
+/**
+ * @brief Unpack a 5:6:5 color
+ * @param c Packed color
+ * @param out Color components, from 0 to 255
+ */
+static void unpack565(unsigned short c, int *out){
+	out[0] = ((c >> 11) & 31) * 255 / 31;
+	out[1] = ((c >> 5) & 63) * 255 / 63;
+	out[2] = (c & 31) * 255 / 31;
+}
+
+/**
+ * @brief Compress the color of a block to DXT1
+ * @param block 4x4 RGBA pixels
+ * @param out 8 bytes of compressed data
+ * @note The endpoints are the extremes of the block along its main color axis, moved slightly inwards
+ */
+void TextureCooker::compressColor(const unsigned char *block, unsigned char *out){
+
+	// Mean and covariance of the colors
+	float mean[3] = {0, 0, 0};
+	for(int i=0;i<16;i++){
+		for(int c=0;c<3;c++) mean[c] += block[i*4 + c] / 16.0f;
+	}
+	float cov[6] = {0, 0, 0, 0, 0, 0};
+	for(int i=0;i<16;i++){
+		float r = block[i*4 + 0] - mean[0], g = block[i*4 + 1] - mean[1], b = block[i*4 + 2] - mean[2];
+		cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+		cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+	}
+
+	// Main axis, by power iteration
+	float axis[3] = {1.0f, 1.0f, 1.0f};
+	for(int k=0;k<AMG_COOK_POWER_ITERATIONS;k++){
+		float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+		float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+		float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+		float len = fmaxf(fabsf(x), fmaxf(fabsf(y), fabsf(z)));
+		if(len <= 0.0f) break;
+		axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+	}
+
+	// Extremes along the axis, moved inwards by 1/16 of the range
+	float minT = 1e30f, maxT = -1e30f;
+	for(int i=0;i<16;i++){
+		float t = (block[i*4 + 0] - mean[0])*axis[0] + (block[i*4 + 1] - mean[1])*axis[1] + (block[i*4 + 2] - mean[2])*axis[2];
+		minT = fminf(minT, t);
+		maxT = fmaxf(maxT, t);
+	}
+	float len2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+	float inset = (maxT - minT) / 16.0f;
+	float e0[3], e1[3];
+	for(int c=0;c<3;c++){
+		e0[c] = mean[c] + axis[c] * (maxT - inset) / len2;
+		e1[c] = mean[c] + axis[c] * (minT + inset) / len2;
+	}
+
+	// Four color mode needs the first endpoint to be greater
+	unsigned short c0 = pack565(e0);
+	unsigned short c1 = pack565(e1);
+	if(c0 < c1){
+		unsigned short t = c0; c0 = c1; c1 = t;
+	}
+	out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+
+	// Palette, and the nearest entry for each pixel
+	int palette[4][3];
+	unpack565(c0, palette[0]);
+	unpack565(c1, palette[1]);
+	for(int c=0;c<3;c++){
+		palette[2][c] = (2*palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2*palette[1][c]) / 3;
+	}
+	unsigned int indices = 0;
+	for(int i=0;i<16 && c0 != c1;i++){
+		int best = 0, bestDist = 0x7FFFFFFF;
+		for(int j=0;j<4;j++){
+			int dr = block[i*4 + 0] - palette[j][0], dg = block[i*4 + 1] - palette[j][1], db = block[i*4 + 2] - palette[j][2];
+			int dist = dr*dr + dg*dg + db*db;
+			if(dist < bestDist){
+				best = j;
+				bestDist = dist;
+			}
+		}
+		indices |= best << (i * 2);
+	}
+	for(int i=0;i<4;i++) out[4 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+/**
+ * @brief Compress the alpha of a block, DXT5 style
+ * @param block 4x4 RGBA pixels
+ * @param out 8 bytes of compressed data
+ */
+void TextureCooker::compressAlpha(const unsigned char *block, unsigned char *out){
+	int a0 = 0, a1 = 255;
+	for(int i=0;i<16;i++){
+		a0 = (block[i*4 + 3] > a0) ? block[i*4 + 3] : a0;
+		a1 = (block[i*4 + 3] < a1) ? block[i*4 + 3] : a1;
+	}
+	out[0] = a0;
+	out[1] = a1;
+
+	// Eight value mode: a0, a1 and six values between them
+	unsigned long long indices = 0;
+	for(int i=0;i<16 && a0 != a1;i++){
+		int a = block[i*4 + 3];
+		int step = (int)((a0 - a) * 7.0f / (a0 - a1) + 0.5f);	// 0 is a0, 7 is a1
+		int index = (step == 0) ? 0 : ((step == 7) ? 1 : step + 1);
+		indices |= (unsigned long long)index << (i * 3);
+	}
+	for(int i=0;i<6;i++) out[2 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+/**
+ * @brief Compress an image, one 4x4 block at a time
+ * @param image Image to compress
+ * @param alpha Use DXT5? Otherwise DXT1 is used
+ * @param out Compressed data is appended here
+ */
+void TextureCooker::compress(const AMG_CookImage &image, bool alpha, std::vector<unsigned char> &out){
+	unsigned char block[64];
+	unsigned char packed[16];
+	for(int by=0;by<image.height;by+=4){
+		for(int bx=0;bx<image.width;bx+=4){
+
+			// Get the block, repeating the border pixels of small mip levels
+			for(int y=0;y<4;y++){
+				for(int x=0;x<4;x++){
+					int sx = (bx + x < image.width) ? bx + x : image.width - 1;
+					int sy = (by + y < image.height) ? by + y : image.height - 1;
+					memcpy(&block[(y*4 + x) * 4], &image.pixels[(sy * image.width + sx) * 4], 4);
+				}
+			}
+			if(alpha){
+				compressAlpha(block, packed);
+				compressColor(block, packed + 8);
+				out.insert(out.end(), packed, packed + 16);
+			}else{
+				compressColor(block, packed);
+				out.insert(out.end(), packed, packed + 8);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Convert an image to a DDS texture with all its mip levels
+ * @param input Image path (PNG, JPG, TGA, BMP...)
+ * @param output DDS path
+ * @param linear Is the image data (normal maps...), instead of sRGB color?
+ * @return AMG_COOK_OK on success, or an AMG_CookError
+ * @note TextureCooker::initialize must be called first
+ */
+int TextureCooker::cook(const char *input, const char *output, bool linear){
+	// Load the image
+	AMG_CookImage image;
+	int n = 0;
+	unsigned char *pixels = stbi_load(input, &image.width, &image.height, &n, 4);
+	if(pixels == NULL) return AMG_COOK_UNREADABLE;
+	image.pixels.assign(pixels, pixels + image.width * image.height * 4);
+	stbi_image_free(pixels);
+	if(image.width % 2 != 0 || image.height % 2 != 0) return AMG_COOK_WRONG_SIZE;
+
+	// Use DXT5 only if some pixel is transparent
+	bool alpha = false;
+	for(unsigned int i=3;i<image.pixels.size() && !alpha;i+=4){
+		alpha = image.pixels[i] < 255;
+	}
+
+	// Compress every mip level, down to 1x1
+	std::vector<unsigned char> data;
+	int width = image.width, height = image.height;
+	int topSize = 0, nmips = 0;
+	while(true){
+		compress(image, alpha, data);
+		if(nmips++ == 0) topSize = data.size();
+		if(image.width == 1 && image.height == 1) break;
+		AMG_CookImage next;
+		downsample(image, next, linear);
+		image = next;
+	}
+
+	// Write the DDS header and data
+	unsigned int header[32];
+	memset(header, 0, sizeof(header));
+	memcpy(header, "DDS ", 4);
+	header[1] = 124;
+	header[2] = DDS_FLAGS;
+	header[3] = height;
+	header[4] = width;
+	header[5] = topSize;
+	header[7] = nmips;
+	header[19] = 32;
+	header[20] = DDS_FOURCC;
+	header[21] = alpha ? FOURCC_DXT5 : FOURCC_DXT1;
+	header[27] = DDS_CAPS;
+	return AssetCooker::writeFile(output, header, sizeof(header), data.data(), data.size());
+}
+
+}
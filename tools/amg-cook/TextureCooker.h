@@ -0,0 +1,46 @@
+/**
+ * @file TextureCooker.h
+ * @brief Converts images to block compressed DDS textures
+ */
+
+#ifndef TEXTURECOOKER_H_
+#define TEXTURECOOKER_H_
+
+// Includes C/C++
+#include <vector>
+
+// Defines
+#define AMG_COOK_POWER_ITERATIONS 4		/**< Iterations used to find the main color axis of a block */
+
+namespace AMG {
+
+/**
+ * @struct AMG_CookImage
+ * @brief An uncompressed RGBA image
+ */
+typedef struct{
+	int width;							/**< Width, in pixels */
+	int height;							/**< Height, in pixels */
+	std::vector<unsigned char> pixels;	/**< RGBA pixels, top row first */
+}AMG_CookImage;
+
+/**
+ * @class TextureCooker
+ * @brief Builds the mip chain of an image and compresses it to DXT1, or DXT5 if it has alpha
+ * @note Color images are filtered in linear space, so the mips keep their brightness
+ */
+class TextureCooker {
+private:
+	TextureCooker(){}
+	static void downsample(const AMG_CookImage &src, AMG_CookImage &dst, bool linear);
+	static void compressColor(const unsigned char *block, unsigned char *out);
+	static void compressAlpha(const unsigned char *block, unsigned char *out);
+	static void compress(const AMG_CookImage &image, bool alpha, std::vector<unsigned char> &out);
+public:
+	static void initialize();
+	static int cook(const char *input, const char *output, bool linear);
+};
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * @file main.cpp
+ * @brief amg-cook, the asset cooker command line tool
+ * @note Built with AssetCooker, MeshCooker, TextureCooker and the engine's Entity, FileSystem
+ * and JobSystem sources. Needs stb_image and liblz4, see the Makefile
+ */
+
+// Includes C/C++
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Own includes
+#include "AssetCooker.h"
+#include "FileSystem.h"
+#include "JobSystem.h"
+
+using namespace AMG;
+
+/**
+ * @brief Print how to use the tool
+ */
+static void usage(){
+	printf("Usage: amg-cook [options] <source folder> [data folder]\n");
+	printf("  -f          Cook every asset, even if it did not change\n");
+	printf("  -j <n>      Number of worker threads (default: one per core)\n");
+	printf("  -p <pack>   Write a pack file with the data folder afterwards\n");
+	printf("The data folder is \"Data\" by default\n");
+}
+
+int main(int argc, char **argv){
+	const char *source = NULL;
+	const char *data = "Data";
+	const char *pack = NULL;
+	bool force = false;
+	int threads = 0;
+
+	// Read the arguments
+	int nargs = 0;
+	for(int i=1;i<argc;i++){
+		if(strcmp(argv[i], "-f") == 0){
+			force = true;
+		}else if(strcmp(argv[i], "-j") == 0 && i+1 < argc){
+			threads = atoi(argv[++i]);
+		}else if(strcmp(argv[i], "-p") == 0 && i+1 < argc){
+			pack = argv[++i];
+		}else if(argv[i][0] != '-' && nargs < 2){
+			if(nargs++ == 0) source = argv[i]; else data = argv[i];
+		}else{
+			usage();
+			return 1;
+		}
+	}
+	if(source == NULL){
+		usage();
+		return 1;
+	}
+
+	// Cook the assets, then pack them
+	JobSystem::initialize(threads);
+	int errors = AssetCooker::cook(source, data, force);
+	JobSystem::finish();
+	if(pack && errors == 0){
+		if(!FileSystem::build(data, pack)){
+			fprintf(stderr, "Error writing %s\n", pack);
+			return 1;
+		}
+		printf("Packed %s into %s\n", data, pack);
+	}
+	return (errors > 0) ? 1 : 0;
+}